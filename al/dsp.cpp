@@ -28,6 +28,12 @@ namespace AL {
 
 	Dsp* dsp = 0;
 
+#if defined(__i386__) || defined(__x86_64__)
+	// simd backends, see dspSSE2.cpp and dspAVX2.cpp
+	extern Dsp* createDspSSE2();
+	extern Dsp* createDspAVX2();
+#endif
+
 #ifdef __i386__
 
 	//---------------------------------------------------------
@@ -118,6 +124,23 @@ namespace AL {
 #endif
 #endif
 
+#if defined(__i386__) || defined(__x86_64__)
+		// Pick the best simd backend the cpu (and os) supports at runtime.
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		{
+			printf("Using AVX2/FMA optimized dsp routines\n");
+			dsp = createDspAVX2();
+			return;
+		}
+		if (__builtin_cpu_supports("sse2"))
+		{
+			printf("Using SSE2 optimized dsp routines\n");
+			dsp = createDspSSE2();
+			return;
+		}
+#endif
+
 #if defined(__i386__) && defined(USE_SSE)
 		unsigned long useSSE = 0;
 		if (debugMsg)
@@ -168,6 +191,103 @@ namespace AL {
 		dsp = 0;
 	}
 
+	//---------------------------------------------------------
+	//   generic versions of the newer routines
+	//---------------------------------------------------------
+
+	void Dsp::cpyWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] = src[i] * gain;
+	}
+
+	void Dsp::fill(float* dst, float val, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] = val;
+	}
+
+	void Dsp::addConstant(float* buf, float val, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			buf[i] += val;
+	}
+
+	void Dsp::panMix(float* dst0, float* dst1, float* src, unsigned n, float gain0, float gain1)
+	{
+		for (unsigned i = 0; i < n; ++i)
+		{
+			dst0[i] += src[i] * gain0;
+			dst1[i] += src[i] * gain1;
+		}
+	}
+
+	void Dsp::interleave(float* dst, float** src, int channels, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			for (int ch = 0; ch < channels; ++ch)
+				*dst++ = src[ch][i];
+	}
+
+	void Dsp::deinterleave(float** dst, float* src, int channels, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			for (int ch = 0; ch < channels; ++ch)
+				dst[ch][i] = *src++;
+	}
+
+	float Dsp::peakRms(float* buf, unsigned n, float current, double* squares)
+	{
+		double sum = 0.0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			current = f_max(current, fabsf(buf[i]));
+			sum += buf[i] * buf[i];
+		}
+		*squares += sum;
+		return current;
+	}
+
+	void Dsp::s16ToFloat(float* dst, const short* src, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 32768.0f);
+	}
+
+	void Dsp::s24ToFloat(float* dst, const unsigned char* src, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i, src += 3)
+		{
+			int v = int((unsigned(src[0]) << 8) | (unsigned(src[1]) << 16) | (unsigned(src[2]) << 24));
+			dst[i] = float(v) * (1.0f / 2147483648.0f);
+		}
+	}
+
+	void Dsp::s32ToFloat(float* dst, const int* src, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 2147483648.0f);
+	}
+
+	void Dsp::cpyWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] = src[i] * gain[i];
+	}
+
+	void Dsp::mixWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			dst[i] += src[i] * gain[i];
+	}
+
+	float Dsp::peakWithGainRamp(float* src, float* gain, unsigned n, float current)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			current = f_max(current, fabsf(src[i] * gain[i]));
+		return current;
+	}
+
 	void Dsp::cpy(float* dst, float* src, unsigned n)
 	{
 		// FIXME: Changed by T356. Not defined. Where are these???
@@ -67,7 +67,27 @@ class Dsp {
             for (unsigned i = 0; i < n; ++i)
                   dst[i] += src[i];
             }
+
+      // The following are defined in dsp.cpp, not inline, so that the
+      //  simd backends (compiled with -mavx2 etc.) never emit copies of them.
+      virtual void cpyWithGain(float* dst, float* src, unsigned n, float gain);
+      virtual void fill(float* dst, float val, unsigned n);
+      virtual void addConstant(float* buf, float val, unsigned n);
+      // dst0 += src * gain0, dst1 += src * gain1
+      virtual void panMix(float* dst0, float* dst1, float* src, unsigned n, float gain0, float gain1);
+      virtual void interleave(float* dst, float** src, int channels, unsigned n);
+      virtual void deinterleave(float** dst, float* src, int channels, unsigned n);
+      // returns the peak, adds the sum of squares to *squares
+      virtual float peakRms(float* buf, unsigned n, float current, double* squares);
+      // per sample gain, used for automation ramps
+      virtual void cpyWithGainRamp(float* dst, float* src, float* gain, unsigned n);
+      virtual void mixWithGainRamp(float* dst, float* src, float* gain, unsigned n);
+      virtual float peakWithGainRamp(float* src, float* gain, unsigned n, float current);
       virtual void cpy(float* dst, float* src, unsigned n);
+      // native endian pcm samples to float, scaled like libsndfile does
+      virtual void s16ToFloat(float* dst, const short* src, unsigned n);
+      virtual void s24ToFloat(float* dst, const unsigned char* src, unsigned n); // packed, little endian
+      virtual void s32ToFloat(float* dst, const int* src, unsigned n);
 /*      
       {
 // Changed by T356. Not defined. Where are these???
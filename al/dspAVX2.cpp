@@ -0,0 +1,315 @@
+//=============================================================================
+//  AL
+//  Audio Utility Library
+//  $Id:$
+//
+//  Copyright (C) 2002-2006 by Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+//
+// AVX2/FMA versions of the dsp routines. Compiled with -mavx2 -mfma,
+// only instantiated by initDsp() if the cpu supports them.
+// Nothing in here may be called before that check, so this file must not
+// use any inline code shared with the other files (except f_max).
+// Buffers don't need to be aligned.
+//
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+#include "dsp.h"
+
+namespace AL {
+
+static inline __m256 absMask()
+{
+	return _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+}
+
+static inline float hmax(__m256 v)
+{
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+}
+
+//---------------------------------------------------------
+//   DspAVX2
+//---------------------------------------------------------
+
+class DspAVX2 : public Dsp
+{
+public:
+
+	DspAVX2()
+	{
+	}
+
+	virtual ~DspAVX2()
+	{
+	}
+
+	virtual float peak(float* buf, unsigned n, float current)
+	{
+		__m256 mask = absMask();
+		__m256 m = _mm256_set1_ps(current);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(buf + i), mask));
+		current = hmax(m);
+		for (; i < n; ++i)
+			current = f_max(current, fabsf(buf[i]));
+		return current;
+	}
+
+	virtual void applyGainToBuffer(float* buf, unsigned n, float gain)
+	{
+		__m256 g = _mm256_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+		for (; i < n; ++i)
+			buf[i] *= gain;
+	}
+
+	virtual void mixWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		__m256 g = _mm256_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), g, _mm256_loadu_ps(dst + i)));
+		for (; i < n; ++i)
+			dst[i] += src[i] * gain;
+	}
+
+	virtual void mix(float* dst, float* src, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+		for (; i < n; ++i)
+			dst[i] += src[i];
+	}
+
+	virtual void cpyWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		__m256 g = _mm256_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+		for (; i < n; ++i)
+			dst[i] = src[i] * gain;
+	}
+
+	virtual void fill(float* dst, float val, unsigned n)
+	{
+		__m256 v = _mm256_set1_ps(val);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, v);
+		for (; i < n; ++i)
+			dst[i] = val;
+	}
+
+	virtual void addConstant(float* buf, float val, unsigned n)
+	{
+		__m256 v = _mm256_set1_ps(val);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(buf + i, _mm256_add_ps(_mm256_loadu_ps(buf + i), v));
+		for (; i < n; ++i)
+			buf[i] += val;
+	}
+
+	virtual void panMix(float* dst0, float* dst1, float* src, unsigned n, float gain0, float gain1)
+	{
+		__m256 g0 = _mm256_set1_ps(gain0);
+		__m256 g1 = _mm256_set1_ps(gain1);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 s = _mm256_loadu_ps(src + i);
+			_mm256_storeu_ps(dst0 + i, _mm256_fmadd_ps(s, g0, _mm256_loadu_ps(dst0 + i)));
+			_mm256_storeu_ps(dst1 + i, _mm256_fmadd_ps(s, g1, _mm256_loadu_ps(dst1 + i)));
+		}
+		for (; i < n; ++i)
+		{
+			dst0[i] += src[i] * gain0;
+			dst1[i] += src[i] * gain1;
+		}
+	}
+
+	virtual void interleave(float* dst, float** src, int channels, unsigned n)
+	{
+		if (channels != 2)
+		{
+			Dsp::interleave(dst, src, channels, n);
+			return;
+		}
+		float* l = src[0];
+		float* r = src[1];
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 a = _mm256_loadu_ps(l + i);
+			__m256 b = _mm256_loadu_ps(r + i);
+			__m256 lo = _mm256_unpacklo_ps(a, b); // l0 r0 l1 r1 l4 r4 l5 r5
+			__m256 hi = _mm256_unpackhi_ps(a, b); // l2 r2 l3 r3 l6 r6 l7 r7
+			_mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+		for (; i < n; ++i)
+		{
+			dst[2 * i] = l[i];
+			dst[2 * i + 1] = r[i];
+		}
+	}
+
+	virtual void deinterleave(float** dst, float* src, int channels, unsigned n)
+	{
+		if (channels != 2)
+		{
+			Dsp::deinterleave(dst, src, channels, n);
+			return;
+		}
+		float* l = dst[0];
+		float* r = dst[1];
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 a = _mm256_loadu_ps(src + 2 * i); // l0 r0 l1 r1 l2 r2 l3 r3
+			__m256 b = _mm256_loadu_ps(src + 2 * i + 8); // l4 r4 l5 r5 l6 r6 l7 r7
+			__m256 lo = _mm256_permute2f128_ps(a, b, 0x20); // l0 r0 l1 r1 l4 r4 l5 r5
+			__m256 hi = _mm256_permute2f128_ps(a, b, 0x31); // l2 r2 l3 r3 l6 r6 l7 r7
+			_mm256_storeu_ps(l + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm256_storeu_ps(r + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		for (; i < n; ++i)
+		{
+			l[i] = src[2 * i];
+			r[i] = src[2 * i + 1];
+		}
+	}
+
+	virtual float peakRms(float* buf, unsigned n, float current, double* squares)
+	{
+		__m256 mask = absMask();
+		__m256 m = _mm256_set1_ps(current);
+		__m256d sum = _mm256_setzero_pd();
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 v = _mm256_loadu_ps(buf + i);
+			m = _mm256_max_ps(m, _mm256_and_ps(v, mask));
+			__m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+			__m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+			sum = _mm256_fmadd_pd(lo, lo, sum);
+			sum = _mm256_fmadd_pd(hi, hi, sum);
+		}
+		double s[4];
+		_mm256_storeu_pd(s, sum);
+		double total = s[0] + s[1] + s[2] + s[3];
+		current = hmax(m);
+		for (; i < n; ++i)
+		{
+			current = f_max(current, fabsf(buf[i]));
+			total += buf[i] * buf[i];
+		}
+		*squares += total;
+		return current;
+	}
+
+	virtual void cpyWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(gain + i)));
+		for (; i < n; ++i)
+			dst[i] = src[i] * gain[i];
+	}
+
+	virtual void mixWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(gain + i), _mm256_loadu_ps(dst + i)));
+		for (; i < n; ++i)
+			dst[i] += src[i] * gain[i];
+	}
+
+	virtual void s16ToFloat(float* dst, const short* src, unsigned n)
+	{
+		__m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+		for (; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 32768.0f);
+	}
+
+	virtual void s24ToFloat(float* dst, const unsigned char* src, unsigned n)
+	{
+		__m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+		// move the 3 bytes of each sample to the top of a 32 bit lane
+		__m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+		unsigned i = 0;
+		// the loads read 4 bytes past the 8 samples
+		for (; i + 10 <= n; i += 8)
+		{
+			const unsigned char* p = src + 3 * i;
+			__m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) p), shuffle);
+			__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (p + 12)), shuffle);
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+		Dsp::s24ToFloat(dst + i, src + 3 * i, n - i);
+	}
+
+	virtual void s32ToFloat(float* dst, const int* src, unsigned n)
+	{
+		__m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*) (src + i))), scale));
+		for (; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 2147483648.0f);
+	}
+
+	virtual float peakWithGainRamp(float* src, float* gain, unsigned n, float current)
+	{
+		__m256 mask = absMask();
+		__m256 m = _mm256_set1_ps(current);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+			m = _mm256_max_ps(m, _mm256_and_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(gain + i)), mask));
+		current = hmax(m);
+		for (; i < n; ++i)
+			current = f_max(current, fabsf(src[i] * gain[i]));
+		return current;
+	}
+};
+
+Dsp* createDspAVX2()
+{
+	return new DspAVX2();
+}
+
+} // namespace AL
+
+#endif
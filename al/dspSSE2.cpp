@@ -0,0 +1,293 @@
+//=============================================================================
+//  AL
+//  Audio Utility Library
+//  $Id:$
+//
+//  Copyright (C) 2002-2006 by Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+//
+// SSE2 versions of the dsp routines. Compiled with -msse2, only
+// instantiated by initDsp() if the cpu supports it.
+// Buffers don't need to be aligned.
+//
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+#include "dsp.h"
+
+namespace AL {
+
+static inline __m128 absMask()
+{
+	return _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+}
+
+static inline float hmax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+//---------------------------------------------------------
+//   DspSSE2
+//---------------------------------------------------------
+
+class DspSSE2 : public Dsp
+{
+public:
+
+	DspSSE2()
+	{
+	}
+
+	virtual ~DspSSE2()
+	{
+	}
+
+	virtual float peak(float* buf, unsigned n, float current)
+	{
+		__m128 mask = absMask();
+		__m128 m = _mm_set1_ps(current);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			m = _mm_max_ps(m, _mm_and_ps(_mm_loadu_ps(buf + i), mask));
+		current = hmax(m);
+		for (; i < n; ++i)
+			current = f_max(current, fabsf(buf[i]));
+		return current;
+	}
+
+	virtual void applyGainToBuffer(float* buf, unsigned n, float gain)
+	{
+		__m128 g = _mm_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+		for (; i < n; ++i)
+			buf[i] *= gain;
+	}
+
+	virtual void mixWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		__m128 g = _mm_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+		for (; i < n; ++i)
+			dst[i] += src[i] * gain;
+	}
+
+	virtual void mix(float* dst, float* src, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+		for (; i < n; ++i)
+			dst[i] += src[i];
+	}
+
+	virtual void cpyWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		__m128 g = _mm_set1_ps(gain);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+		for (; i < n; ++i)
+			dst[i] = src[i] * gain;
+	}
+
+	virtual void fill(float* dst, float val, unsigned n)
+	{
+		__m128 v = _mm_set1_ps(val);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, v);
+		for (; i < n; ++i)
+			dst[i] = val;
+	}
+
+	virtual void addConstant(float* buf, float val, unsigned n)
+	{
+		__m128 v = _mm_set1_ps(val);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(buf + i, _mm_add_ps(_mm_loadu_ps(buf + i), v));
+		for (; i < n; ++i)
+			buf[i] += val;
+	}
+
+	virtual void panMix(float* dst0, float* dst1, float* src, unsigned n, float gain0, float gain1)
+	{
+		__m128 g0 = _mm_set1_ps(gain0);
+		__m128 g1 = _mm_set1_ps(gain1);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 s = _mm_loadu_ps(src + i);
+			_mm_storeu_ps(dst0 + i, _mm_add_ps(_mm_loadu_ps(dst0 + i), _mm_mul_ps(s, g0)));
+			_mm_storeu_ps(dst1 + i, _mm_add_ps(_mm_loadu_ps(dst1 + i), _mm_mul_ps(s, g1)));
+		}
+		for (; i < n; ++i)
+		{
+			dst0[i] += src[i] * gain0;
+			dst1[i] += src[i] * gain1;
+		}
+	}
+
+	virtual void interleave(float* dst, float** src, int channels, unsigned n)
+	{
+		if (channels != 2)
+		{
+			Dsp::interleave(dst, src, channels, n);
+			return;
+		}
+		float* l = src[0];
+		float* r = src[1];
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(l + i);
+			__m128 b = _mm_loadu_ps(r + i);
+			_mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(a, b));
+			_mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(a, b));
+		}
+		for (; i < n; ++i)
+		{
+			dst[2 * i] = l[i];
+			dst[2 * i + 1] = r[i];
+		}
+	}
+
+	virtual void deinterleave(float** dst, float* src, int channels, unsigned n)
+	{
+		if (channels != 2)
+		{
+			Dsp::deinterleave(dst, src, channels, n);
+			return;
+		}
+		float* l = dst[0];
+		float* r = dst[1];
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(src + 2 * i);
+			__m128 b = _mm_loadu_ps(src + 2 * i + 4);
+			_mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		for (; i < n; ++i)
+		{
+			l[i] = src[2 * i];
+			r[i] = src[2 * i + 1];
+		}
+	}
+
+	virtual float peakRms(float* buf, unsigned n, float current, double* squares)
+	{
+		__m128 mask = absMask();
+		__m128 m = _mm_set1_ps(current);
+		__m128d sum = _mm_setzero_pd();
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(buf + i);
+			m = _mm_max_ps(m, _mm_and_ps(v, mask));
+			__m128 sq = _mm_mul_ps(v, v);
+			sum = _mm_add_pd(sum, _mm_cvtps_pd(sq));
+			sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(sq, sq)));
+		}
+		double s[2];
+		_mm_storeu_pd(s, sum);
+		double total = s[0] + s[1];
+		current = hmax(m);
+		for (; i < n; ++i)
+		{
+			current = f_max(current, fabsf(buf[i]));
+			total += buf[i] * buf[i];
+		}
+		*squares += total;
+		return current;
+	}
+
+	virtual void s16ToFloat(float* dst, const short* src, unsigned n)
+	{
+		__m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		unsigned i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+			// sign extend by shifting the duplicated halves down
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+		for (; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 32768.0f);
+	}
+
+	virtual void s32ToFloat(float* dst, const int* src, unsigned n)
+	{
+		__m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) (src + i))), scale));
+		for (; i < n; ++i)
+			dst[i] = float(src[i]) * (1.0f / 2147483648.0f);
+	}
+
+	virtual void cpyWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(gain + i)));
+		for (; i < n; ++i)
+			dst[i] = src[i] * gain[i];
+	}
+
+	virtual void mixWithGainRamp(float* dst, float* src, float* gain, unsigned n)
+	{
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(gain + i))));
+		for (; i < n; ++i)
+			dst[i] += src[i] * gain[i];
+	}
+
+	virtual float peakWithGainRamp(float* src, float* gain, unsigned n, float current)
+	{
+		__m128 mask = absMask();
+		__m128 m = _mm_set1_ps(current);
+		unsigned i = 0;
+		for (; i + 4 <= n; i += 4)
+			m = _mm_max_ps(m, _mm_and_ps(_mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(gain + i)), mask));
+		current = hmax(m);
+		for (; i < n; ++i)
+			current = f_max(current, fabsf(src[i] * gain[i]));
+		return current;
+	}
+};
+
+Dsp* createDspSSE2()
+{
+	return new DspSSE2();
+}
+
+} // namespace AL
+
+#endif
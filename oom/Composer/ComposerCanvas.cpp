@@ -2871,7 +2871,8 @@ void ComposerCanvas::drawWavePart(QPainter& p, const QRect& bb, WavePart* wp, co
 		int xScale;
 		int pos;
 		int tickstep = rmapxDev(1);
-		int postick = tempomap.frame2tick(wp->frame() + event.frame());
+		TempoCursor tempoCursor;
+		int postick = tempomap.frame2tick(wp->frame() + event.frame(), tempoCursor);
 		int eventx = mapx(postick);
 		int drawoffset;
 		if ((x1 - eventx) < 0)
@@ -2901,7 +2902,7 @@ void ComposerCanvas::drawWavePart(QPainter& p, const QRect& bb, WavePart* wp, co
 				{
 					int hm = hh / 2;
 					SampleV sa[channels];
-					xScale = tempomap.deltaTick2frame(postick, postick + tickstep);
+					xScale = tempomap.deltaTick2frame(postick, postick + tickstep, tempoCursor);
 					f.read(sa, xScale, pos);
 					postick += tickstep;
 					pos += xScale;
@@ -2944,7 +2945,7 @@ void ComposerCanvas::drawWavePart(QPainter& p, const QRect& bb, WavePart* wp, co
 					}
 					hm = hh / 2;
 					SampleV sa[channels];
-					xScale = tempomap.deltaTick2frame(postick, postick + tickstep);
+					xScale = tempomap.deltaTick2frame(postick, postick + tickstep, tempoCursor);
 					
 					if(xmag <= -301)/*{{{*/
 					{
@@ -3036,7 +3037,7 @@ void ComposerCanvas::drawWavePart(QPainter& p, const QRect& bb, WavePart* wp, co
 				{
 					y = pr.y() + hm;
 					SampleV sa[channels];
-					xScale = tempomap.deltaTick2frame(postick, postick + tickstep);
+					xScale = tempomap.deltaTick2frame(postick, postick + tickstep, tempoCursor);
 					f.read(sa, xScale, pos);
 					postick += tickstep;
 					pos += xScale;
@@ -3088,7 +3089,7 @@ void ComposerCanvas::drawWavePart(QPainter& p, const QRect& bb, WavePart* wp, co
 				{
 					y = pr.y() + hm;
 					SampleV sa[channels];
-					xScale = tempomap.deltaTick2frame(postick, postick + tickstep);
+					xScale = tempomap.deltaTick2frame(postick, postick + tickstep, tempoCursor);
 					if(xmag <= -301)/*{{{*/
 					{
 						if( i % 10==1 || i % 10==2 || i % 10==3 || i % 10==4 || i % 10==5 || i % 10 == 7 || i % 10==8 || i % 10==9)
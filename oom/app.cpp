@@ -33,6 +33,8 @@
 #include "audio.h"
 #include "audiodev.h"
 #include "audioprefetch.h"
+#include "audioworkers.h"
+#include "playbacksnapshot.h"
 #include "apconfig.h"
 #include "bigtime.h"
 #include "cliplist/cliplist.h"
@@ -291,6 +293,9 @@ bool OOMidi::seqStart()
 
 	audioPrefetch->msgSeek(0, true); // force
 
+	// Helper threads for the audio thread run at the same priority as the audio thread.
+	audioWorkers->start(realTimeScheduling ? realTimePriority : 0, config.audioThreads);
+
 	midiSeq->start(midiprio);
 
 	int counter = 0;
@@ -341,6 +346,7 @@ void OOMidi::seqStop()
 	midiMonitor->stop(true);
 	midiSeq->stop(true);
 	audio->stop(true);
+	audioWorkers->stop();
 	audioPrefetch->stop(true);
     // close opened synths
     for (iMidiDevice i = midiDevices.begin(); i != midiDevices.end(); ++i)
@@ -647,6 +653,7 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 
 	song = new Song(m_undoStack, "song");
 	song->blockSignals(true);
+	new PlaybackCompiler(this);
 	heartBeatTimer = new QTimer(this);
 	heartBeatTimer->setObjectName("timer");
 	connect(heartBeatTimer, SIGNAL(timeout()), song, SLOT(beat()));
@@ -1106,6 +1113,7 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	midiSeq = new MidiSeq("Midi");
 	audio = new Audio();
 	audioPrefetch = new AudioPrefetch("Prefetch");
+	audioWorkers = new AudioWorkers();
 	//Define the MidiMonitor
 	midiMonitor = new MidiMonitor("MidiMonitor");
 
@@ -2460,6 +2468,7 @@ void OOMidi::closeEvent(QCloseEvent* event)
 	// p3.3.47
 	delete midiMonitor;
 	delete audioPrefetch;
+	delete audioWorkers;
 	delete audio;
 	delete midiSeq;
 	delete song;
@@ -4446,6 +4455,8 @@ bool OOMidi::clearSong()
 	//printf("OOMidi::clearSong() TopLevel.size(%d) \n", (int)toplevels.size());
 	microSleep(100000);
 	emit songClearCalled();
+	// no disk reader may still be reading a track
+	audioPrefetch->waitIdle();
 	song->clear(false);
 	microSleep(200000);
 	return false;
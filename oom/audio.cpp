@@ -8,6 +8,8 @@
 
 #include <cmath>
 #include <errno.h>
+#include <map>
+#include <algorithm>
 
 #include <QSocketNotifier>
 
@@ -20,17 +22,21 @@
 #include "alsamidi.h"
 //#include "driver/alsamidi.h"   // p4.0.2
 #include "audioprefetch.h"
+#include "audioworkers.h"
 #include "plugin.h"
 #include "audio.h"
 #include "wave.h"
 #include "midictrl.h"
+#include "midiport.h"
 #include "midiseq.h"
 #include "sync.h"
 #include "midi.h"
 #include "event.h"
+#include "edittransaction.h"
 #include "gconfig.h"
 #include "pos.h"
 #include "ticksynth.h"
+#include "rtalloccheck.h"
 
 extern double curTime();
 Audio* audio;
@@ -81,7 +87,10 @@ const char* seqMsgList[] = {
 	"AUDIO_ADD_AC_EVENT",
 	"AUDIO_SET_SOLO", "AUDIO_SET_SEND_METRONOME",
 	"MS_PROCESS", "MS_STOP", "MS_SET_RTC", "MS_UPDATE_POLL_FD",
-	"SEQM_IDLE", "SEQM_SEEK", "SEQM_PRELOAD_PROGRAM", "SEQM_REMOVE_TRACK_GROUP"
+	"SEQM_IDLE", "SEQM_SEEK", "SEQM_PRELOAD_PROGRAM", "SEQM_REMOVE_TRACK_GROUP",
+	"SEQM_EDIT_TRANSACTION",
+	"AUDIO_SET_PLAY_SNAPSHOT",
+	"AUDIO_SET_PLAN"
 };
 
 const char* audioStates[] = {
@@ -118,7 +127,12 @@ Audio::Audio()
 	frameOffset = 0;
 
 	state = STOP;
-	msg = 0;
+	_msgRing.setCapacity(AUDIO_MSG_QUEUE_SIZE);
+	_msgDoneRing.setCapacity(AUDIO_MSG_QUEUE_SIZE);
+	_msgsPending = 0;
+	pthread_mutex_init(&_msgQueueLock, 0);
+	pthread_mutex_init(&_msgSyncLock, 0);
+	pthread_mutex_init(&_msgDoneLock, 0);
 
 	// Changed by Tim. p3.3.8
 	//startRecordPos.setType(Pos::TICKS);
@@ -129,6 +143,17 @@ Audio::Audio()
 	_audioMonitor = 0;
 	_audioMaster = 0;
 
+	_plan = 0;
+	_topologySerial = 0;
+	_planSerial = ~0u;
+	_topologyDirty = true;
+	_playCursorSerial = 0;
+	_editSerial = 0;
+
+	_preRenderList.reserve(256);
+	_preRenderPos = 0;
+	_preRenderFrames = 0;
+
 	//---------------------------------------------------
 	//  establish pipes/sockets
 	//---------------------------------------------------
@@ -208,6 +233,7 @@ bool Audio::start()
 		// saved position?
 		audioDevice->stopTransport();
 		audioDevice->seekTransport(song->cPos());
+		updatePlan();
 		return true;
 	}
 	return false;
@@ -319,18 +345,11 @@ void Audio::shutdown()
 void Audio::process(unsigned frames)
 {
 	if (!checkAudioDevice()) return;
-	if (msg)
-	{
-		processMsg(msg);
-		int sn = msg->serialNo;
-		msg = 0; // dont process again
-		int rv = write(fromThreadFdw, &sn, sizeof (int));
-		if (rv != sizeof (int))
-		{
-			fprintf(stderr, "audio: write(%d) pipe failed: %s\n",
-					fromThreadFdw, strerror(errno));
-		}
-	}
+	processMsgQueue(frames);
+
+	// Messages from the gui (track, part and route edits) may allocate,
+	//  the rest of the cycle must not.
+	RtAllocCheck allocCheck("Audio::process");
 
     OutputList* ol = song->outputs();
 	if (idle)
@@ -463,7 +482,7 @@ void Audio::process(unsigned frames)
 				_loopFrame = lpos - n;
 
 				// clear sustain
-				for (int i = 0; i < MIDI_PORTS; ++i)
+				for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))
 				{
 					MidiPort* mp = &midiPorts[i];
 					for (int ch = 0; ch < MIDI_CHANNELS; ++ch)
@@ -531,81 +550,495 @@ void Audio::process(unsigned frames)
 
 void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
 {
+	if (_topologyDirty)
+		updateTopology();
+
 	if (midiSeqRunning)
 	{
 		processMidi();
 	}
 	//midiSeq->msgProcess();
 
-	//
-	// process not connected tracks
-	// to animate meter display
-	//
+	// Starting a new cycle resets the processed state of all tracks.
+	AudioTrack::nextProcessCycle();
+
+	// The plan is outdated from the moment the routes change until the
+	//  gui thread has sent a new one.
+	ProcessPlan* plan = _plan;
+	if (plan && plan->serial == _topologySerial && frames <= plan->frames)
+		processPlanned(plan, samplePos, offset, frames);
+	else
+		processUnplanned(samplePos, offset, frames);
+}
+
+//---------------------------------------------------------
+//   processPlanned
+//---------------------------------------------------------
+
+void Audio::processPlanned(ProcessPlan* plan, unsigned samplePos, unsigned offset, unsigned frames)
+{
+	// For audio track types, synths etc. which need some kind of non-audio
+	//  (but possibly audio-affecting) processing always, even if their output path
+	//  is ultimately unconnected.
+	// Example: A fluidsynth instance whose output path ultimately led to nowhere
+	//  would not allow us to load a font. Since process() was driven by audio output,
+	//  in this case there was nothing driving the process() function which responds to
+	//  such gui commands. So I separated the events processing from process(), into this.
+	// It should be used for things like midi events, gui events etc. - things which need to
+	//  be done BEFORE all the AudioOutput::process() are called below. That does NOT include
+	//  audio processing, because THAT is done at the very end of this routine.
+	for (std::vector<AudioTrack*>::const_iterator it = plan->preProcess.begin(); it != plan->preProcess.end(); ++it)
+		(*it)->preProcessAlways();
+	// Pre-process the metronome.
+	((AudioTrack*) metronome)->preProcessAlways();
+
+	// Tracks which only read from disk and have no dependencies on other tracks
+	//  get their data and effects processed up front, spread over the audio workers.
+	// Summing into the outputs is still done below, in the usual order.
+	// Everything else stays on this thread: synths free their play events into
+	//  audioRTmemoryPool, which is not thread safe, and busses, groups and auxes
+	//  read the buffers of other tracks.
+	if (audioWorkers && audioWorkers->isRunning() && plan->preRender.size() > 1)
+	{
+		_preRenderList.clear();
+		for (std::vector<AudioTrack*>::const_iterator it = plan->preRender.begin(); it != plan->preRender.end(); ++it)
+		{
+			if ((*it)->canPreRender())
+				_preRenderList.push_back(*it);
+		}
+		if (_preRenderList.size() > 1)
+		{
+			_preRenderPos = samplePos;
+			_preRenderFrames = frames;
+			audioWorkers->run(preRenderTrack, this, _preRenderList.size());
+		}
+	}
+
+	// Tracks with several consumers are rendered into their cache first, the
+	//  consumers then only apply their volume. The outputs pull the rest.
+	// Process the tracks whose output path leads nowhere as well. This will animate
+	//  meters, and 'quietly' process some audio which needs to be done - for example
+	//  synths really need to be processed, 'quietly' or not, otherwise the next time
+	//  processing is 'turned on', if there was a backlog of events while it was off,
+	//  then they all happen at once.
+	for (std::vector<AudioTrack*>::const_iterator it = plan->order.begin(); it != plan->order.end(); ++it)
+	{
+		AudioTrack* track = *it;
+		if (track->processed())
+			continue;
+		if (track->type() == Track::AUDIO_OUTPUT)
+			((AudioOutput*) track)->process(samplePos, offset, frames);
+		else
+			track->copyData(samplePos, track->channels(), -1, -1, frames, plan->buffer);
+	}
+}
+
+//---------------------------------------------------------
+//   processUnplanned
+//    process1() without a plan, for the cycles between a
+//    route change and the new plan
+//---------------------------------------------------------
+
+void Audio::processUnplanned(unsigned samplePos, unsigned offset, unsigned frames)
+{
 	TrackList* tl = song->tracks();
-	AudioTrack* track;
-	int channels;
 	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
 	{
 		Track* t = *it;
 		if (!t || t->isMidiTrack())
 			continue;
-		track = (AudioTrack*) t;
-
-		// For audio track types, synths etc. which need some kind of non-audio
-		//  (but possibly audio-affecting) processing always, even if their output path
-		//  is ultimately unconnected.
-		// Example: A fluidsynth instance whose output path ultimately led to nowhere
-		//  would not allow us to load a font. Since process() was driven by audio output,
-		//  in this case there was nothing driving the process() function which responds to
-		//  such gui commands. So I separated the events processing from process(), into this.
-		// It should be used for things like midi events, gui events etc. - things which need to
-		//  be done BEFORE all the AudioOutput::process() are called below. That does NOT include
-		//  audio processing, because THAT is done at the very end of this routine.
-		// This will also reset the track's processed flag.
-		track->preProcessAlways();
+		((AudioTrack*) t)->preProcessAlways();
 	}
-	// Pre-process the metronome.
 	((AudioTrack*) metronome)->preProcessAlways();
 
 	OutputList* ol = song->outputs();
 	for (ciAudioOutput i = ol->begin(); i != ol->end(); ++i)
 		(*i)->process(samplePos, offset, frames);
 
-	// Were ANY tracks unprocessed as a result of processing all the AudioOutputs, above?
-	// Not just unconnected ones, as previously done, but ones whose output path ultimately leads nowhere.
-	// Those tracks were missed, until this fix.
-	// Do them now. This will animate meters, and 'quietly' process some audio which needs to be done -
-	//  for example synths really need to be processed, 'quietly' or not, otherwise the next time
-	//  processing is 'turned on', if there was a backlog of events while it was off, then they all happen at once.
 	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
 	{
 		Track* t = *it;
 		if (!t || t->isMidiTrack())
 			continue;
-		track = (AudioTrack*) t;
-		// Ignore unprocessed tracks which have an output route, because they will be processed by
-		//  whatever track(s) they are routed to.
+		AudioTrack* track = (AudioTrack*) t;
 		if (!track->processed() && track->noOutRoute() && (track->type() != Track::AUDIO_OUTPUT))
 		{
-			channels = track->channels();
+			int channels = track->channels();
 			// Just a dummy buffer.
 			float* buffer[channels];
 			float data[frames * channels];
 			for (int i = 0; i < channels; ++i)
 				buffer[i] = data + i * frames;
-			//printf("Audio::process1 calling track->copyData for track:%s\n", track->name().toLatin1());
-
 			track->copyData(samplePos, channels, -1, -1, frames, buffer);
 		}
 	}
 }
 
+//---------------------------------------------------------
+//   ProcessPlan
+//---------------------------------------------------------
+
+ProcessPlan::ProcessPlan(unsigned n)
+{
+	serial = 0;
+	frames = n;
+	posix_memalign((void**) &data, 16, sizeof (float) * frames * MAX_CHANNELS);
+	for (int i = 0; i < MAX_CHANNELS; ++i)
+		buffer[i] = data + i * frames;
+}
+
+ProcessPlan::~ProcessPlan()
+{
+	free(data);
+}
+
+//---------------------------------------------------------
+//   topologyChanged
+//    Called in the audio thread by every message which
+//    can change tracks or routes. Outdates the plan and
+//    asks the gui thread for a new one.
+//---------------------------------------------------------
+
+void Audio::topologyChanged()
+{
+	_topologyDirty = true;
+	__atomic_add_fetch(&_topologySerial, 1, __ATOMIC_RELEASE);
+	sendMsgToGui('T');
+}
+
+//---------------------------------------------------------
+//   updateTopology
+//    called from process1() after topologyChanged()
+//---------------------------------------------------------
+
+void Audio::updateTopology()
+{
+	// Use the supplied buffers directly if there is only one (or no) output route.
+	//  The metronome is not part of the track list, and it has no in or out routes,
+	//  yet multiple output tracks may call addData on it !
+	TrackList* tl = song->tracks();
+	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
+	{
+		Track* t = *it;
+		if (!t || t->isMidiTrack())
+			continue;
+		AudioTrack* track = (AudioTrack*) t;
+		track->setDirectBuffer((track->outRoutes()->size() <= 1) || (track->type() == Track::AUDIO_OUTPUT));
+	}
+	((AudioTrack*) metronome)->setDirectBuffer(false);
+
+	_topologyDirty = false;
+}
+
+//---------------------------------------------------------
+//   updatePlan
+//    gui thread, after topologyChanged()
+//---------------------------------------------------------
+
+void Audio::updatePlan()
+{
+	// Several route changes may have been signalled at once.
+	unsigned serial = topologySerial();
+	if (serial == _planSerial)
+		return;
+	_planSerial = serial;
+	msgSetPlan(compilePlan(serial));
+}
+
+static bool midiInputLess(const MidiInputRoute& a, const MidiInputRoute& b)
+{
+	return a.port < b.port;
+}
+
+//---------------------------------------------------------
+//   compilePlan
+//    Build the process plan from the track list and the
+//    routes. Called from updatePlan() in the gui thread,
+//    the audio thread only reads them meanwhile.
+//---------------------------------------------------------
+
+ProcessPlan* Audio::compilePlan(unsigned serial)
+{
+	TrackList* tl = song->tracks();
+	ProcessPlan* plan = new ProcessPlan(segmentSize);
+	plan->serial = serial;
+
+	//
+	// sort the audio tracks topologically, sources first
+	//
+	std::map<AudioTrack*, int> inputs;
+	std::vector<AudioTrack*> all;
+	std::vector<AudioTrack*> sorted;
+	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
+	{
+		Track* t = *it;
+		if (!t || t->isMidiTrack())
+			continue;
+		AudioTrack* track = (AudioTrack*) t;
+		int n = 0;
+		const RouteList* irl = track->inRoutes();
+		for (ciRoute ir = irl->begin(); ir != irl->end(); ++ir)
+		{
+			if (ir->type == Route::TRACK_ROUTE && ir->track && !ir->track->isMidiTrack())
+				++n;
+		}
+		inputs[track] = n;
+		all.push_back(track);
+	}
+	for (unsigned k = 0; k < all.size(); ++k)
+	{
+		if (inputs[all[k]] == 0)
+			sorted.push_back(all[k]);
+	}
+	for (unsigned k = 0; k < sorted.size(); ++k)
+	{
+		const RouteList* orl = sorted[k]->outRoutes();
+		for (ciRoute ir = orl->begin(); ir != orl->end(); ++ir)
+		{
+			if (ir->type != Route::TRACK_ROUTE || !ir->track || ir->track->isMidiTrack())
+				continue;
+			std::map<AudioTrack*, int>::iterator in = inputs.find((AudioTrack*) ir->track);
+			if (in != inputs.end() && --in->second == 0)
+				sorted.push_back(in->first);
+		}
+	}
+	if (sorted.size() != all.size())
+	{
+		// Feedback loop in the routes. Pull processing copes with that, just keep the rest in list order.
+		if (debugMsg)
+			printf("Audio::compilePlan: routes contain a loop\n");
+		for (unsigned k = 0; k < all.size(); ++k)
+		{
+			if (inputs[all[k]] > 0)
+				sorted.push_back(all[k]);
+		}
+	}
+
+	// Auxes are left to their consumers, so they still come after the
+	//  tracks sending to them, like before.
+	for (std::vector<AudioTrack*>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+	{
+		AudioTrack* track = *it;
+		if (track->type() == Track::AUDIO_SOFTSYNTH)
+			plan->preProcess.push_back(track);
+		if (track->preRenderable())
+			plan->preRender.push_back(track);
+		if (track->outRoutes()->size() > 1 && track->type() != Track::AUDIO_OUTPUT
+				&& track->type() != Track::AUDIO_AUX)
+			plan->order.push_back(track);
+	}
+	OutputList* ol = song->outputs();
+	for (ciAudioOutput i = ol->begin(); i != ol->end(); ++i)
+		plan->order.push_back(*i);
+	for (std::vector<AudioTrack*>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+	{
+		AudioTrack* track = *it;
+		if (track->noOutRoute() && (track->type() != Track::AUDIO_OUTPUT))
+			plan->order.push_back(track);
+	}
+
+	//
+	// midi input routes, for recording and echo in processMidi()
+	//
+	MidiTrackList* mtl = song->midis();
+	for (iMidiTrack it = mtl->begin(); it != mtl->end(); ++it)
+	{
+		const RouteList* irl = (*it)->inRoutes();
+		for (ciRoute r = irl->begin(); r != irl->end(); ++r)
+		{
+			if (!r->isValid() || r->type != Route::MIDI_PORT_ROUTE || r->midiPort == -1)
+				continue;
+			if (r->channel == -1 || r->channel == 0)
+				continue;
+			MidiInputRoute ir;
+			ir.port = r->midiPort;
+			ir.channelMask = r->channel;
+			ir.track = *it;
+			plan->midiInputs.push_back(ir);
+		}
+	}
+	// Keep the track order within a port.
+	std::stable_sort(plan->midiInputs.begin(), plan->midiInputs.end(), midiInputLess);
+	return plan;
+}
+
+//---------------------------------------------------------
+//   preRenderTrack
+//    called by audioWorkers->run() from process1()
+//---------------------------------------------------------
+
+void Audio::preRenderTrack(void* p, int idx)
+{
+	Audio* a = (Audio*) p;
+	a->_preRenderList[idx]->preRender(a->_preRenderPos, a->_preRenderFrames);
+}
+
+//---------------------------------------------------------
+//   processMsgQueue
+//    called from the audio thread at the start of a cycle.
+//    Handles queued messages in order, but stops after a
+//    quarter of the period to leave time for the audio.
+//---------------------------------------------------------
+
+void Audio::processMsgQueue(unsigned frames)
+{
+	if (_msgRing.empty())
+		return;
+
+	double deadline = curTime() + 0.25 * frames / sampleRate;
+	bool haveDone = false;
+	do
+	{
+		AudioMsgSlot slot = _msgQueue[_msgRing.readIndex()];
+		_msgRing.pop();
+		processMsg(slot.msg);
+		if (slot.sync)
+		{
+			int sn = slot.msg->serialNo;
+			int rv = write(fromThreadFdw, &sn, sizeof (int));
+			if (rv != sizeof (int))
+			{
+				fprintf(stderr, "audio: write(%d) pipe failed: %s\n",
+						fromThreadFdw, strerror(errno));
+			}
+		}
+		else
+		{
+			// Never full, sendMsgAsync() limits the pending messages.
+			_msgDoneQueue[_msgDoneRing.writeIndex()] = slot;
+			_msgDoneRing.push();
+			haveDone = true;
+		}
+	} while (!_msgRing.empty() && curTime() < deadline);
+
+	if (haveDone)
+		sendMsgToGui('M');
+}
+
+//---------------------------------------------------------
+//   changesTopology
+//    true for messages which can add or remove audio
+//    tracks, change routes or channels
+//---------------------------------------------------------
+
+static bool changesTopology(int id)
+{
+	switch (id)
+	{
+		case AUDIO_ROUTEADD:
+		case AUDIO_ROUTEREMOVE:
+		case AUDIO_REMOVEROUTES:
+		case AUDIO_SET_CHANNELS:
+		case AUDIO_SET_SEG_SIZE:
+		case SEQM_ADD_TRACK:
+		case SEQM_REMOVE_TRACK:
+		case SEQM_REMOVE_TRACK_GROUP:
+		case SEQM_CHANGE_TRACK:
+		case SEQM_MOVE_TRACK:
+		case SEQM_UNDO:
+		case SEQM_REDO:
+		case SEQM_IDLE: // the gui changes the song freely while idle
+			return true;
+		default:
+			return false;
+	}
+}
+
+//---------------------------------------------------------
+//   partEdited
+//    The events of part change, and so do the ones of its
+//    clones, which share the event list.
+//---------------------------------------------------------
+
+static void partEdited(Part* part)
+{
+	if (part == 0)
+		return;
+	Part* p = part;
+	do
+	{
+		Track* t = p->track();
+		if (t && t->isMidiTrack())
+			__atomic_add_fetch(&((MidiTrack*) t)->editSerial, 1, __ATOMIC_RELEASE);
+		p = p->nextClone();
+	} while (p && p != part);
+}
+
+//---------------------------------------------------------
+//   markEdited
+//    Bump the edit serial of the tracks whose parts or
+//    events a message changes, before it is processed,
+//    so the playback snapshots of only those tracks go
+//    out of date. Undo and redo can change any track,
+//    as can the gui while the audio thread is idle.
+//---------------------------------------------------------
+
+void Audio::markEdited(AudioMsg* msg)
+{
+	switch (msg->id)
+	{
+		case SEQM_ADD_TRACK:
+		case SEQM_REMOVE_TRACK:
+			if (msg->track->isMidiTrack())
+				__atomic_add_fetch(&((MidiTrack*) msg->track)->editSerial, 1, __ATOMIC_RELEASE);
+			break;
+		case SEQM_CHANGE_TRACK:
+			if (((Track*) msg->p1)->isMidiTrack())
+				__atomic_add_fetch(&((MidiTrack*) msg->p1)->editSerial, 1, __ATOMIC_RELEASE);
+			break;
+		case SEQM_ADD_PART:
+		case SEQM_REMOVE_PART:
+			partEdited((Part*) msg->p1);
+			break;
+		case SEQM_REMOVE_PART_LIST:
+			for (int i = 0; i < msg->plist.size(); ++i)
+				partEdited(msg->plist.at(i));
+			break;
+		case SEQM_CHANGE_PART:
+			partEdited((Part*) msg->p1);
+			partEdited((Part*) msg->p2);
+			break;
+		case SEQM_ADD_EVENT:
+		case SEQM_REMOVE_EVENT:
+			partEdited((Part*) msg->p2);
+			break;
+		case SEQM_CHANGE_EVENT:
+			partEdited((Part*) msg->p3);
+			break;
+		case SEQM_ADD_EVENT_CHECK:
+			if (msg->track->parts())
+				partEdited(msg->track->parts()->findAtTick(msg->ev1.tick()));
+			break;
+		case SEQM_EDIT_TRANSACTION:
+		{
+			EditTransaction* t = (EditTransaction*) msg->p1;
+			for (EditTransaction::iterator i = t->begin(); i != t->end(); ++i)
+				partEdited(i->part);
+		}
+			break;
+		case SEQM_UNDO:
+		case SEQM_REDO:
+			__atomic_add_fetch(&_editSerial, 1, __ATOMIC_RELEASE);
+			break;
+		case SEQM_IDLE:
+			if (!msg->a)
+			{
+				__atomic_add_fetch(&_editSerial, 1, __ATOMIC_RELEASE);
+				sendMsgToGui('I');
+			}
+			break;
+		default:
+			break;
+	}
+}
+
 //---------------------------------------------------------
 //   processMsg
 //---------------------------------------------------------
 
 void Audio::processMsg(AudioMsg* msg)
 {
+	markEdited(msg);
 	switch (msg->id)
 	{
 		case AUDIO_RECORD:
@@ -702,7 +1135,7 @@ void Audio::processMsg(AudioMsg* msg)
 #endif
 			break;
 		case SEQM_RESET_DEVICES:
-			for (int i = 0; i < MIDI_PORTS; ++i)
+			for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))
 			{
 				if(midiPorts[i].device())
 					midiPorts[i].instrument()->reset(i, song->mtype());
@@ -772,18 +1205,48 @@ void Audio::processMsg(AudioMsg* msg)
 		case SEQM_REMAP_PORT_DRUM_CTL_EVS:
 		case SEQM_CHANGE_ALL_PORT_DRUM_CTL_EVS:
 		case SEQM_PRELOAD_PROGRAM:
+			++_playCursorSerial;
 			midiSeq->sendMsg(msg);
 			break;
 
 		case SEQM_IDLE:
+			++_playCursorSerial;
 			idle = msg->a;
 			midiSeq->sendMsg(msg);
 			break;
 
+		case AUDIO_SET_PLAY_SNAPSHOT:
+		{
+			// The old one goes back to the gui thread for deletion.
+			MidiTrack* track = (MidiTrack*) msg->track;
+			msg->p2 = track->playSnapshot;
+			__atomic_store_n(&track->playSnapshot, (MidiPlaySnapshot*) msg->p1, __ATOMIC_RELEASE);
+		}
+			break;
+
+		case AUDIO_SET_PLAN:
+		{
+			// The old plan, or the new one if routes changed again while it was
+			//  built, goes back to the gui thread for deletion.
+			ProcessPlan* plan = (ProcessPlan*) msg->p1;
+			if (plan->serial == _topologySerial)
+			{
+				msg->p2 = _plan;
+				_plan = plan;
+			}
+			else
+				msg->p2 = plan;
+		}
+			break;
+
 		default:
+			// event and undo messages
+			++_playCursorSerial;
 			song->processMsg(msg);
 			break;
 	}
+	if (changesTopology(msg->id))
+		topologyChanged();
 }
 
 //---------------------------------------------------------
@@ -803,6 +1266,7 @@ void Audio::seek(const Pos& p)
 
 	//printf("Audio::seek frame:%d\n", p.frame());
 	_pos = p;
+	++_playCursorSerial;
 	if (!checkAudioDevice()) return;
 	syncFrame = audioDevice->framePos();
 	frameOffset = syncFrame - _pos.frame();
@@ -815,7 +1279,7 @@ void Audio::seek(const Pos& p)
 	if (!extSyncFlag.value())
 	{
 
-		for (int port = 0; port < MIDI_PORTS; ++port)
+		for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
 		{
 			MidiPort* mp = &midiPorts[port];
 			MidiDevice* dev = mp->device();
@@ -903,7 +1367,7 @@ void Audio::startRolling()
 	if (!extSyncFlag.value())
 	{
 
-		for (int port = 0; port < MIDI_PORTS; ++port)
+		for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
 		{
 			MidiPort* mp = &midiPorts[port];
 			MidiDevice* dev = mp->device();
@@ -959,7 +1423,7 @@ void Audio::startRolling()
 	}
 
 	// reenable sustain
-	for (int i = 0; i < MIDI_PORTS; ++i)
+	for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))
 	{
 		MidiPort* mp = &midiPorts[i];
 		for (int ch = 0; ch < MIDI_CHANNELS; ++ch)
@@ -995,7 +1459,7 @@ void Audio::stopRolling()
 
 
 	// clear sustain
-	for (int i = 0; i < MIDI_PORTS; ++i)
+	for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))
 	{
 		MidiPort* mp = &midiPorts[i];
 		for (int ch = 0; ch < MIDI_CHANNELS; ++ch)
@@ -1020,7 +1484,7 @@ void Audio::stopRolling()
 	// Don't send if external sync is on. The master, and our sync routing system will take care of that.
 	if (!extSyncFlag.value())
 	{
-		for (int port = 0; port < MIDI_PORTS; ++port)
+		for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
 		{
 			MidiPort* mp = &midiPorts[port];
 			MidiDevice* dev = mp->device();
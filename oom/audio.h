@@ -14,9 +14,16 @@
 #include "mpevent.h"
 #include "route.h"
 #include "event.h"
+#include "globaldefs.h"
+#include "spscring.h"
+#include "tempo.h"
+#include <pthread.h>
+#include <stdlib.h>
 #include <QList>
+#include <vector>
 
 class SndFile;
+class EditTransaction;
 class BasePlugin;
 class SynthI;
 class MidiDevice;
@@ -31,6 +38,7 @@ class MidiPort;
 class EventList;
 class MidiInstrument;
 class MidiTrack;
+class MidiPlaySnapshot;
 
 //---------------------------------------------------------
 //   AudioMsgId
@@ -78,7 +86,10 @@ enum
     AUDIO_ADD_AC_EVENT,
     AUDIO_SET_SOLO, AUDIO_SET_SEND_METRONOME,
     MS_PROCESS, MS_STOP, MS_SET_RTC, MS_UPDATE_POLL_FD,
-    SEQM_IDLE, SEQM_SEEK, SEQM_PRELOAD_PROGRAM, SEQM_REMOVE_TRACK_GROUP
+    SEQM_IDLE, SEQM_SEEK, SEQM_PRELOAD_PROGRAM, SEQM_REMOVE_TRACK_GROUP,
+    SEQM_EDIT_TRANSACTION,
+    AUDIO_SET_PLAY_SNAPSHOT,
+    AUDIO_SET_PLAN
 };
 
 extern const char* seqMsgList[]; // for debug
@@ -115,6 +126,20 @@ struct AudioMsg : public ThreadMsg
 	QList<void*> objectList;
 };
 
+// Called when an asynchronous message has been processed,
+//  see Audio::sendMsgAsync().
+typedef void (*AudioMsgCallback)(AudioMsg* msg, void* data);
+
+// Number of messages which can be queued for the audio thread.
+#define AUDIO_MSG_QUEUE_SIZE 256
+
+struct AudioMsgSlot {
+    AudioMsg* msg;
+    AudioMsgCallback callback;
+    void* data;
+    bool sync; // a sender is waiting on the message pipe
+};
+
 //---------------------------------------------------------
 //  Struct for controll preload processing
 //---------------------------------------------------------
@@ -126,6 +151,47 @@ struct ProcessList {
 
 class AudioOutput;
 
+//---------------------------------------------------------
+//   MidiInputRoute
+//    a midi port routed to a midi track, for recording
+//---------------------------------------------------------
+
+struct MidiInputRoute
+{
+    int port;
+    int channelMask;
+    MidiTrack* track;
+};
+
+//---------------------------------------------------------
+//   ProcessPlan
+//    The order in which process1() renders the audio
+//    tracks. Built by Audio::compilePlan() in the gui
+//    thread after the tracks or routes changed, and
+//    handed to the audio thread with msgSetPlan(). The
+//    audio thread never changes it and only uses it while
+//    its serial is current.
+//---------------------------------------------------------
+
+struct ProcessPlan
+{
+    unsigned serial; // Audio::topologySerial() it was built for
+    // Tracks process1() renders itself: tracks with several consumers,
+    //  sources first, then the outputs in list order, then the tracks
+    //  whose output leads nowhere. Every other track is pulled by its
+    //  only consumer.
+    std::vector<AudioTrack*> order;
+    std::vector<AudioTrack*> preProcess; // tracks needing preProcessAlways()
+    std::vector<AudioTrack*> preRender; // candidates for parallel rendering
+    std::vector<MidiInputRoute> midiInputs; // midi port routes to tracks, grouped by port
+    float* buffer[MAX_CHANNELS]; // dummy output for the tracks in order
+    float* data;
+    unsigned frames;
+
+    ProcessPlan(unsigned frames);
+    ~ProcessPlan();
+};
+
 //---------------------------------------------------------
 //   Audio
 //---------------------------------------------------------
@@ -166,7 +232,18 @@ private:
 
     State state;
 
-    AudioMsg* msg;
+    // Messages from the gui (and other threads) to the audio thread.
+    //  Only the audio thread reads _msgQueue; senders serialize on
+    //  _msgQueueLock. Processed asynchronous messages go back through
+    //  _msgDoneQueue so that they are deleted outside the audio thread.
+    SPSCRing _msgRing;
+    AudioMsgSlot _msgQueue[AUDIO_MSG_QUEUE_SIZE];
+    SPSCRing _msgDoneRing;
+    AudioMsgSlot _msgDoneQueue[AUDIO_MSG_QUEUE_SIZE];
+    int _msgsPending; // asynchronous messages not yet called back
+    pthread_mutex_t _msgQueueLock;
+    pthread_mutex_t _msgSyncLock; // one synchronous sender at a time
+    pthread_mutex_t _msgDoneLock;
     int fromThreadFdw, fromThreadFdr; // message pipe
 
     int sigFd; // pipe fd for messages to gui
@@ -179,6 +256,34 @@ private:
     AudioOutput* _audioMaster;
     AudioOutput* _audioMonitor;
 
+    // Process plan, see ProcessPlan. Only the audio thread touches _plan.
+    //  _topologySerial is changed by every message which can change tracks
+    //  or routes, the gui thread then builds a new plan, see updatePlan().
+    //  Until that arrives process1() works from the track list.
+    ProcessPlan* _plan;
+    unsigned _topologySerial;
+    unsigned _planSerial; // gui thread, serial of the last plan built
+    bool _topologyDirty; // direct buffers to update
+    ProcessPlan* compilePlan(unsigned serial);
+    void topologyChanged();
+    void updateTopology();
+    void processPlanned(ProcessPlan*, unsigned samplePos, unsigned offset, unsigned frames);
+    void processUnplanned(unsigned samplePos, unsigned offset, unsigned frames);
+
+    // Changed by song edits and seeks, makes the midi tracks'
+    //  play cursors start over, see collectEvents().
+    unsigned _playCursorSerial;
+    // Changed by undo, redo and the end of idle, outdates all compiled
+    //  playback snapshots. Other edits change MidiTrack::editSerial.
+    unsigned _editSerial;
+    TempoCursor _tempoCursor; // for collectEvents()
+
+    // tracks rendered in parallel by the audio workers, see process1()
+    std::vector<AudioTrack*> _preRenderList;
+    unsigned _preRenderPos;
+    unsigned _preRenderFrames;
+    static void preRenderTrack(void*, int);
+
     void sendLocalOff();
     bool filterEvent(const MidiPlayEvent* event, int type, bool thru);
 
@@ -187,15 +292,29 @@ private:
 
     void panic();
     void processMsg(AudioMsg* msg);
+    void markEdited(AudioMsg* msg);
+    void queueMsg(AudioMsg* msg, AudioMsgCallback callback, void* data, bool sync);
+    void processMsgQueue(unsigned frames);
+    void flushMsgQueue();
     void process1(unsigned samplePos, unsigned offset, unsigned samples);
 
     void collectEvents(MidiTrack*, unsigned int startTick, unsigned int endTick);
+    void collectEvent(MidiTrack*, MidiDevice*, const Event&, unsigned offset);
+    void collectSnapshotEvents(MidiTrack*, MidiPlaySnapshot*, unsigned int startTick, unsigned int endTick);
+    void recordMidiSysex(MidiTrack*, MidiDevice*, bool extsync);
+    void recordMidiChannel(MidiTrack*, MidiDevice*, int inPort, int channel, bool extsync);
+    void recordMidiInputs(const std::vector<MidiInputRoute>&, bool extsync);
+    void recordMidiRoutes(bool extsync);
 
 public:
     Audio();
 
     virtual ~Audio()
     {
+        delete _plan;
+        pthread_mutex_destroy(&_msgQueueLock);
+        pthread_mutex_destroy(&_msgSyncLock);
+        pthread_mutex_destroy(&_msgDoneLock);
     }
 
     void process(unsigned frames);
@@ -228,6 +347,18 @@ public:
         return _running;
     }
 
+    unsigned topologySerial() const
+    {
+        return __atomic_load_n(&_topologySerial, __ATOMIC_ACQUIRE);
+    }
+
+    void updatePlan();
+
+    unsigned editSerial() const
+    {
+        return __atomic_load_n(&_editSerial, __ATOMIC_ACQUIRE);
+    }
+
     //-----------------------------------------
     //   message interface
     //-----------------------------------------
@@ -251,6 +382,9 @@ public:
     void msgDeleteEvent(Event&, Part*, bool u = true, bool doCtrls = true, bool doClones = false, bool waitRead = true);
     //void msgChangeEvent(Event&, Event&, Part*, bool u = true);
     void msgChangeEvent(Event&, Event&, Part*, bool u = true, bool doCtrls = true, bool doClones = false, bool waitRead = true);
+    void msgEditTransaction(EditTransaction&, bool doUndoFlag = true);
+    void msgSetPlaySnapshot(MidiTrack*, MidiPlaySnapshot*);
+    void msgSetPlan(ProcessPlan*);
     void msgScanAlsaMidiPorts();
     void msgAddTempo(int tick, int tempo, bool doUndoFlag = true);
     void msgSetTempo(int tick, int tempo, bool doUndoFlag = true);
@@ -265,6 +399,8 @@ public:
     void msgShowInstrumentNativeGui(MidiInstrument*, bool);
     void msgPanic();
     void sendMsg(AudioMsg*, bool waitRead = true);
+    void sendMsgAsync(AudioMsg*, AudioMsgCallback callback = 0, void* data = 0);
+    void processMsgCallbacks();
     bool sendMessage(AudioMsg* m, bool doUndo, bool waitRead = true);
     void msgRemoveRoute(Route, Route);
     void msgRemoveRoute1(Route, Route);
@@ -344,6 +480,11 @@ public:
     {
         return curTickPos;
     }
+
+    unsigned nextTick() const
+    {
+        return nextTickPos;
+    }
     int timestamp() const;
     void processMidi();
     unsigned curFrame() const;
@@ -6,17 +6,23 @@
 //  (C) Copyright 2001 Werner Schweer (ws@seh.de)
 //=========================================================
 
+#include <errno.h>
 #include <poll.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <values.h>
+#include <algorithm>
 
 #include "audioprefetch.h"
+#include "clipcache.h"
 #include "globals.h"
 #include "track.h"
 #include "song.h"
 #include "audio.h"
 #include "sync.h"
+#include "gconfig.h"
+#include "utils.h"
 
 // Added by Tim. p3.3.20
 //#define AUDIOPREFETCH_DEBUG
@@ -37,6 +43,55 @@ struct PrefetchMsg : public ThreadMsg
 
 AudioPrefetch* audioPrefetch;
 
+//---------------------------------------------------------
+//   PrefetchStats
+//---------------------------------------------------------
+
+void PrefetchStats::clear()
+{
+	refills = 0;
+	segments = 0;
+	late = 0;
+	underruns = 0;
+	maxQueued = 0;
+	readTime = 0.0;
+	maxRead = 0.0;
+	maxWait = 0.0;
+}
+
+void PrefetchStats::add(const PrefetchStats& s)
+{
+	refills += s.refills;
+	segments += s.segments;
+	late += s.late;
+	underruns += s.underruns;
+	readTime += s.readTime;
+	if (s.maxQueued > maxQueued)
+		maxQueued = s.maxQueued;
+	if (s.maxRead > maxRead)
+		maxRead = s.maxRead;
+	if (s.maxWait > maxWait)
+		maxWait = s.maxWait;
+}
+
+void PrefetchStats::dump() const
+{
+	printf("prefetch: %u refills, %u segments, %u late, %u underruns, max queued %d\n",
+			refills, segments, late, underruns, maxQueued);
+	printf("prefetch: read %.3f s (%.3f ms/segment, max %.3f ms), max wait %.3f ms\n",
+			readTime, segments ? readTime * 1000.0 / segments : 0.0, maxRead * 1000.0, maxWait * 1000.0);
+}
+
+//---------------------------------------------------------
+//   laterDeadline
+//    heap order of the refills, earliest deadline on top
+//---------------------------------------------------------
+
+static bool laterDeadline(const PrefetchJob& a, const PrefetchJob& b)
+{
+	return a.deadline > b.deadline;
+}
+
 //---------------------------------------------------------
 //   AudioPrefetch
 //---------------------------------------------------------
@@ -51,6 +106,15 @@ AudioPrefetch::AudioPrefetch(const char* name)
 	writePos = ~0;
 	//seekDone = true;
 	seekCount = 0;
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_wake, 0);
+	_readers = 0;
+	_nreaders = 0;
+	_quit = false;
+	_active = 0;
+	sem_init(&_idle, 0, 0);
+	_idleWaiters = 0;
+	_generation = 0;
 }
 
 //---------------------------------------------------------
@@ -63,6 +127,16 @@ static void readMsgP(void* p, void*)
 	at->readMsg1(sizeof (PrefetchMsg));
 }
 
+//---------------------------------------------------------
+//   readerThread
+//---------------------------------------------------------
+
+static void* readerThread(void* p)
+{
+	((AudioPrefetch*) p)->readerLoop();
+	return 0;
+}
+
 //---------------------------------------------------------
 //   start
 //---------------------------------------------------------
@@ -73,16 +147,120 @@ void AudioPrefetch::start(int priority)
 {
 	clearPollFd();
 	addPollFd(toThreadFdr, POLLIN, ::readMsgP, this, 0);
+	startReaders(priority);
 	//Thread::start();
 	Thread::start(priority);
 }
 
+//---------------------------------------------------------
+//   threadStop
+//---------------------------------------------------------
+
+void AudioPrefetch::threadStop()
+{
+	stopReaders();
+}
+
 //---------------------------------------------------------
 //   ~AudioPrefetch
 //---------------------------------------------------------
 
 AudioPrefetch::~AudioPrefetch()
 {
+	stopReaders();
+	sem_destroy(&_idle);
+	pthread_cond_destroy(&_wake);
+	pthread_mutex_destroy(&_lock);
+}
+
+//---------------------------------------------------------
+//   startReaders
+//    the disk readers run at the priority of the
+//    prefetch thread
+//---------------------------------------------------------
+
+void AudioPrefetch::startReaders(int priority)
+{
+	stopReaders();
+
+	int n = config.prefetchThreads;
+	if (n < 1)
+		n = 1;
+
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	if (priority)
+	{
+		if (pthread_attr_setschedpolicy(&attributes, SCHED_FIFO))
+			printf("cannot set FIFO scheduling class for prefetch reader thread\n");
+		if (pthread_attr_setscope(&attributes, PTHREAD_SCOPE_SYSTEM))
+			printf("Cannot set scheduling scope for prefetch reader thread\n");
+		if (pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED))
+			printf("Cannot set setinheritsched for prefetch reader thread\n");
+
+		struct sched_param rt_param;
+		memset(&rt_param, 0, sizeof (rt_param));
+		rt_param.sched_priority = priority;
+		if (pthread_attr_setschedparam(&attributes, &rt_param))
+			printf("Cannot set scheduling priority %d for prefetch reader thread (%s)\n", priority, strerror(errno));
+	}
+
+	_quit = false;
+	_readers = new pthread_t[n];
+	int created = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		int rv = pthread_create(&_readers[created], priority ? &attributes : 0, readerThread, this);
+		// Retry without realtime scheduling if we are not allowed to use it.
+		if (rv == EPERM && priority)
+			rv = pthread_create(&_readers[created], 0, readerThread, this);
+		if (rv)
+		{
+			// schedule() does the reading itself if there is no reader
+			fprintf(stderr, "creating prefetch reader thread failed: %s\n", strerror(rv));
+			break;
+		}
+		++created;
+	}
+	pthread_attr_destroy(&attributes);
+	_nreaders = created;
+	if (debugMsg)
+		printf("AudioPrefetch::startReaders: %d reader threads, priority %d\n", _nreaders, priority);
+}
+
+//---------------------------------------------------------
+//   stopReaders
+//    refills being run are finished, queued ones dropped
+//---------------------------------------------------------
+
+void AudioPrefetch::stopReaders()
+{
+	if (!_readers)
+		return;
+
+	pthread_mutex_lock(&_lock);
+	_quit = true;
+	for (std::vector<PrefetchJob>::iterator i = _jobs.begin(); i != _jobs.end(); ++i)
+		i->track->setPrefetchQueued(false);
+	_jobs.clear();
+	pthread_cond_broadcast(&_wake);
+	if (_active == 0)
+		wakeWaiters();
+	pthread_mutex_unlock(&_lock);
+
+	for (int i = 0; i < _nreaders; ++i)
+		pthread_join(_readers[i], 0);
+	delete[] _readers;
+	_readers = 0;
+	_nreaders = 0;
+
+	if (debugMsg)
+	{
+		PrefetchStats s;
+		stats(&s, true);
+		s.dump();
+		clipCache.dump();
+	}
 }
 
 //---------------------------------------------------------
@@ -100,10 +278,16 @@ void AudioPrefetch::processMsg1(const void* m)
 				//puts("writeTick");
 				audio->writeTick();
 			}
-			// Indicate do not seek file before each read.
-			// Changed by Tim. p3.3.17
-			//prefetch();
-			prefetch(false);
+			if (writePos == ~0U)
+			{
+				printf("AudioPrefetch::prefetch: invalid write position\n");
+				break;
+			}
+			schedule();
+			// clips admitted by the refills are decoded here,
+			// one per tick, not in the refill that missed
+			clipCache.loadPending();
+			writePos = loopPos(writePos) + segmentSize;
 
 			seekPos = ~0; // invalidate cached last seek position
 			break;
@@ -148,6 +332,8 @@ void AudioPrefetch::msgSeek(unsigned samplePos, bool force)
 	}
 
 	++seekCount;
+	// let a seek waiting for the readers give up, see waitReaders()
+	sem_post(&_idle);
 	//seekDone = false;
 
 #ifdef AUDIOPREFETCH_DEBUG
@@ -165,57 +351,253 @@ void AudioPrefetch::msgSeek(unsigned samplePos, bool force)
 }
 
 //---------------------------------------------------------
-//   prefetch
+//   loopPos
+//    where to read a segment meant for pos
 //---------------------------------------------------------
 
-//void AudioPrefetch::prefetch()
-
-void AudioPrefetch::prefetch(bool doSeek)
+unsigned AudioPrefetch::loopPos(unsigned pos) const
 {
-	if (writePos == ~0U)
-	{
-		printf("AudioPrefetch::prefetch: invalid write position\n");
-		return;
-	}
 	if (song->loop() && !audio->bounce() && !extSyncFlag.value())
 	{
 		const Pos& loop = song->rPos();
-		unsigned n = loop.frame() - writePos;
+		unsigned n = loop.frame() - pos;
 		if (n < segmentSize)
 		{
 			unsigned lpos = song->lPos().frame();
 			// adjust loop start so we get exact loop len
 			if (n > lpos)
 				n = 0;
-			// printf("prefetch seek %d\n", writePos);
-			writePos = lpos - n;
+			// printf("prefetch seek %d\n", pos);
+			pos = lpos - n;
 		}
 	}
+	return pos;
+}
+
+//---------------------------------------------------------
+//   schedule
+//    queue a refill for every track whose fifo is not
+//    full. The deadline is the time the data in the fifo
+//    lasts from now.
+//---------------------------------------------------------
+
+void AudioPrefetch::schedule()
+{
+	// In freewheel mode the audio thread reads the sound files
+	//  itself, see WaveTrack::getData().
+	if (audio->freewheel())
+		return;
+	double now = curTime();
+	double segmentTime = double(segmentSize) / sampleRate;
+	int target = fifoLength - 1;
+	bool queued = false;
+
+	pthread_mutex_lock(&_lock);
 	WaveTrackList* tl = song->waves();
 	for (iWaveTrack it = tl->begin(); it != tl->end(); ++it)
 	{
 		WaveTrack* track = *it;
+		if (track->prefetchQueued())
+			continue;
 		// p3.3.29
 		// Save time. Don't bother if track is off. Track On/Off not designed for rapid repeated response (but mute is).
 		if (track->off())
+		{
+			// start again at the current position when switched on
+			track->setPrefetchPos(~0);
 			continue;
+		}
+		if (track->prefetchPos() == ~0U)
+			track->setPrefetchPos(writePos, true);
+		int fill = track->prefetchFifo()->getCount();
+		if (fill >= target)
+			continue;
+
+		PrefetchJob job;
+		job.track = track;
+		job.deadline = now + fill * segmentTime;
+		job.queued = now;
+		job.generation = _generation;
+		_jobs.push_back(job);
+		std::push_heap(_jobs.begin(), _jobs.end(), laterDeadline);
+		track->setPrefetchQueued(true);
+		queued = true;
+	}
+	if (int(_jobs.size()) > _stats.maxQueued)
+		_stats.maxQueued = _jobs.size();
+	if (queued)
+		pthread_cond_broadcast(&_wake);
+	bool inThread = _nreaders == 0;
+	pthread_mutex_unlock(&_lock);
+
+	if (inThread)
+		readerLoop();
+}
+
+//---------------------------------------------------------
+//   readerLoop
+//    disk reader thread main loop. Without readers the
+//    prefetch thread runs the queued refills itself.
+//---------------------------------------------------------
 
-		int ch = track->channels();
-		float* bp[ch];
-		// printf("prefetch %d\n", writePos);
-		if (track->prefetchFifo()->getWriteBuffer(ch, segmentSize, bp, writePos))
+void AudioPrefetch::readerLoop()
+{
+	bool reader = _nreaders != 0;
+	pthread_mutex_lock(&_lock);
+	for (;;)
+	{
+		while (reader && !_quit && _jobs.empty())
+			pthread_cond_wait(&_wake, &_lock);
+		if (_quit || _jobs.empty())
+			break;
+		std::pop_heap(_jobs.begin(), _jobs.end(), laterDeadline);
+		PrefetchJob job = _jobs.back();
+		_jobs.pop_back();
+		++_active;
+		pthread_mutex_unlock(&_lock);
+
+		PrefetchStats s;
+		if (job.generation == _generation)
+			refill(job, &s);
+
+		pthread_mutex_lock(&_lock);
+		job.track->setPrefetchQueued(false);
+		_stats.add(s);
+		--_active;
+		if (_active == 0 && _jobs.empty())
+			wakeWaiters();
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   refill
+//    fill the fifo of a track up to fifoLength - 1
+//    segments, unless a seek cancels the job
+//---------------------------------------------------------
+
+void AudioPrefetch::refill(const PrefetchJob& job, PrefetchStats* s)
+{
+	WaveTrack* track = job.track;
+	Fifo* fifo = track->prefetchFifo();
+	int target = fifoLength - 1;
+	double start = curTime();
+
+	s->refills = 1;
+	s->maxWait = start - job.queued;
+	if (start > job.deadline)
+		s->late = 1;
+	if (fifo->getCount() == 0 && audio->isPlaying())
+		s->underruns = 1;
+
+	int ch = track->channels();
+	float* bp[ch];
+	while (job.generation == _generation && !_quit && fifo->getCount() < target)
+	{
+		unsigned pos = loopPos(track->prefetchPos());
+		// printf("prefetch %d\n", pos);
+		if (fifo->getWriteBuffer(ch, segmentSize, bp, pos))
 		{
 			// printf("AudioPrefetch::prefetch No write buffer!\n"); // p3.3.46 Was getting this...
-			continue;
+			break;
 		}
-		//track->fetchData(writePos, segmentSize, bp);
-		track->fetchData(writePos, segmentSize, bp, doSeek);
+		double t = curTime();
+		track->lockFetch();
+		track->fetchData(pos, segmentSize, bp, track->prefetchSeek());
+		track->unlockFetch();
+		t = curTime() - t;
+		track->setPrefetchPos(pos + segmentSize);
+
+		++s->segments;
+		s->readTime += t;
+		if (t > s->maxRead)
+			s->maxRead = t;
+	}
+}
+
+//---------------------------------------------------------
+//   cancel
+//    drop the queued refills and wait for the running
+//    ones, which stop after their current segment
+//---------------------------------------------------------
+
+void AudioPrefetch::cancel()
+{
+	pthread_mutex_lock(&_lock);
+	++_generation;
+	for (std::vector<PrefetchJob>::iterator i = _jobs.begin(); i != _jobs.end(); ++i)
+		i->track->setPrefetchQueued(false);
+	_jobs.clear();
+	if (_active == 0)
+		wakeWaiters();
+	pthread_mutex_unlock(&_lock);
+	waitReaders(false);
+}
+
+//---------------------------------------------------------
+//   wakeWaiters
+//    called with _lock held
+//---------------------------------------------------------
+
+void AudioPrefetch::wakeWaiters()
+{
+	for (int i = 0; i < _idleWaiters; ++i)
+		sem_post(&_idle);
+}
 
-		// p3.3.41
-		//fprintf(stderr, "AudioPrefetch::prefetch data: segmentSize:%ld %e %e %e %e\n", segmentSize, bp[0][0], bp[0][1], bp[0][2], bp[0][3]);
+//---------------------------------------------------------
+//   waitReaders
+//    wait until no refill is queued or running. With seek
+//    set give up and return true as soon as another seek
+//    is pending.
+//---------------------------------------------------------
 
+bool AudioPrefetch::waitReaders(bool seek)
+{
+	pthread_mutex_lock(&_lock);
+	for (;;)
+	{
+		if (_active == 0 && (_jobs.empty() || _quit))
+			break;
+		if (seek && seekCount > 1)
+		{
+			pthread_mutex_unlock(&_lock);
+			return true;
+		}
+		// A post left over from an earlier wait or seek only
+		//  makes us look again.
+		++_idleWaiters;
+		pthread_mutex_unlock(&_lock);
+		while (sem_wait(&_idle) == -1 && errno == EINTR)
+			;
+		pthread_mutex_lock(&_lock);
+		--_idleWaiters;
 	}
-	writePos += segmentSize;
+	pthread_mutex_unlock(&_lock);
+	return false;
+}
+
+//---------------------------------------------------------
+//   waitIdle
+//    for the gui, before tracks are deleted
+//---------------------------------------------------------
+
+void AudioPrefetch::waitIdle()
+{
+	waitReaders(false);
+}
+
+//---------------------------------------------------------
+//   stats
+//---------------------------------------------------------
+
+void AudioPrefetch::stats(PrefetchStats* s, bool reset)
+{
+	pthread_mutex_lock(&_lock);
+	*s = _stats;
+	if (reset)
+		_stats.clear();
+	pthread_mutex_unlock(&_lock);
 }
 
 //---------------------------------------------------------
@@ -245,35 +627,33 @@ void AudioPrefetch::seek(unsigned seekTo)
 		return;
 	}
 
-	writePos = seekTo;
+	// The fifos may only be cleared while no reader writes to them.
+	cancel();
+
 	WaveTrackList* tl = song->waves();
 	for (iWaveTrack it = tl->begin(); it != tl->end(); ++it)
 	{
 		WaveTrack* track = *it;
 		track->clearPrefetchFifo();
-	}
-
-	bool isFirstPrefetch = true;
-	for (unsigned int i = 0; i < (fifoLength) - 1; ++i)//prevent compiler warning: comparison of signed/unsigned
-	{
 		// Indicate do a seek command before read, but only on the first pass.
-		// Changed by Tim. p3.3.17
-		//prefetch();
-		prefetch(isFirstPrefetch);
+		track->setPrefetchPos(seekTo, true);
+	}
+	writePos = seekTo;
+	for (unsigned i = 0; i < fifoLength - 1; ++i)
+		writePos = loopPos(writePos) + segmentSize;
 
-		isFirstPrefetch = false;
+	// Fill all fifos in parallel.
+	schedule();
 
-		// To help speed things up even more, check the count again. Return if more seek messages are pending.
-		// Added by Tim. p3.3.20
-		if (seekCount > 1)
-		{
-			--seekCount;
-			return;
-		}
+	// To help speed things up even more, check the count again. Return if more seek messages are pending.
+	// Added by Tim. p3.3.20
+	if (waitReaders(true))
+	{
+		--seekCount;
+		return;
 	}
 
 	seekPos = seekTo;
 	//seekDone = true;
 	--seekCount;
 }
-
@@ -9,20 +9,95 @@
 #ifndef __AUDIOPREFETCH_H__
 #define __AUDIOPREFETCH_H__
 
+#include <vector>
+#include <pthread.h>
+#include <semaphore.h>
+
 #include "thread.h"
 
+class WaveTrack;
+
+//---------------------------------------------------------
+//   PrefetchStats
+//    counters of the disk readers, for tuning
+//    fifoLength and prefetchThreads
+//---------------------------------------------------------
+
+struct PrefetchStats
+{
+    unsigned refills; // refill jobs run
+    unsigned segments; // segments read
+    unsigned late; // refills started after their deadline
+    unsigned underruns; // refills started with an empty fifo while playing
+    int maxQueued; // most refills waiting at once
+    double readTime; // seconds spent reading
+    double maxRead; // longest read of one segment
+    double maxWait; // longest wait of a refill for a reader
+
+    PrefetchStats()
+    {
+        clear();
+    }
+    void clear();
+    void add(const PrefetchStats&);
+    void dump() const;
+};
+
+//---------------------------------------------------------
+//   PrefetchJob
+//    refill the fifo of a track
+//---------------------------------------------------------
+
+struct PrefetchJob
+{
+    WaveTrack* track;
+    double deadline; // curTime() at which the fifo runs dry
+    double queued; // curTime() at which the job was queued
+    int generation; // seek generation the job belongs to
+};
+
 //---------------------------------------------------------
 //   AudioPrefetch
+//    The thread takes the messages and schedules the
+//    work, the reading is done by a pool of disk reader
+//    threads. Every track has its own read position and
+//    at most one refill queued or running. The readers
+//    take the refills earliest deadline first, so tracks
+//    with an almost empty fifo do not wait behind full
+//    ones, and a slow file only holds up one reader.
 //---------------------------------------------------------
 
 class AudioPrefetch : public Thread
 {
-    unsigned writePos;
+    unsigned writePos; // where a track starting now would read from
     unsigned seekPos; // remember last seek to optimize seeks
 
+    // disk readers, _lock protects everything below and the
+    //  queued flag of the tracks
+    pthread_mutex_t _lock;
+    pthread_cond_t _wake; // refill queued or quit
+    pthread_t* _readers;
+    int _nreaders;
+    volatile bool _quit;
+    std::vector<PrefetchJob> _jobs; // heap, earliest deadline on top
+    int _active; // refills being run
+    // waitReaders() sleeps on _idle. It is posted once for every
+    //  waiter when the readers run out of work, and by msgSeek().
+    sem_t _idle;
+    int _idleWaiters;
+    volatile int _generation; // counted up by seek, cancels older refills
+    PrefetchStats _stats;
+
     virtual void processMsg1(const void*);
-    //void prefetch();
-    void prefetch(bool doSeek);
+    virtual void threadStop();
+    unsigned loopPos(unsigned pos) const;
+    void schedule();
+    void cancel();
+    void wakeWaiters();
+    bool waitReaders(bool seek);
+    void refill(const PrefetchJob&, PrefetchStats*);
+    void startReaders(int priority);
+    void stopReaders();
     void seek(unsigned pos);
 
     volatile int seekCount;
@@ -37,6 +112,9 @@ public:
 
     void msgTick();
     void msgSeek(unsigned samplePos, bool force = false);
+    void readerLoop();
+    void waitIdle();
+    void stats(PrefetchStats*, bool reset = false);
 
     //volatile bool seekDone;
 
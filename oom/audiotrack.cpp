@@ -27,6 +27,8 @@
 #include "midimonitor.h"
 
 
+unsigned AudioTrack::_processCycle = 1;
+
 //---------------------------------------------------------
 //   AudioTrack
 //---------------------------------------------------------
@@ -34,8 +36,11 @@
 AudioTrack::AudioTrack(TrackType t)
 : Track(t)
 {
-	_processed = false;
+	_processedCycle = _processCycle - 1;
+	_directBuffer = false;
 	_haveData = false;
+	_preRenderCycle = _processCycle - 1;
+	_preRenderOk = false;
 	_sendMetronome = false;
 	_prefader = false;
 	_efxPipe = new Pipeline();
@@ -64,8 +69,11 @@ AudioTrack::AudioTrack(const AudioTrack& t, bool cloneParts)
 : Track(t, cloneParts)
 {
 	_totalOutChannels = t._totalOutChannels; // Is either MAX_CHANNELS, or custom value (used by syntis).
-	_processed = false;
+	_processedCycle = _processCycle - 1;
+	_directBuffer = false;
 	_haveData = false;
+	_preRenderCycle = _processCycle - 1;
+	_preRenderOk = false;
 	_sendMetronome = t._sendMetronome;
 	_controller = t._controller;
 	_prefader = t._prefader;
@@ -680,6 +688,58 @@ double AudioTrack::pan() const
 		return cl->second->curVal();
 }
 
+//---------------------------------------------------------
+//   gainRamp
+//    Per frame left/right gains for the n frames from pos,
+//    if volume or pan automation changes during them.
+//    Returns false if the gains are constant, volume() and
+//    pan() give them then.
+//    vol receives the volume without pan, for metering.
+//---------------------------------------------------------
+
+bool AudioTrack::gainRamp(unsigned pos, unsigned n, float* g0, float* g1, float* vol)
+{
+	if (!audio->isPlaying())
+		return false;
+
+	CtrlList* vcl = 0;
+	CtrlList* pcl = 0;
+	bool vramp = false;
+	bool pramp = false;
+	if (volFromAutomation())
+	{
+		vcl = _controller.find(AC_VOLUME)->second;
+		vramp = vcl->values(pos, n, vol);
+	}
+	if (panFromAutomation())
+	{
+		pcl = _controller.find(AC_PAN)->second;
+		pramp = pcl->values(pos, n, g1);
+	}
+	if (!vramp && !pramp)
+		return false;
+
+	if (!vramp)
+	{
+		float v = vcl ? vcl->value(pos) : volume();
+		for (unsigned k = 0; k < n; ++k)
+			vol[k] = v;
+	}
+	if (!pramp)
+	{
+		float p = pcl ? pcl->value(pos) : pan();
+		for (unsigned k = 0; k < n; ++k)
+			g1[k] = p;
+	}
+	for (unsigned k = 0; k < n; ++k)
+	{
+		float p = g1[k];
+		g0[k] = vol[k] * (1.0 - p);
+		g1[k] = vol[k] * (1.0 + p);
+	}
+	return true;
+}
+
 //---------------------------------------------------------
 //   setPan
 //---------------------------------------------------------
@@ -0,0 +1,234 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "audioworkers.h"
+#include "globals.h"
+
+AudioWorkers* audioWorkers;
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+static void* workerLoop(void* p)
+{
+	((AudioWorkers*) p)->loop();
+	return 0;
+}
+
+//---------------------------------------------------------
+//   AudioWorkers
+//---------------------------------------------------------
+
+AudioWorkers::AudioWorkers()
+{
+	_threads = 0;
+	_thread = 0;
+	_running = false;
+	_quit = false;
+	_fn = 0;
+	_arg = 0;
+	_next = 0;
+	_count = 0;
+	_active = 0;
+	_mxcsr = 0;
+	sem_init(&_wake, 0, 0);
+	sem_init(&_done, 0, 0);
+	pthread_mutex_init(&_runLock, 0);
+}
+
+AudioWorkers::~AudioWorkers()
+{
+	stop();
+	sem_destroy(&_wake);
+	sem_destroy(&_done);
+	pthread_mutex_destroy(&_runLock);
+}
+
+//---------------------------------------------------------
+//   start
+//    threads is the total number of threads taking part
+//    in audio processing, including the audio thread
+//    itself. 0 means one per online cpu.
+//---------------------------------------------------------
+
+void AudioWorkers::start(int priority, int threads)
+{
+	if (_running)
+		stop();
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int n = threads - 1;
+	if (n <= 0)
+		return;
+
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	if (priority)
+	{
+		if (pthread_attr_setschedpolicy(&attributes, SCHED_FIFO))
+			printf("cannot set FIFO scheduling class for audio worker thread\n");
+		if (pthread_attr_setscope(&attributes, PTHREAD_SCOPE_SYSTEM))
+			printf("Cannot set scheduling scope for audio worker thread\n");
+		if (pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED))
+			printf("Cannot set setinheritsched for audio worker thread\n");
+
+		struct sched_param rt_param;
+		memset(&rt_param, 0, sizeof (rt_param));
+		rt_param.sched_priority = priority;
+		if (pthread_attr_setschedparam(&attributes, &rt_param))
+			printf("Cannot set scheduling priority %d for audio worker thread (%s)\n", priority, strerror(errno));
+	}
+
+	_quit = false;
+	_thread = new pthread_t[n];
+	int created = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		int rv = pthread_create(&_thread[created], priority ? &attributes : 0, workerLoop, this);
+		// A worker without realtime scheduling would hold up the
+		//  audio thread waiting for it, process serially instead.
+		if (rv == EPERM && priority)
+		{
+			fprintf(stderr, "no realtime scheduling for audio worker threads, processing tracks serially\n");
+			break;
+		}
+		if (rv)
+		{
+			fprintf(stderr, "creating audio worker thread failed: %s\n", strerror(rv));
+			break;
+		}
+		++created;
+	}
+	pthread_attr_destroy(&attributes);
+
+	_threads = created;
+	if (debugMsg)
+		printf("AudioWorkers::start: %d worker threads, priority %d\n", _threads, priority);
+	__sync_synchronize();
+	_running = _threads > 0;
+}
+
+//---------------------------------------------------------
+//   stop
+//---------------------------------------------------------
+
+void AudioWorkers::stop()
+{
+	if (!_thread)
+		return;
+
+	// Make the audio thread fall back to serial processing,
+	//  then wait for a run() which might be in progress.
+	_running = false;
+	__sync_synchronize();
+	pthread_mutex_lock(&_runLock);
+	pthread_mutex_unlock(&_runLock);
+
+	_quit = true;
+	__sync_synchronize();
+	for (int i = 0; i < _threads; ++i)
+		sem_post(&_wake);
+	for (int i = 0; i < _threads; ++i)
+		pthread_join(_thread[i], 0);
+
+	delete[] _thread;
+	_thread = 0;
+	_threads = 0;
+}
+
+//---------------------------------------------------------
+//   runItems
+//---------------------------------------------------------
+
+void AudioWorkers::runItems()
+{
+	int i;
+	while ((i = __sync_fetch_and_add(&_next, 1)) < _count)
+		_fn(_arg, i);
+}
+
+//---------------------------------------------------------
+//   loop
+//    worker thread main loop
+//---------------------------------------------------------
+
+void AudioWorkers::loop()
+{
+	for (;;)
+	{
+		while (sem_wait(&_wake) == -1 && errno == EINTR)
+			;
+		if (_quit)
+			break;
+
+#ifdef __SSE__
+		// Use the same denormal and rounding modes as the audio thread.
+		_mm_setcsr(_mxcsr);
+#endif
+		runItems();
+
+		if (__sync_sub_and_fetch(&_active, 1) == 0)
+			sem_post(&_done);
+	}
+}
+
+//---------------------------------------------------------
+//   run
+//    called from the audio thread. Calls fn(arg, i)
+//    for i in [0, n), in any order and on any thread.
+//---------------------------------------------------------
+
+void AudioWorkers::run(void (*fn)(void*, int), void* arg, int n)
+{
+	if (n <= 0)
+		return;
+
+	// Take the lock before looking at _running, stop() does the reverse.
+	//  Never block the audio thread on it: if stop() holds it, the
+	//  workers are going away anyway.
+	int wake = n - 1;
+	bool locked = wake > 0 && pthread_mutex_trylock(&_runLock) == 0;
+	if (!locked || !_running)
+	{
+		if (locked)
+			pthread_mutex_unlock(&_runLock);
+		for (int i = 0; i < n; ++i)
+			fn(arg, i);
+		return;
+	}
+	if (wake > _threads)
+		wake = _threads;
+
+	_fn = fn;
+	_arg = arg;
+	_next = 0;
+	_count = n;
+	_active = wake;
+#ifdef __SSE__
+	_mxcsr = _mm_getcsr();
+#endif
+	__sync_synchronize();
+
+	for (int i = 0; i < wake; ++i)
+		sem_post(&_wake);
+
+	runItems();
+
+	while (sem_wait(&_done) == -1 && errno == EINTR)
+		;
+	pthread_mutex_unlock(&_runLock);
+}
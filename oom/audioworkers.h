@@ -0,0 +1,67 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __AUDIOWORKERS_H__
+#define __AUDIOWORKERS_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+
+//---------------------------------------------------------
+//   AudioWorkers
+//    pool of realtime helper threads for the audio
+//    thread. run() distributes n independent work items
+//    over the pool; the calling thread takes part in the
+//    work and returns when all items are done.
+//
+//    Only tracks which do not touch shared state while
+//    rendering are handed out, see Audio::process1().
+//---------------------------------------------------------
+
+class AudioWorkers
+{
+    int _threads; // helper threads, not counting the caller
+    pthread_t* _thread;
+    sem_t _wake;
+    sem_t _done;
+    pthread_mutex_t _runLock; // held by run() while the workers are busy
+
+    volatile bool _running;
+    volatile bool _quit;
+
+    void (*_fn)(void*, int);
+    void* _arg;
+    volatile int _next;
+    volatile int _count;
+    volatile int _active;
+    unsigned int _mxcsr;
+
+    void runItems();
+
+public:
+    AudioWorkers();
+    ~AudioWorkers();
+
+    void start(int priority, int threads);
+    void stop();
+
+    void run(void (*fn)(void*, int), void* arg, int n);
+    void loop();
+
+    bool isRunning() const
+    {
+        return _running;
+    }
+
+    int threads() const
+    {
+        return _threads;
+    }
+};
+
+extern AudioWorkers* audioWorkers;
+
+#endif
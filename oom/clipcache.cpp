@@ -0,0 +1,336 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <stdio.h>
+
+#include "clipcache.h"
+#include "gconfig.h"
+#include "wave.h"
+
+ClipCache clipCache;
+
+// starts of a file before it is admitted
+static const unsigned ADMIT_USES = 2;
+
+//---------------------------------------------------------
+//   budget
+//---------------------------------------------------------
+
+static size_t budget()
+{
+	return config.clipCacheSize > 0 ? size_t(config.clipCacheSize) << 20 : 0;
+}
+
+//---------------------------------------------------------
+//   ClipCache
+//---------------------------------------------------------
+
+ClipCache::ClipCache()
+{
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_loaded, 0);
+	_loading = 0;
+	_loadDropped = false;
+	_bytes = 0;
+	_pinnedBytes = 0;
+	_hits = 0;
+	_misses = 0;
+	_evictions = 0;
+}
+
+ClipCache::~ClipCache()
+{
+	clear();
+	pthread_cond_destroy(&_loaded);
+	pthread_mutex_destroy(&_lock);
+}
+
+//---------------------------------------------------------
+//   unref
+//    called with _lock held
+//---------------------------------------------------------
+
+void ClipCache::unref(ClipCacheEntry* e)
+{
+	if (--e->refs)
+		return;
+	delete[] e->data;
+	delete e;
+}
+
+//---------------------------------------------------------
+//   evict
+//    make room for bytes, called with _lock held
+//---------------------------------------------------------
+
+void ClipCache::evict(size_t bytes)
+{
+	size_t limit = budget();
+	// every entry is spared at most once per call
+	size_t rounds = _lru.size() * 2;
+	while (_bytes + bytes > limit && !_lru.empty() && rounds--)
+	{
+		ClipCacheEntry* e = _lru.back();
+		if (e->pinned || e->hits > 1)
+		{
+			e->hits = 0;
+			_lru.splice(_lru.begin(), _lru, --_lru.end());
+			continue;
+		}
+		_lru.pop_back();
+		_index.erase(e->file);
+		_bytes -= e->bytes;
+		++_evictions;
+		unref(e);
+	}
+}
+
+//---------------------------------------------------------
+//   cacheable
+//---------------------------------------------------------
+
+bool ClipCache::cacheable(size_t bytes, bool pinned)
+{
+	size_t limit = budget();
+	if (!limit)
+		return false;
+	if (!pinned && bytes > (size_t(config.clipCacheMaxClip) << 20))
+		return false;
+	pthread_mutex_lock(&_lock);
+	bool fits = _pinnedBytes + bytes <= limit;
+	pthread_mutex_unlock(&_lock);
+	return fits;
+}
+
+//---------------------------------------------------------
+//   get
+//---------------------------------------------------------
+
+ClipCacheEntry* ClipCache::get(const SndFile* file)
+{
+	if (!budget())
+		return 0;
+	ClipCacheEntry* e = 0;
+	pthread_mutex_lock(&_lock);
+	std::map<const SndFile*, EntryList::iterator>::iterator i = _index.find(file);
+	if (i != _index.end())
+	{
+		e = *i->second;
+		_lru.splice(_lru.begin(), _lru, i->second);
+		++e->hits;
+		++e->refs;
+		++_hits;
+	}
+	else
+		++_misses;
+	pthread_mutex_unlock(&_lock);
+	return e;
+}
+
+//---------------------------------------------------------
+//   admit
+//    true if a file may be decoded now, called with
+//    _lock held
+//---------------------------------------------------------
+
+bool ClipCache::admit(size_t bytes, bool pinned)
+{
+	size_t limit = budget();
+	if (pinned)
+		return _pinnedBytes + bytes <= limit;
+	return _bytes + bytes <= limit;
+}
+
+//---------------------------------------------------------
+//   noteMiss
+//    Count the starts of the file, a read which does not
+//    continue the previous one. Enough of them, and room
+//    for it, queue the file for loadPending().
+//---------------------------------------------------------
+
+void ClipCache::noteMiss(SndFile* file, long long frame, size_t n, size_t bytes, bool pinned)
+{
+	if (!cacheable(bytes, pinned))
+		return;
+	pthread_mutex_lock(&_lock);
+	if (_index.find(file) == _index.end())
+	{
+		ClipCacheUse& u = _uses[file];
+		if (u.uses == 0 || frame != u.next)
+			++u.uses;
+		u.next = frame + n;
+		if (!u.queued && file != _loading && (pinned || u.uses >= ADMIT_USES) && admit(bytes, pinned))
+		{
+			u.queued = true;
+			_pending.push_back(file);
+		}
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   loadPending
+//    Decode the next admitted file. remove() waits while
+//    the file is being read here.
+//---------------------------------------------------------
+
+void ClipCache::loadPending()
+{
+	pthread_mutex_lock(&_lock);
+	if (_pending.empty())
+	{
+		pthread_mutex_unlock(&_lock);
+		return;
+	}
+	SndFile* file = _pending.front();
+	_pending.pop_front();
+	_uses.erase(file);
+	_loading = file;
+	_loadDropped = false;
+	pthread_mutex_unlock(&_lock);
+
+	float* data;
+	size_t frames;
+	int channels;
+	bool pinned;
+	bool ok = file->decodeClip(&data, &frames, &channels, &pinned);
+
+	pthread_mutex_lock(&_lock);
+	if (ok)
+	{
+		if (!_loadDropped && admit(frames * channels * sizeof (float), pinned))
+			insert(file, data, frames, channels, pinned);
+		else
+			delete[] data;
+	}
+	_loading = 0;
+	pthread_cond_broadcast(&_loaded);
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   insert
+//    takes over data (new[]), called with _lock held
+//---------------------------------------------------------
+
+void ClipCache::insert(const SndFile* file, float* data, size_t frames, int channels, bool pinned)
+{
+	if (_index.find(file) != _index.end())
+	{
+		delete[] data;
+		return;
+	}
+	ClipCacheEntry* e = new ClipCacheEntry;
+	e->file = file;
+	e->data = data;
+	e->frames = frames;
+	e->channels = channels;
+	e->bytes = frames * channels * sizeof (float);
+	e->pinned = pinned;
+	e->hits = 0;
+	e->refs = 1;
+
+	evict(e->bytes);
+	_lru.push_front(e);
+	_index[file] = _lru.begin();
+	_bytes += e->bytes;
+	if (pinned)
+		_pinnedBytes += e->bytes;
+}
+
+//---------------------------------------------------------
+//   release
+//---------------------------------------------------------
+
+void ClipCache::release(ClipCacheEntry* e)
+{
+	pthread_mutex_lock(&_lock);
+	unref(e);
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   remove
+//---------------------------------------------------------
+
+void ClipCache::remove(const SndFile* file)
+{
+	pthread_mutex_lock(&_lock);
+	if (file == _loading)
+	{
+		_loadDropped = true;
+		while (file == _loading)
+			pthread_cond_wait(&_loaded, &_lock);
+	}
+	SndFile* f = (SndFile*) file;
+	if (_uses.erase(f))
+		_pending.remove(f);
+	std::map<const SndFile*, EntryList::iterator>::iterator i = _index.find(file);
+	if (i != _index.end())
+	{
+		ClipCacheEntry* e = *i->second;
+		_lru.erase(i->second);
+		_index.erase(i);
+		_bytes -= e->bytes;
+		if (e->pinned)
+			_pinnedBytes -= e->bytes;
+		unref(e);
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   setPinned
+//---------------------------------------------------------
+
+void ClipCache::setPinned(const SndFile* file, bool pinned)
+{
+	pthread_mutex_lock(&_lock);
+	std::map<const SndFile*, EntryList::iterator>::iterator i = _index.find(file);
+	if (i != _index.end())
+	{
+		ClipCacheEntry* e = *i->second;
+		if (e->pinned != pinned)
+		{
+			e->pinned = pinned;
+			if (pinned)
+				_pinnedBytes += e->bytes;
+			else
+				_pinnedBytes -= e->bytes;
+		}
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void ClipCache::clear()
+{
+	pthread_mutex_lock(&_lock);
+	for (EntryList::iterator i = _lru.begin(); i != _lru.end(); ++i)
+		unref(*i);
+	_lru.clear();
+	_index.clear();
+	_uses.clear();
+	_pending.clear();
+	_bytes = 0;
+	_pinnedBytes = 0;
+	pthread_mutex_unlock(&_lock);
+}
+
+//---------------------------------------------------------
+//   dump
+//---------------------------------------------------------
+
+void ClipCache::dump()
+{
+	pthread_mutex_lock(&_lock);
+	printf("clip cache: %u clips, %.1f MB (%.1f MB pinned), %u hits, %u misses, %u evictions\n",
+			unsigned(_lru.size()), _bytes / 1048576.0, _pinnedBytes / 1048576.0, _hits, _misses, _evictions);
+	pthread_mutex_unlock(&_lock);
+}
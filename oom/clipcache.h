@@ -0,0 +1,122 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __CLIPCACHE_H__
+#define __CLIPCACHE_H__
+
+#include <stddef.h>
+#include <pthread.h>
+#include <list>
+#include <map>
+
+class SndFile;
+
+//---------------------------------------------------------
+//   ClipCacheEntry
+//    all frames of a sound file, decoded
+//---------------------------------------------------------
+
+struct ClipCacheEntry
+{
+    const SndFile* file;
+    float* data; // interleaved
+    size_t frames;
+    int channels;
+    size_t bytes;
+    bool pinned; // never evicted
+    unsigned hits; // reads since inserted or last spared
+    int refs; // one for the cache, one for every reader
+};
+
+//---------------------------------------------------------
+//   ClipCacheUse
+//    what the cache knows about a file it does not hold
+//---------------------------------------------------------
+
+struct ClipCacheUse
+{
+    long long next; // frame after the last read
+    unsigned uses; // reads not following the previous one
+    bool queued; // waiting for loadPending()
+};
+
+//---------------------------------------------------------
+//   ClipCache
+//    Short sound files (drum loops, one shots) decoded
+//    into ram, so the prefetch readers do not go to the
+//    disk for every clone of them. The total size is
+//    limited to config.clipCacheSize MB, files larger
+//    than config.clipCacheMaxClip MB are only cached when
+//    pinned.
+//
+//    A miss is read from the file as usual. A file is
+//    only admitted after it was started more than once
+//    (a clone or a loop, not one long stream) and only if
+//    it fits without evicting anything, pinned ones right
+//    away. It is then decoded by the prefetch thread in
+//    loadPending(), not in the refill that missed.
+//
+//    Eviction, needed for pinned files only, takes the
+//    least recently used entry, but an entry which has
+//    been read more than once since it was inserted gets
+//    one more round first.
+//
+//    Entries are reference counted, an evicted entry is
+//    freed when the last reader releases it.
+//---------------------------------------------------------
+
+class ClipCache
+{
+    typedef std::list<ClipCacheEntry*> EntryList;
+
+    pthread_mutex_t _lock;
+    EntryList _lru; // most recently used first
+    std::map<const SndFile*, EntryList::iterator> _index;
+    std::map<SndFile*, ClipCacheUse> _uses;
+    std::list<SndFile*> _pending; // admitted, to be decoded
+    SndFile* _loading; // being decoded by loadPending()
+    bool _loadDropped; // remove() was called meanwhile
+    pthread_cond_t _loaded;
+    size_t _bytes;
+    size_t _pinnedBytes;
+
+    // statistics
+    unsigned _hits;
+    unsigned _misses;
+    unsigned _evictions;
+
+    void unref(ClipCacheEntry*);
+    void evict(size_t bytes);
+    bool admit(size_t bytes, bool pinned);
+    void insert(const SndFile*, float* data, size_t frames, int channels, bool pinned);
+
+    ClipCache(const ClipCache&);
+    ClipCache& operator=(const ClipCache&);
+
+public:
+    ClipCache();
+    ~ClipCache();
+
+    // True if a file of that many bytes may be cached.
+    bool cacheable(size_t bytes, bool pinned);
+    // Returns the entry of the file or 0, release() it when done.
+    ClipCacheEntry* get(const SndFile*);
+    // A read of a file get() did not have, which may admit it.
+    void noteMiss(SndFile*, long long frame, size_t n, size_t bytes, bool pinned);
+    // Decode one admitted file, called from the prefetch thread.
+    void loadPending();
+    void release(ClipCacheEntry*);
+    // Drop the entry of a file which is closed or changed. Waits
+    //  if loadPending() is decoding it.
+    void remove(const SndFile*);
+    void setPinned(const SndFile*, bool);
+    void clear();
+    void dump();
+};
+
+extern ClipCache clipCache;
+
+#endif
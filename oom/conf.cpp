@@ -894,6 +894,20 @@ void readConfiguration(Xml& xml, bool readOnlySequencer)/*{{{*/
 					config.useProjectSaveDialog = xml.parseInt();
 				else if (tag == "useAutoCrossFades")
 					config.useAutoCrossFades = xml.parseInt();
+				else if (tag == "audioThreads")
+					config.audioThreads = xml.parseInt();
+				else if (tag == "compiledMidiPlayback")
+					config.compiledMidiPlayback = xml.parseInt();
+				else if (tag == "eventDrivenMidi")
+					config.eventDrivenMidi = xml.parseInt();
+				else if (tag == "alsaScheduleAhead")
+					config.alsaScheduleAhead = xml.parseInt();
+				else if (tag == "prefetchThreads")
+					config.prefetchThreads = xml.parseInt();
+				else if (tag == "clipCacheSize")
+					config.clipCacheSize = xml.parseInt();
+				else if (tag == "clipCacheMaxClip")
+					config.clipCacheMaxClip = xml.parseInt();
 				else if(tag == "lsClientHost")
 				{
 					config.lsClientHost = xml.parse1();
@@ -1246,6 +1260,13 @@ void OOMidi::writeGlobalConfiguration(int level, Xml& xml) const
 	xml.intTag(level, "projectStoreInFolder", config.projectStoreInFolder);
 	xml.intTag(level, "useProjectSaveDialog", config.useProjectSaveDialog);
 	xml.intTag(level, "useAutoCrossFades", config.useAutoCrossFades);
+	xml.intTag(level, "audioThreads", config.audioThreads);
+	xml.intTag(level, "compiledMidiPlayback", config.compiledMidiPlayback);
+	xml.intTag(level, "eventDrivenMidi", config.eventDrivenMidi);
+	xml.intTag(level, "alsaScheduleAhead", config.alsaScheduleAhead);
+	xml.intTag(level, "prefetchThreads", config.prefetchThreads);
+	xml.intTag(level, "clipCacheSize", config.clipCacheSize);
+	xml.intTag(level, "clipCacheMaxClip", config.clipCacheMaxClip);
 	xml.intTag(level, "midiInputDevice", midiInputPorts);
 	xml.intTag(level, "midiInputChannel", midiInputChannel);
 	xml.intTag(level, "midiRecordType", midiRecordType);
@@ -163,6 +163,88 @@ double CtrlList::value(int frame)/*{{{*/
 	return _curVal;
 }/*}}}*/
 
+//---------------------------------------------------------
+//   values
+//    Fill buffer with the value at each of the n frames
+//    starting at frame, walking the list once.
+//    Returns false and leaves buffer untouched if the value
+//    does not change over the range, value() is enough then.
+//---------------------------------------------------------
+
+bool CtrlList::values(int frame, unsigned n, float* buffer)
+{
+	if (!automation || empty() || n == 0)
+		return false;
+
+	int endFrame = frame + n;
+	ciCtrl i = upper_bound(frame);
+	if (i == end())
+		return false;
+	if (i->second.getFrame() >= endFrame)
+	{
+		if (_mode == DISCRETE)
+			return false;
+		double val1 = _default;
+		if (i != begin())
+		{
+			ciCtrl p = i;
+			--p;
+			val1 = p->second.val;
+		}
+		if (val1 == i->second.val)
+			return false;
+	}
+
+	unsigned k = 0;
+	while (k < n)
+	{
+		if (i == end())
+		{
+			ciCtrl l = end();
+			--l;
+			_curVal = l->second.val;
+			for (; k < n; ++k)
+				buffer[k] = _curVal;
+			break;
+		}
+
+		// frames up to the next point are on the segment ending at i
+		int frame2 = i->second.getFrame();
+		unsigned segEnd = (frame2 >= endFrame) ? n : frame2 - frame;
+		int frame1;
+		double val1;
+		if (i == begin())
+		{
+			frame1 = 0;
+			val1 = _default;
+		}
+		else
+		{
+			ciCtrl p = i;
+			--p;
+			frame1 = p->second.getFrame();
+			val1 = p->second.val;
+		}
+
+		if (_mode == DISCRETE)
+		{
+			_curVal = val1;
+			for (; k < segEnd; ++k)
+				buffer[k] = val1;
+		}
+		else
+		{
+			double val2 = i->second.val - val1;
+			int len = frame2 - frame1;
+			for (; k < segEnd; ++k)
+				buffer[k] = val1 + ((frame + (int) k - frame1) * val2) / len;
+			_curVal = buffer[k - 1];
+		}
+		++i;
+	}
+	return true;
+}
+
 const CtrlVal CtrlList::cvalue(int frame)/*{{{*/
 {
 	if (!automation || empty())
@@ -237,6 +237,7 @@ public:
 
 	const CtrlVal cvalue(int frame);
     double value(int frame);
+    bool values(int frame, unsigned n, float* buffer);
     void add(int tick, double value);
     void del(int tick);
     void read(Xml& xml);
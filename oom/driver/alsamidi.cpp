@@ -6,15 +6,18 @@
 //=========================================================
 
 #include <stdio.h>
+#include <math.h>
 
 #include "alsamidi.h"
 #include "globals.h"
+#include "gconfig.h"
 #include "midi.h"
 #include "mididev.h"
 #include "../midiport.h"
 #include "../midiseq.h"
 #include "../midictrl.h"
 #include "../audio.h"
+#include "../sync.h"
 #include "mpevent.h"
 #include "utils.h"
 #include "audiodev.h"
@@ -27,6 +30,59 @@ static int alsaSeqFdo = -1;
 snd_seq_t* alsaSeq;
 static snd_seq_addr_t oomPort;
 
+//---------------------------------------------------------
+//    scheduled output (config.alsaScheduleAhead)
+//    Events are put on alsaQueue with a real time stamp
+//    and delivered by the kernel. The queue runs on the
+//    system clock, the events are stamped with audio
+//    frames: queue time = frame / sampleRate + queueBase.
+//---------------------------------------------------------
+
+static int alsaQueue = -1;
+static double queueBase; // queue time of frame 0, in seconds
+static unsigned queueSyncFrame; // frame of the last syncQueue()
+static bool queueSynced = false;
+
+//---------------------------------------------------------
+//   syncQueue
+//    measure queueBase, follow the drift between the
+//    audio clock and the queue slowly, so the jitter of
+//    the measurement does not show up in the timing
+//---------------------------------------------------------
+
+static void syncQueue(unsigned frame)
+{
+	snd_seq_queue_status_t* status;
+	snd_seq_queue_status_alloca(&status);
+	if (snd_seq_get_queue_status(alsaSeq, alsaQueue, status) < 0)
+		return;
+	const snd_seq_real_time_t* rt = snd_seq_queue_status_get_real_time(status);
+	double base = double(rt->tv_sec) + double(rt->tv_nsec) * 1e-9 - double(frame) / double(sampleRate);
+	// Start, or a jump of the audio clock (xrun, restart of jack):
+	if (!queueSynced || fabs(base - queueBase) > 0.01)
+		queueBase = base;
+	else
+		queueBase += (base - queueBase) * 0.1;
+	queueSyncFrame = frame;
+	queueSynced = true;
+}
+
+//---------------------------------------------------------
+//   alsaRemoveScheduled
+//    drop the events on the queue on stop and seek. Note
+//    offs are left to be played so no notes hang.
+//---------------------------------------------------------
+
+void alsaRemoveScheduled()
+{
+	if (alsaQueue == -1)
+		return;
+	snd_seq_remove_events_t* rm;
+	snd_seq_remove_events_alloca(&rm);
+	snd_seq_remove_events_set_condition(rm, SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_IGNORE_OFF);
+	snd_seq_remove_events(alsaSeq, rm);
+}
+
 //---------------------------------------------------------
 //   MidiAlsaDevice
 //---------------------------------------------------------
@@ -204,6 +260,18 @@ void MidiAlsaDevice::writeRouting(int level, Xml& xml) const
 	}
 }
 
+//---------------------------------------------------------
+//   scheduleAhead
+//---------------------------------------------------------
+
+unsigned MidiAlsaDevice::scheduleAhead()
+{
+	// With external sync event times are ticks.
+	if (alsaQueue == -1 || extSyncFlag.value())
+		return 0;
+	return (unsigned) config.alsaScheduleAhead * sampleRate / 1000;
+}
+
 //---------------------------------------------------------
 //   putEvent
 //---------------------------------------------------------
@@ -225,10 +293,33 @@ bool MidiAlsaDevice::putMidiEvent(const MidiPlayEvent& e)
 	event.source = oomPort;
 	event.dest = adr;
 
+	// Events still to come go on the queue.
+	bool scheduled = false;
+	unsigned ahead = scheduleAhead();
+	if (ahead)
+	{
+		unsigned curFrame = audio->curFrame();
+		if (e.time() > curFrame)
+		{
+			if (!queueSynced || curFrame - queueSyncFrame > (unsigned) sampleRate)
+				syncQueue(curFrame);
+			double t = queueBase + double(e.time()) / double(sampleRate);
+			snd_seq_real_time_t rt;
+			rt.tv_sec = (unsigned) t;
+			rt.tv_nsec = (unsigned) ((t - double(rt.tv_sec)) * 1e9);
+			snd_seq_ev_schedule_real(&event, alsaQueue, 0, &rt);
+			scheduled = true;
+		}
+	}
+
 	switch (e.type())
 	{
 		case ME_NOTEON:
-			snd_seq_ev_set_noteon(&event, chn, a, b);
+			// A real note off survives alsaRemoveScheduled().
+			if (scheduled && b == 0)
+				snd_seq_ev_set_noteoff(&event, chn, a, 0);
+			else
+				snd_seq_ev_set_noteon(&event, chn, a, b);
 			break;
 		case ME_NOTEOFF:
 			snd_seq_ev_set_noteoff(&event, chn, a, 0);
@@ -313,7 +404,7 @@ bool MidiAlsaDevice::putMidiEvent(const MidiPlayEvent& e)
 			int len = n + sizeof (event) + 2;
 			char buf[len];
 			event.type = SND_SEQ_EVENT_SYSEX;
-			event.flags = SND_SEQ_EVENT_LENGTH_VARIABLE;
+			event.flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
 			event.data.ext.len = n + 2;
 			event.data.ext.ptr = (void*) (buf + sizeof (event));
 			memcpy(buf, &event, sizeof (event));
@@ -476,6 +567,18 @@ bool initMidiAlsa()
 	oomPort.port = port;
 	oomPort.client = snd_seq_client_id(alsaSeq);
 
+	alsaQueue = snd_seq_alloc_named_queue(alsaSeq, "OOMidi");
+	if (alsaQueue < 0)
+	{
+		printf("Alsa: cannot allocate queue: %s, no scheduled output\n", snd_strerror(alsaQueue));
+		alsaQueue = -1;
+	}
+	else
+	{
+		snd_seq_start_queue(alsaSeq, alsaQueue, 0);
+		snd_seq_drain_output(alsaSeq);
+	}
+
 	//-----------------------------------------
 	//    subscribe to "Announce"
 	//    this enables callbacks for any
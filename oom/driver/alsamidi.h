@@ -40,6 +40,7 @@ private:
 
     bool putEvent(snd_seq_event_t*);
     virtual bool putMidiEvent(const MidiPlayEvent&);
+    virtual unsigned scheduleAhead();
 
 public:
     //MidiAlsaDevice() {}  // p3.3.55 Removed
@@ -75,6 +76,7 @@ extern int alsaSelectRfd();
 extern int alsaSelectWfd();
 extern void alsaProcessMidiInput();
 extern void alsaScanMidiPorts();
+extern void alsaRemoveScheduled();
 
 #endif
 
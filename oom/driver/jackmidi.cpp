@@ -22,7 +22,9 @@
 #include "../midictrl.h"
 #include "../audio.h"
 #include "mpevent.h"
-//#include "sync.h"
+#include "../sync.h"
+#include "tempo.h"
+#include "gconfig.h"
 #include "audiodev.h"
 #include "../mplugins/midiitransform.h"
 #include "../mplugins/mitplugin.h"
@@ -45,6 +47,7 @@ MidiJackDevice::MidiJackDevice(const QString& n)
 {
 	_in_client_jackport = NULL;
 	_out_client_jackport = NULL;
+	_clockCountdown = 0.0;
 
 	init();
 }
@@ -646,13 +649,25 @@ bool MidiJackDevice::queueEvent(const MidiPlayEvent& e)
 		}
 			break;
 		case ME_SONGPOS:
+		{
+			unsigned char* p = jack_midi_event_reserve(pb, ft, 3);
+			if (p == 0)
+				return false;
+			p[0] = ME_SONGPOS;
+			p[1] = e.dataA() & 0x7f;
+			p[2] = (e.dataA() >> 7) & 0x7f;
+		}
+			break;
 		case ME_CLOCK:
 		case ME_START:
 		case ME_CONTINUE:
 		case ME_STOP:
-			if(debugMsg)
-				printf("MidiJackDevice::queueEvent: event type %x not supported\n", e.type());
-			return true;
+		{
+			unsigned char* p = jack_midi_event_reserve(pb, ft, 1);
+			if (p == 0)
+				return false;
+			p[0] = e.type();
+		}
 			break;
 	}
 
@@ -899,6 +914,44 @@ bool MidiJackDevice::processEvent(const MidiPlayEvent& event)
 	return true;
 }
 
+//---------------------------------------------------------
+//   addClocks
+//    put the midi clocks of this period into playEvents
+//    at their exact frames. While playing they are locked
+//    to the tempo map, stopped they run free at the tempo
+//    of the current position.
+//---------------------------------------------------------
+
+void MidiJackDevice::addClocks()
+{
+	// With external sync the clock is passed on as it comes in.
+	if (_port == -1 || extSyncFlag.value() || !midiPorts[_port].syncInfo().MCOut())
+	{
+		_clockCountdown = 0.0;
+		return;
+	}
+	int div = config.division / 24;
+	unsigned frameOffset = audio->getFrameOffset();
+	MPEventList* el = playEvents();
+	if (audio->isPlaying())
+	{
+		// every tick is in exactly one period: curTickPos <= tick < nextTickPos
+		unsigned end = audio->nextTick();
+		for (unsigned tick = (audio->tickPos() + div - 1) / div * div; tick < end; tick += div)
+			el->add(MidiPlayEvent(tempomap.tick2frame(tick) + frameOffset, _port, 0, ME_CLOCK, 0, 0));
+		_clockCountdown = 0.0;
+	}
+	else
+	{
+		double ticksPerSec = double(tempomap.globalTempo()) * double(config.division) * 10000.0 / double(tempomap.tempo(audio->tickPos()));
+		double framesPerClock = double(div) * double(sampleRate) / ticksPerSec;
+		unsigned pos = audio->pos().frame() + frameOffset;
+		for (; _clockCountdown < double(segmentSize); _clockCountdown += framesPerClock)
+			el->add(MidiPlayEvent(pos + unsigned(_clockCountdown), _port, 0, ME_CLOCK, 0, 0));
+		_clockCountdown -= double(segmentSize);
+	}
+}
+
 //---------------------------------------------------------
 //    processMidi called from audio process only.
 //---------------------------------------------------------
@@ -925,6 +978,9 @@ void MidiJackDevice::processMidi()
 		//printf("MidiJackDevice::processMidi removed event\n");
 	}
 
+	if (port_buf)
+		addClocks();
+
 	MPEventList* el = playEvents();
 	if (el->empty())
 		return;
@@ -47,6 +47,8 @@ private:
     jack_port_t* _in_client_jackport;
     jack_port_t* _out_client_jackport;
 
+    double _clockCountdown; // frames to the next midi clock while stopped
+
     //RouteList _routes;
 
     virtual QString open();
@@ -61,6 +63,7 @@ private:
     //bool sendEvent(const MidiPlayEvent&);
 
     void eventReceived(jack_midi_event_t*);
+    void addClocks();
 
 public:
     //MidiJackDevice() {}  // p3.3.55  Removed.
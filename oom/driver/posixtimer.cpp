@@ -0,0 +1,139 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#include "posixtimer.h"
+#include "gconfig.h"
+
+PosixTimer::PosixTimer()
+{
+	timerFd = -1;
+	freq = 0;
+}
+
+PosixTimer::~PosixTimer()
+{
+	if (timerFd != -1)
+		close(timerFd);
+}
+
+signed int PosixTimer::initTimer()
+{
+	if (TIMER_DEBUG)
+		printf("PosixTimer::initTimer()\n");
+	if (timerFd != -1)
+	{
+		fprintf(stderr, "PosixTimer::initTimer(): called on initialised timer!\n");
+		return -1;
+	}
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerFd == -1)
+	{
+		fprintf(stderr, "PosixTimer::initTimer(): timerfd_create failed: %s\n", strerror(errno));
+		return -1;
+	}
+	setTimerFreq(config.rtcTicks);
+	return timerFd;
+}
+
+//---------------------------------------------------------
+//   arm
+//    nsec == 0 stops the timer
+//---------------------------------------------------------
+
+bool PosixTimer::arm(long nsec, long interval)
+{
+	if (timerFd == -1)
+	{
+		fprintf(stderr, "PosixTimer: no timer open!\n");
+		return false;
+	}
+	struct itimerspec its;
+	its.it_value.tv_sec = nsec / 1000000000;
+	its.it_value.tv_nsec = nsec % 1000000000;
+	its.it_interval.tv_sec = interval / 1000000000;
+	its.it_interval.tv_nsec = interval % 1000000000;
+	if (timerfd_settime(timerFd, 0, &its, 0) == -1)
+	{
+		fprintf(stderr, "PosixTimer: timerfd_settime failed: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+unsigned int PosixTimer::setTimerResolution(unsigned int resolution)
+{
+	if (TIMER_DEBUG)
+		printf("PosixTimer::setTimerResolution(%d)\n", resolution);
+	// Timeouts are given in nanoseconds, there is nothing to set.
+	return 0;
+}
+
+unsigned int PosixTimer::getTimerResolution()
+{
+	struct timespec ts;
+	if (clock_getres(CLOCK_MONOTONIC, &ts) == -1)
+		return 0;
+	return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+unsigned int PosixTimer::setTimerFreq(unsigned int tick)
+{
+	if (tick == 0)
+		return 0;
+	freq = tick;
+	return freq;
+}
+
+unsigned int PosixTimer::getTimerFreq()
+{
+	return freq;
+}
+
+bool PosixTimer::startTimer()
+{
+	if (TIMER_DEBUG)
+		printf("PosixTimer::startTimer()\n");
+	long period = 1000000000 / freq;
+	return arm(period, period);
+}
+
+bool PosixTimer::stopTimer()
+{
+	if (TIMER_DEBUG)
+		printf("PosixTimer::stopTimer\n");
+	return arm(0, 0);
+}
+
+bool PosixTimer::setTimeout(long nsec)
+{
+	// a zero it_value would disarm the timer
+	return arm(nsec > 0 ? nsec : 1, 0);
+}
+
+unsigned int PosixTimer::getTimerTicks(bool /*printTicks*/)
+{
+	if (TIMER_DEBUG)
+		printf("getTimerTicks()\n");
+	uint64_t n;
+	if (timerFd == -1)
+	{
+		fprintf(stderr, "PosixTimer::getTimerTicks(): no timer open to read!\n");
+		return 0;
+	}
+	// Nothing to read (EAGAIN) if the timer was re-armed after it
+	//  expired and before we got here.
+	if (read(timerFd, &n, sizeof (n)) != sizeof (n))
+		return 0;
+	return n;
+}
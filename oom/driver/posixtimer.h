@@ -0,0 +1,49 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __POSIXTIMER_H__
+#define __POSIXTIMER_H__
+
+#include "timerdev.h"
+
+//---------------------------------------------------------
+//   PosixTimer
+//    timerfd on CLOCK_MONOTONIC, needs neither /dev/rtc
+//    nor the alsa timer module.
+//
+//    Besides the periodic mode of the other timers it can
+//    be armed for a single expiry with setTimeout(), which
+//    is what the midi thread uses to sleep until the next
+//    event is due.
+//---------------------------------------------------------
+
+class PosixTimer : public Timer
+{
+public:
+    PosixTimer();
+    virtual ~PosixTimer();
+
+    virtual signed int initTimer();
+    virtual unsigned int setTimerResolution(unsigned int resolution);
+    virtual unsigned int getTimerResolution();
+    virtual unsigned int setTimerFreq(unsigned int tick);
+    virtual unsigned int getTimerFreq();
+
+    virtual bool startTimer();
+    virtual bool stopTimer();
+    virtual unsigned int getTimerTicks(bool printTicks = false);
+
+    // Expire once, nsec from now. nsec <= 0 expires at once.
+    //  Can be called from any thread.
+    bool setTimeout(long nsec);
+
+private:
+    int timerFd;
+    unsigned int freq;
+    bool arm(long nsec, long interval);
+};
+
+#endif
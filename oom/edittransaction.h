@@ -0,0 +1,77 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __EDITTRANSACTION_H__
+#define __EDITTRANSACTION_H__
+
+#include <vector>
+#include "event.h"
+
+class Part;
+
+//---------------------------------------------------------
+//   EditOp
+//    one event edit of an EditTransaction
+//---------------------------------------------------------
+
+struct EditOp
+{
+    enum Type
+    {
+        AddEvent, DeleteEvent, ModifyEvent
+    };
+    Type type;
+    Event oEvent; // event to delete or modify
+    Event nEvent; // event to add, or the modified event
+    Part* part;
+    bool doCtrls;
+    bool doClones;
+};
+
+//---------------------------------------------------------
+//   EditTransaction
+//    collects a whole edit (over any number of parts) so
+//    that it is applied in one go by
+//    Audio::msgEditTransaction(): one message to the audio
+//    thread, one undo step and one songChanged().
+//    The arguments are the same as the ones of
+//    Audio::msgAddEvent(), msgDeleteEvent() and
+//    msgChangeEvent().
+//---------------------------------------------------------
+
+class EditTransaction : public std::vector<EditOp>
+{
+    void append(EditOp::Type type, const Event& oe, const Event& ne, Part* part, bool doCtrls, bool doClones)
+    {
+        push_back(EditOp());
+        EditOp& op = back();
+        op.type = type;
+        op.oEvent = oe;
+        op.nEvent = ne;
+        op.part = part;
+        op.doCtrls = doCtrls;
+        op.doClones = doClones;
+    }
+
+public:
+
+    void addEvent(const Event& event, Part* part, bool doCtrls = true, bool doClones = false)
+    {
+        append(EditOp::AddEvent, Event(), event, part, doCtrls, doClones);
+    }
+
+    void deleteEvent(const Event& event, Part* part, bool doCtrls = true, bool doClones = false)
+    {
+        append(EditOp::DeleteEvent, event, Event(), part, doCtrls, doClones);
+    }
+
+    void changeEvent(const Event& oldEvent, const Event& newEvent, Part* part, bool doCtrls = true, bool doClones = false)
+    {
+        append(EditOp::ModifyEvent, oldEvent, newEvent, part, doCtrls, doClones);
+    }
+};
+
+#endif
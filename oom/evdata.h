@@ -12,14 +12,61 @@
 #include <string.h>
 // #include <memory.h>
 
+// Data up to this size is stored inside the EvData itself.
+#define EVDATA_INLINE_SIZE 16
+
 //---------------------------------------------------------
 //   EvData
 //    variable len event data (sysex, meta etc.)
+//
+//    Short data is kept in an inline buffer and copied
+//    with the event, so constructing, copying and
+//    destroying events never touches the heap.
+//    Longer data lives in one refcounted block (the
+//    counter followed by the bytes) shared by all copies.
+//    refCount is 0 if the data is empty or inline.
 //---------------------------------------------------------
 
 class EvData
 {
     int* refCount;
+    unsigned char _inline[EVDATA_INLINE_SIZE];
+
+    // a refcounted block for l bytes, the data follows the counter
+    static int* newBlock(int l)
+    {
+        int n = 1 + (l + sizeof (int) - 1) / sizeof (int);
+        int* rc = new int[n];
+        *rc = 1;
+        return rc;
+    }
+
+    void release()
+    {
+        if (refCount && --(*refCount) == 0)
+            delete[] refCount;
+        refCount = 0;
+        data = 0;
+        dataLen = 0;
+    }
+
+    void assign(const EvData& ed)
+    {
+        dataLen = ed.dataLen;
+        refCount = ed.refCount;
+        if (refCount)
+        {
+            (*refCount)++;
+            data = ed.data;
+        }
+        else if (dataLen)
+        {
+            memcpy(_inline, ed._inline, dataLen);
+            data = _inline;
+        }
+        else
+            data = 0;
+    }
 
 public:
     unsigned char* data;
@@ -27,49 +74,81 @@ public:
 
     EvData()
     {
+        refCount = 0;
         data = 0;
         dataLen = 0;
-        refCount = new int(1);
     }
 
     EvData(const EvData& ed)
     {
-        data = ed.data;
-        dataLen = ed.dataLen;
-        refCount = ed.refCount;
-        (*refCount)++;
+        assign(ed);
     }
 
     EvData & operator=(const EvData& ed)
     {
-        if (data == ed.data)
+        if (this == &ed || (refCount && refCount == ed.refCount))
             return *this;
-        if (--(*refCount) == 0) {
-            delete refCount;
-            delete[] data;
-        }
-        data = ed.data;
-        dataLen = ed.dataLen;
-        refCount = ed.refCount;
-        (*refCount)++;
+        release();
+        assign(ed);
         return *this;
     }
 
     ~EvData()
     {
-        if (--(*refCount) == 0) {
-            delete[] data;
-            delete refCount;
+        release();
+    }
+
+    bool isInline() const
+    {
+        return refCount == 0;
+    }
+
+    //---------------------------------------------------
+    //   resize
+    //    discard the current data and return a buffer
+    //    of l bytes to be filled by the caller
+    //---------------------------------------------------
+
+    unsigned char* resize(int l)
+    {
+        release();
+        if (l <= 0)
+            return 0;
+        if (l <= EVDATA_INLINE_SIZE)
+            data = _inline;
+        else
+        {
+            refCount = newBlock(l);
+            data = (unsigned char*) (refCount + 1);
         }
+        dataLen = l;
+        return data;
     }
 
     void setData(const unsigned char* p, int l)
     {
-        data = new unsigned char[l];
-        memcpy(data, p, l);
-        dataLen = l;
+        if (p == data && l == dataLen)
+            return;
+        // p may point into our own data, so fill the new
+        //  buffer before the old one is released.
+        int* rc = 0;
+        unsigned char* d = 0;
+        if (l > EVDATA_INLINE_SIZE)
+        {
+            rc = newBlock(l);
+            d = (unsigned char*) (rc + 1);
+            memcpy(d, p, l);
+        }
+        else if (l > 0)
+        {
+            d = _inline;
+            memmove(d, p, l);
+        }
+        release();
+        refCount = rc;
+        data = d;
+        dataLen = d ? l : 0;
     }
 };
 
 #endif
-
@@ -0,0 +1,332 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <new>
+
+#include "eventwheel.h"
+#include "memory.h"
+
+//---------------------------------------------------------
+//   MidiEventWheel
+//---------------------------------------------------------
+
+MidiEventWheel::MidiEventWheel()
+{
+	for (int i = 0; i < WHEEL_L0_SLOTS; ++i)
+		_l0[i].head = _l0[i].tail = 0;
+	for (int i = 0; i < WHEEL_L0_SLOTS / 32; ++i)
+		_l0Used[i] = 0;
+	for (int i = 0; i < WHEEL_LN_SLOTS; ++i)
+	{
+		_l1[i].head = _l1[i].tail = 0;
+		_l2[i].head = _l2[i].tail = 0;
+	}
+	_overflow.head = _overflow.tail = 0;
+	_due.head = _due.tail = 0;
+	_now = 0;
+	_size = 0;
+	_scheduled = 0;
+}
+
+MidiEventWheel::~MidiEventWheel()
+{
+	clear();
+}
+
+//---------------------------------------------------------
+//   append
+//---------------------------------------------------------
+
+void MidiEventWheel::append(Slot& s, Node* n)
+{
+	n->next = 0;
+	if (s.tail)
+		s.tail->next = n;
+	else
+		s.head = n;
+	s.tail = n;
+}
+
+//---------------------------------------------------------
+//   detach
+//    empty the slot, return its list
+//---------------------------------------------------------
+
+MidiEventWheel::Node* MidiEventWheel::detach(Slot& s)
+{
+	Node* n = s.head;
+	s.head = s.tail = 0;
+	return n;
+}
+
+//---------------------------------------------------------
+//   insert
+//    put the node into the slot for its tick
+//---------------------------------------------------------
+
+void MidiEventWheel::insert(Node* n)
+{
+	unsigned t = n->event.time();
+	if (t < _now)
+	{
+		append(_due, n);
+		return;
+	}
+	++_scheduled;
+	if ((t >> WHEEL_L1_SHIFT) == (_now >> WHEEL_L1_SHIFT))
+	{
+		unsigned idx = t & (WHEEL_L0_SLOTS - 1);
+		append(_l0[idx], n);
+		_l0Used[idx >> 5] |= 1u << (idx & 31);
+	}
+	else if ((t >> WHEEL_L2_SHIFT) == (_now >> WHEEL_L2_SHIFT))
+		append(_l1[(t >> WHEEL_L1_SHIFT) & (WHEEL_LN_SLOTS - 1)], n);
+	else if ((t >> WHEEL_L3_SHIFT) == (_now >> WHEEL_L3_SHIFT))
+		append(_l2[(t >> WHEEL_L2_SHIFT) & (WHEEL_LN_SLOTS - 1)], n);
+	else
+		append(_overflow, n);
+}
+
+//---------------------------------------------------------
+//   reinsert
+//    spread a slot of a higher level over the lower ones
+//---------------------------------------------------------
+
+void MidiEventWheel::reinsert(Slot& s)
+{
+	Node* n = detach(s);
+	while (n)
+	{
+		Node* next = n->next;
+		--_scheduled;
+		insert(n);
+		n = next;
+	}
+}
+
+//---------------------------------------------------------
+//   gather
+//    move all events into s, in tick order as far as
+//    the levels go
+//---------------------------------------------------------
+
+void MidiEventWheel::gather(Slot& s)
+{
+	for (int i = 0; i < WHEEL_L0_SLOTS; ++i)
+	{
+		unsigned idx = (_now + i) & (WHEEL_L0_SLOTS - 1);
+		for (Node* n = detach(_l0[idx]); n;)
+		{
+			Node* next = n->next;
+			append(s, n);
+			n = next;
+		}
+	}
+	for (int i = 0; i < WHEEL_L0_SLOTS / 32; ++i)
+		_l0Used[i] = 0;
+	Slot* levels[2] = { _l1, _l2 };
+	int shifts[2] = { WHEEL_L1_SHIFT, WHEEL_L2_SHIFT };
+	for (int l = 0; l < 2; ++l)
+	{
+		for (int i = 0; i < WHEEL_LN_SLOTS; ++i)
+		{
+			unsigned idx = ((_now >> shifts[l]) + i) & (WHEEL_LN_SLOTS - 1);
+			for (Node* n = detach(levels[l][idx]); n;)
+			{
+				Node* next = n->next;
+				append(s, n);
+				n = next;
+			}
+		}
+	}
+	for (Node* n = detach(_overflow); n;)
+	{
+		Node* next = n->next;
+		append(s, n);
+		n = next;
+	}
+	_scheduled = 0;
+}
+
+//---------------------------------------------------------
+//   cascade
+//    _now has reached a level 0 round
+//---------------------------------------------------------
+
+void MidiEventWheel::cascade()
+{
+	if ((_now & ((1u << WHEEL_L2_SHIFT) - 1)) == 0)
+	{
+		if ((_now & ((1u << WHEEL_L3_SHIFT) - 1)) == 0)
+			reinsert(_overflow);
+		reinsert(_l2[(_now >> WHEEL_L2_SHIFT) & (WHEEL_LN_SLOTS - 1)]);
+	}
+	reinsert(_l1[(_now >> WHEEL_L1_SHIFT) & (WHEEL_LN_SLOTS - 1)]);
+}
+
+//---------------------------------------------------------
+//   advance
+//    move the events before tick to _due
+//---------------------------------------------------------
+
+void MidiEventWheel::advance(unsigned tick)
+{
+	while (_now < tick)
+	{
+		if (_scheduled == 0)
+		{
+			_now = tick;
+			return;
+		}
+		// next used level 0 slot in this round
+		unsigned idx = _now & (WHEEL_L0_SLOTS - 1);
+		unsigned slot = WHEEL_L0_SLOTS;
+		for (unsigned w = idx >> 5; w < WHEEL_L0_SLOTS / 32; ++w)
+		{
+			unsigned bits = _l0Used[w];
+			if (w == (idx >> 5))
+				bits &= ~0u << (idx & 31);
+			if (bits)
+			{
+				slot = (w << 5) + __builtin_ctz(bits);
+				break;
+			}
+		}
+		unsigned base = _now & ~(WHEEL_L0_SLOTS - 1);
+		if (slot < WHEEL_L0_SLOTS)
+		{
+			if (base + slot >= tick)
+			{
+				_now = tick;
+				return;
+			}
+			for (Node* n = detach(_l0[slot]); n;)
+			{
+				Node* next = n->next;
+				append(_due, n);
+				--_scheduled;
+				n = next;
+			}
+			_l0Used[slot >> 5] &= ~(1u << (slot & 31));
+			_now = base + slot + 1;
+		}
+		else
+		{
+			unsigned end = base + WHEEL_L0_SLOTS;
+			if (end > tick || end == 0)
+			{
+				_now = tick;
+				return;
+			}
+			_now = end;
+		}
+		if ((_now & (WHEEL_L0_SLOTS - 1)) == 0)
+			cascade();
+	}
+}
+
+//---------------------------------------------------------
+//   rebase
+//    time went backwards (loop, seek without flush)
+//---------------------------------------------------------
+
+void MidiEventWheel::rebase(unsigned tick)
+{
+	Slot all;
+	all.head = all.tail = 0;
+	for (Node* n = detach(_due); n;)
+	{
+		Node* next = n->next;
+		append(all, n);
+		n = next;
+	}
+	gather(all);
+	_now = tick;
+	for (Node* n = detach(all); n;)
+	{
+		Node* next = n->next;
+		insert(n);
+		n = next;
+	}
+}
+
+//---------------------------------------------------------
+//   add
+//---------------------------------------------------------
+
+void MidiEventWheel::add(const MidiPlayEvent& ev)
+{
+	Node* n = new (audioRTmemoryPool.alloc(sizeof (Node))) Node(ev);
+	++_size;
+	insert(n);
+}
+
+//---------------------------------------------------------
+//   next
+//---------------------------------------------------------
+
+bool MidiEventWheel::next(unsigned tick, MidiPlayEvent& ev)
+{
+	if (_size == 0)
+	{
+		_now = tick;
+		return false;
+	}
+	if (tick < _now)
+		rebase(tick);
+	else
+		advance(tick);
+	Node* n = _due.head;
+	if (!n)
+		return false;
+	_due.head = n->next;
+	if (!_due.head)
+		_due.tail = 0;
+	ev = n->event;
+	n->~Node();
+	audioRTmemoryPool.free(n, sizeof (Node));
+	--_size;
+	return true;
+}
+
+//---------------------------------------------------------
+//   flush
+//---------------------------------------------------------
+
+bool MidiEventWheel::flush(MidiPlayEvent& ev)
+{
+	if (_size == 0)
+		return false;
+	if (_scheduled)
+		gather(_due);
+	Node* n = _due.head;
+	_due.head = n->next;
+	if (!_due.head)
+		_due.tail = 0;
+	ev = n->event;
+	n->~Node();
+	audioRTmemoryPool.free(n, sizeof (Node));
+	--_size;
+	return true;
+}
+
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void MidiEventWheel::clear()
+{
+	if (_scheduled)
+		gather(_due);
+	for (Node* n = detach(_due); n;)
+	{
+		Node* next = n->next;
+		n->~Node();
+		audioRTmemoryPool.free(n, sizeof (Node));
+		n = next;
+	}
+	_size = 0;
+}
@@ -0,0 +1,103 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __EVENTWHEEL_H__
+#define __EVENTWHEEL_H__
+
+#include "mpevent.h"
+
+#define WHEEL_L0_BITS 8 // level 0: one slot per tick
+#define WHEEL_LN_BITS 6 // levels 1 and 2
+#define WHEEL_L0_SLOTS (1 << WHEEL_L0_BITS)
+#define WHEEL_LN_SLOTS (1 << WHEEL_LN_BITS)
+#define WHEEL_L1_SHIFT WHEEL_L0_BITS
+#define WHEEL_L2_SHIFT (WHEEL_L1_SHIFT + WHEEL_LN_BITS)
+#define WHEEL_L3_SHIFT (WHEEL_L2_SHIFT + WHEEL_LN_BITS)
+
+//---------------------------------------------------------
+//   MidiEventWheel
+//    events waiting for their tick (note offs of playing
+//    notes), kept in a hierarchical timing wheel:
+//
+//      level 0: 256 slots of one tick
+//      level 1: 64 slots of 256 ticks
+//      level 2: 64 slots of 16384 ticks
+//      overflow: everything further away
+//
+//    Adding an event and taking out the due ones is O(1),
+//    a slot of a higher level is only spread out over the
+//    lower ones when the wheel gets there. Events keep
+//    the order they were added in within a tick.
+//
+//    Nodes come from audioRTmemoryPool, like the ones of
+//    MPEventList, so the same threading rules apply.
+//---------------------------------------------------------
+
+class MidiEventWheel
+{
+    struct Node
+    {
+        Node* next;
+        MidiPlayEvent event;
+
+        Node(const MidiPlayEvent& ev) : next(0), event(ev)
+        {
+        }
+    };
+
+    struct Slot
+    {
+        Node* head;
+        Node* tail;
+    };
+
+    Slot _l0[WHEEL_L0_SLOTS];
+    unsigned _l0Used[WHEEL_L0_SLOTS / 32]; // non empty level 0 slots
+    Slot _l1[WHEEL_LN_SLOTS];
+    Slot _l2[WHEEL_LN_SLOTS];
+    Slot _overflow;
+    Slot _due; // ready to be taken
+    unsigned _now; // events before this tick are in _due
+    int _size;
+    int _scheduled; // events not in _due
+
+    static void append(Slot&, Node*);
+    static Node* detach(Slot&);
+    void insert(Node*);
+    void reinsert(Slot&);
+    void gather(Slot&);
+    void advance(unsigned tick);
+    void cascade();
+    void rebase(unsigned tick);
+
+    MidiEventWheel(const MidiEventWheel&);
+    MidiEventWheel& operator=(const MidiEventWheel&);
+
+public:
+    MidiEventWheel();
+    ~MidiEventWheel();
+
+    // ev.time() is a tick
+    void add(const MidiPlayEvent& ev);
+    // Takes out the next event before tick, returns false if there is none.
+    bool next(unsigned tick, MidiPlayEvent& ev);
+    // Takes out any event regardless of its time, for stop, seek and
+    //  panic. Call it until it returns false.
+    bool flush(MidiPlayEvent& ev);
+    void clear();
+
+    int size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+};
+
+#endif
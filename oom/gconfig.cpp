@@ -722,6 +722,13 @@ GlobalConfigValues config = {
 	QString(QString("/usr/local/lib64/vst:/usr/lib64/vst:/usr/local/lib/vst:/usr/lib/vst:").append(QDir::homePath()).append(QDir::separator()).append(".vst")),
 	0, //Default audio raster index
 	1, //Default midi raster index
-	true //Use auto crossfades
+	true, //Use auto crossfades
+	0, //Audio processing threads, 0 = one per cpu
+	true, //Compiled midi playback
+	true, //Event driven midi thread
+	0, //Alsa midi schedule ahead msec, 0 = off
+	4, //Prefetch disk reader threads
+	256, //Clip cache size in MB, 0 = off
+	16 //Largest clip cached unpinned, MB
 };
 
@@ -166,6 +166,13 @@ struct GlobalConfigValues
 	int audioRaster;
 	int midiRaster;
 	bool useAutoCrossFades;
+	int audioThreads; // threads used for audio processing, 0 = one per cpu, 1 = audio thread only
+	bool compiledMidiPlayback; // play midi tracks from precompiled event arrays
+	bool eventDrivenMidi; // midi thread sleeps until the next event instead of polling at rtcTicks
+	int alsaScheduleAhead; // msec alsa midi events are put on a sequencer queue ahead of time, 0 = send when due
+	int prefetchThreads; // disk reader threads of the audio prefetch
+	int clipCacheSize; // MB of decoded short sound files kept in ram, 0 = off
+	int clipCacheMaxClip; // MB, larger files are only cached when pinned
 };
 
 extern GlobalConfigValues config;
@@ -31,6 +31,7 @@
 #include "midiseq.h"
 #include "gconfig.h"
 #include "ticksynth.h"
+#include "playbacksnapshot.h"
 
 extern void dump(const unsigned char* p, int n);
 
@@ -686,7 +687,7 @@ void Audio::midiPortsChanged()
 
 void Audio::sendLocalOff()
 {
-	for (int k = 0; k < MIDI_PORTS; ++k)
+	for (int k = nextActiveMidiPort(0); k < MIDI_PORTS; k = nextActiveMidiPort(k + 1))
 	{
 		for (int i = 0; i < MIDI_CHANNELS; ++i)
 			midiPorts[k].sendEvent(MidiPlayEvent(0, k, i, ME_CONTROLLER, CTRL_LOCAL_OFF, 0));
@@ -704,7 +705,7 @@ void Audio::panic()
     {
         MidiDevice* dev = *i;
         MPEventList* el  = 0;//synth->playEvents();
-        MPEventList* sel = 0;//synth->stuckNotes();
+        MidiEventWheel* sel = 0;//synth->stuckNotes();
         if (dev && dev->isSynthPlugin())
         {
             SynthPluginDevice* synth = (SynthPluginDevice*)dev;
@@ -722,19 +723,18 @@ void Audio::panic()
             // stop all notes
 			el->clear();
 			//MPEventList* sel = dev->stuckNotes();
-			for (iMPEvent i = sel->begin(); i != sel->end(); ++i)
+			MidiPlayEvent ev;
+			while (sel->flush(ev))
 			{
-				MidiPlayEvent ev = *i;
 				ev.setTime(0);
                 ev.setType(ME_NOTEOFF);
 				el->add(ev);
 			}
-			sel->clear();
         //}
     }
 #endif
 
-	for (int i = 0; i < MIDI_PORTS; ++i)/*{{{*/
+	for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))/*{{{*/
 	{
 		MidiPort* port = &midiPorts[i];
 		if (!port || !port->device()) 
@@ -849,494 +849,715 @@ void Audio::initDevices()
 }
 
 //---------------------------------------------------------
-//   collectEvents
-//    collect events for next audio segment
+//   collectEvent
+//    schedule one event of a part of track on device md,
+//    offset is the part tick plus the track delay
 //---------------------------------------------------------
 
-void Audio::collectEvents(MidiTrack* track, unsigned int cts, unsigned int nts)
+void Audio::collectEvent(MidiTrack* track, MidiDevice* md, const Event& ev, unsigned offset)
 {
-	int port = track->outPort();
+	int defaultPort = track->outPort();
+	int port = defaultPort;
 	int channel = track->outChannel();
-	int defaultPort = port;
-
-	MidiDevice* md = midiPorts[port].device();
 	MPEventList* playEvents = md->playEvents();
-	MPEventList* stuckNotes = md->stuckNotes();
+	MidiEventWheel* stuckNotes = md->stuckNotes();
 
-	PartList* pl = track->parts();
-	for (iPart p = pl->begin(); p != pl->end(); ++p)
+	//
+	//  dont play any meta events
+	//
+	if (ev.type() == Meta)
+		return;
+	if (track->type() == Track::DRUM)
 	{
-		MidiPart* part = (MidiPart*) (p->second);
-		// dont play muted parts
-		if (part->mute())
-			continue;
-		EventList* events = part->events();
-		unsigned partTick = part->tick();
-		unsigned partLen = part->lenTick();
-		int delay = track->delay;
-
-		if (cts > nts)
-		{
-			printf("processMidi: FATAL: cur > next %d > %d\n",
-					cts, nts);
+		int instr = ev.pitch();
+		// ignore muted drums
+		if (ev.isNote() && drumMap[instr].mute)
 			return;
-		}
-		unsigned offset = delay + partTick;
-		if (offset > nts)
-			continue;
-		unsigned stick = (offset > cts) ? 0 : cts - offset;
-		unsigned etick = nts - offset;
-		// By T356. Do not play events which are past the end of this part.
-		if (etick > partLen)
-			continue;
-
-		iEvent ie = events->lower_bound(stick);
-		iEvent iend = events->lower_bound(etick);
-
-		for (; ie != iend; ++ie)
+	}
+	unsigned tick = ev.tick() + offset;
+	unsigned frame = tempomap.tick2frame(tick, _tempoCursor) + frameOffset;
+	switch (ev.type())
+	{
+		case Note:
 		{
-			Event ev = ie->second;
-			port = defaultPort; //Reset each loop
-			//
-			//  dont play any meta events
-			//
-			if (ev.type() == Meta)
-				continue;
+			int len = ev.lenTick();
+			int pitch = ev.pitch();
+			int velo = ev.velo();
 			if (track->type() == Track::DRUM)
 			{
+				//
+				// Map drum-notes to the drum-map values
+				//
 				int instr = ev.pitch();
-				// ignore muted drums
-				if (ev.isNote() && drumMap[instr].mute)
-					continue;
+				pitch = drumMap[instr].anote;
+				port = drumMap[instr].port; //This changes to non-default port
+				channel = drumMap[instr].channel;
+				velo = int(double(velo) * (double(drumMap[instr].vol) / 100.0));
+			}
+			else
+			{
+				//
+				// transpose non drum notes
+				//
+				pitch += /*(track->getTransposition() +*/ song->globalPitchShift();
 			}
-			unsigned tick = ev.tick() + offset;
-			unsigned frame = tempomap.tick2frame(tick) + frameOffset;
-			switch (ev.type())
+
+			if (pitch > 127)
+				pitch = 127;
+			if (pitch < 0)
+				pitch = 0;
+			velo += track->velocity;
+			velo = (velo * track->compression) / 100;
+			if (velo > 127)
+				velo = 127;
+			if (velo < 1) // no off event
+				velo = 1;
+			len = (len * track->len) / 100;
+			if (len <= 0) // dont allow zero length
+				len = 1;
+			int veloOff = ev.veloOff();
+
+			if (port == defaultPort)
 			{
-				case Note:
+				//printf("Adding event normally: frame=%d port=%d channel=%d pitch=%d velo=%d\n",frame, port, channel, pitch, velo);
+
+				// p3.3.25
+				// If syncing to external midi sync, we cannot use the tempo map.
+				// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
+				if (extSyncFlag.value())
+					playEvents->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
+				else
+					playEvents->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
+
+				stuckNotes->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
+			}
+			else
+			{ //Handle events to different port than standard.
+				MidiDevice* mdAlt = midiPorts[port].device();
+				if (mdAlt)
 				{
-					int len = ev.lenTick();
-					int pitch = ev.pitch();
-					int velo = ev.velo();
-					if (track->type() == Track::DRUM)
-					{
-						//
-						// Map drum-notes to the drum-map values
-						//
-						int instr = ev.pitch();
-						pitch = drumMap[instr].anote;
-						port = drumMap[instr].port; //This changes to non-default port
-						channel = drumMap[instr].channel;
-						velo = int(double(velo) * (double(drumMap[instr].vol) / 100.0));
-					}
+					if (extSyncFlag.value())
+						mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
 					else
-					{
-						//
-						// transpose non drum notes
-						//
-						pitch += /*(track->getTransposition() +*/ song->globalPitchShift();
-					}
+						mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
 
-					if (pitch > 127)
-						pitch = 127;
-					if (pitch < 0)
-						pitch = 0;
-					velo += track->velocity;
-					velo = (velo * track->compression) / 100;
-					if (velo > 127)
-						velo = 127;
-					if (velo < 1) // no off event
-						velo = 1;
-					len = (len * track->len) / 100;
-					if (len <= 0) // dont allow zero length
-						len = 1;
-					int veloOff = ev.veloOff();
-
-					if (port == defaultPort)
-					{
-						//printf("Adding event normally: frame=%d port=%d channel=%d pitch=%d velo=%d\n",frame, port, channel, pitch, velo);
+					mdAlt->stuckNotes()->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
+				}
+			}
+
+			if (velo > track->activity())
+				track->setActivity(velo);
+		}
+			break;
 
+			// Added by T356.
+		case Controller:
+		{
+			//int len   = ev.lenTick();
+			//int pitch = ev.pitch();
+			if (track->type() == Track::DRUM)
+			{
+				int ctl = ev.dataA();
+				// Is it a drum controller event, according to the track port's instrument?
+				MidiController *mc = midiPorts[defaultPort].drumController(ctl);
+				if (mc)
+				{
+					int instr = ctl & 0x7f;
+					ctl &= ~0xff;
+					int pitch = drumMap[instr].anote & 0x7f;
+					port = drumMap[instr].port; //This changes to non-default port
+					channel = drumMap[instr].channel;
+					MidiDevice* mdAlt = midiPorts[port].device();
+					if (mdAlt)
+					{
 						// p3.3.25
 						// If syncing to external midi sync, we cannot use the tempo map.
 						// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
 						if (extSyncFlag.value())
-							playEvents->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
+							mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
 						else
-							playEvents->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
 
-						stuckNotes->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
-					}
-					else
-					{ //Handle events to different port than standard.
-						MidiDevice* mdAlt = midiPorts[port].device();
-						if (mdAlt)
-						{
-							if (extSyncFlag.value())
-								mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
-							else
-								mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
+							mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
 
-							mdAlt->stuckNotes()->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
-						}
 					}
-
-					if (velo > track->activity())
-						track->setActivity(velo);
-				}
 					break;
+				}
+			}
+			// p3.3.25
+			if (extSyncFlag.value())
+				playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
+			else
+				playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
+		}
+			break;
 
-					// Added by T356.
-				case Controller:
-				{
-					//int len   = ev.lenTick();
-					//int pitch = ev.pitch();
-					if (track->type() == Track::DRUM)
-					{
-						int ctl = ev.dataA();
-						// Is it a drum controller event, according to the track port's instrument?
-						MidiController *mc = midiPorts[defaultPort].drumController(ctl);
-						if (mc)
-						{
-							int instr = ctl & 0x7f;
-							ctl &= ~0xff;
-							int pitch = drumMap[instr].anote & 0x7f;
-							port = drumMap[instr].port; //This changes to non-default port
-							channel = drumMap[instr].channel;
-							MidiDevice* mdAlt = midiPorts[port].device();
-							if (mdAlt)
-							{
-								// p3.3.25
-								// If syncing to external midi sync, we cannot use the tempo map.
-								// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
-								if (extSyncFlag.value())
-									mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
-								else
 
-									mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
+		default:
+			if (extSyncFlag.value())
+				playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
+			else
+				playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
 
-							}
-							break;
-						}
-					}
-					// p3.3.25
-					if (extSyncFlag.value())
-						playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
-					else
-						playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
-				}
-					break;
+			break;
+	}
+}
 
+//---------------------------------------------------------
+//   collectSnapshotEvents
+//    collect events for next audio segment from the
+//    track's compiled events
+//---------------------------------------------------------
 
-				default:
-					if (extSyncFlag.value())
-						playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
-					else
-						playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
+void Audio::collectSnapshotEvents(MidiTrack* track, MidiPlaySnapshot* ps, unsigned int cts, unsigned int nts)
+{
+	MidiDevice* md = midiPorts[track->outPort()].device();
+	MPEventList* playEvents = md->playEvents();
+	MidiEventWheel* stuckNotes = md->stuckNotes();
+	int port = track->outPort();
+	int channel = track->outChannel();
+	bool extsync = extSyncFlag.value();
+	const std::vector<CompiledMidiEvent>& events = ps->events;
+	unsigned n = events.size();
 
-					break;
-			}
+	unsigned i = ps->pos;
+	if (ps->tick != cts || i > n)
+	{
+		// not where the last segment ended, look it up
+		unsigned lo = 0, hi = n;
+		while (lo < hi)
+		{
+			unsigned mid = (lo + hi) / 2;
+			if (events[mid].tick < cts)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
+		i = lo;
 	}
+
+	for (; i < n && events[i].tick < nts; ++i)
+	{
+		const CompiledMidiEvent& ce = events[i];
+		// dont play muted parts
+		if (ce.part->mute())
+			continue;
+		// If syncing to external midi sync, we cannot use the tempo map.
+		// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
+		unsigned time = extsync ? ce.tick : ce.frame + frameOffset;
+		if (ce.type == ME_NOTEON)
+		{
+			playEvents->add(MidiPlayEvent(time, port, channel, ME_NOTEON, ce.a, ce.b, (Track*)track));
+			stuckNotes->add(MidiPlayEvent(ce.offTick, port, channel, ce.offType, ce.a, ce.veloOff, (Track*)track));
+			if (ce.b > track->activity())
+				track->setActivity(ce.b);
+		}
+		else if (ce.type == -1)
+			playEvents->add(MidiPlayEvent(time, port, channel, ps->data[ce.a], (Track*)track));
+		else
+			playEvents->add(MidiPlayEvent(time, port, channel, ce.type, ce.a, ce.b, (Track*)track));
+	}
+	ps->pos = i;
+	ps->tick = nts;
 }
 
 //---------------------------------------------------------
-//   processMidi
-//    - collects midi events for current audio segment and
-//       sends them to midi thread
-//    - current audio segment position is (curTickPos, nextTickPos)
-//    - called from midiseq thread,
-//      executed in audio thread
+//   collectEvents
+//    collect events for next audio segment
+//
+//    The track's play cursor remembers the parts playing
+//    and the next event of each, so a cycle only touches
+//    the parts under the play position. It starts over
+//    whenever the segment does not continue the last one
+//    (seek, loop, muted track) and after song edits.
+//
+//    Tracks with an up to date MidiPlaySnapshot are
+//    played from that instead.
 //---------------------------------------------------------
 
-void Audio::processMidi()
+void Audio::collectEvents(MidiTrack* track, unsigned int cts, unsigned int nts)
 {
-	midiBusy = true;
-	//
-	// TODO: syntis should directly write into recordEventList
-	//
-	for (iMidiDevice id = midiDevices.begin(); id != midiDevices.end(); ++id)
+	if (cts > nts)
 	{
-		MidiDevice* md = *id;
-		md->collectMidiEvents();
+		printf("processMidi: FATAL: cur > next %d > %d\n",
+				cts, nts);
+		return;
+	}
 
-		// Take snapshots of the current sizes of the recording fifos,
-		//  because they may change while here in process, asynchronously.
-		md->beforeProcess();
+	MidiPlaySnapshot* ps = track->playSnapshot;
+	if (ps && config.compiledMidiPlayback && track->type() == Track::MIDI && ps->matches(track, _editSerial))
+	{
+		collectSnapshotEvents(track, ps, cts, nts);
+		// the play cursor is out of step now
+		track->playCursor.valid = false;
+		return;
 	}
 
-	bool extsync = extSyncFlag.value();
+	MidiDevice* md = midiPorts[track->outPort()].device();
+	PartList* pl = track->parts();
+	MidiPlayCursor& pc = track->playCursor;
+	int delay = track->delay;
 
-	for (iMidiTrack t = song->midis()->begin(); t != song->midis()->end(); ++t)
+	if (!pc.valid || pc.tick != cts || pc.serial != _playCursorSerial || pc.delay != delay)
 	{
-		MidiTrack* track = *t;
-		int port = track->outPort();
-		MidiDevice* md = midiPorts[port].device();
+		pc.valid = true;
+		pc.serial = _playCursorSerial;
+		pc.delay = delay;
+		pc.nextPart = pl->begin();
+		pc.nactive = 0;
+	}
+	pc.tick = nts;
 
-		MPEventList* playEvents = 0;
-		if (md)
+	//
+	// start the parts reached in this segment
+	//
+	for (; pc.nextPart != pl->end(); ++pc.nextPart)
+	{
+		Part* part = pc.nextPart->second;
+		unsigned offset = delay + part->tick();
+		if (offset >= nts)
+			break;
+		if (offset + part->lenTick() <= cts)
+			continue;
+		unsigned stick = (offset > cts) ? 0 : cts - offset;
+		if (pc.nactive == PLAY_CURSOR_PARTS)
 		{
-			playEvents = md->playEvents();
-
-			// only add track events if the track is unmuted
-			if (!track->isMute())
-			{
-				if (isPlaying() && (curTickPos < nextTickPos))
-					collectEvents(track, curTickPos, nextTickPos);
-			}
+			// Too many overlapping parts to follow. Play this one
+			//  the slow way and start over in the next cycle.
+			pc.valid = false;
+			if (part->mute())
+				continue;
+			EventList* events = part->events();
+			iEvent iend = events->lower_bound(nts - offset < part->lenTick() ? nts - offset : part->lenTick());
+			for (iEvent ie = events->lower_bound(stick); ie != iend; ++ie)
+				collectEvent(track, md, ie->second, offset);
+			continue;
 		}
+		MidiPlayCursor::Active& a = pc.active[pc.nactive++];
+		a.part = part;
+		a.event = part->events()->lower_bound(stick);
+	}
 
-		//
-		//----------midi recording
-		//
-		if (track->recordFlag())
+	//
+	// play the active parts up to nts, drop the finished ones
+	//
+	for (int i = 0; i < pc.nactive;)
+	{
+		MidiPlayCursor::Active& a = pc.active[i];
+		Part* part = a.part;
+		EventList* events = part->events();
+		unsigned offset = delay + part->tick();
+		unsigned partLen = part->lenTick();
+		// Do not play events which are past the end of this part.
+		unsigned etick = nts - offset;
+		bool finished = etick >= partLen;
+		if (finished)
+			etick = partLen;
+		// dont play muted parts
+		bool mute = part->mute();
+		for (; a.event != events->end() && a.event->first < etick; ++a.event)
 		{
-			MPEventList* rl = track->mpevents();
-			MidiPort* tport = &midiPorts[port];
+			if (!mute)
+				collectEvent(track, md, a.event->second, offset);
+		}
+		if (finished)
+			a = pc.active[--pc.nactive];
+		else
+			++i;
+	}
+}
 
-			RouteList* irl = track->inRoutes();
-			for (ciRoute r = irl->begin(); r != irl->end(); ++r)
-			{
-				if (!r->isValid() || (r->type != Route::MIDI_PORT_ROUTE)) 
-					continue;
+//---------------------------------------------------------
+//   echoEvent
+//    play a recorded event through. Recorded events have
+//    song frames, played ones frames of the free running
+//    hw counter. Keeping the offset into the period lets
+//    synths play it in the same cycle it came in.
+//---------------------------------------------------------
 
-				int devport = r->midiPort;
-				if (devport == -1)
-					continue;
+static void echoEvent(MPEventList* el, MidiPlayEvent event, bool extsync)
+{
+	// With external sync the time is a tick.
+	if (!extsync)
+		event.setTime(event.time() + audio->getFrameOffset());
+	el->add(event);
+}
 
-				MidiDevice* dev = midiPorts[devport].device();
-				if (!dev)
-					continue;
+//---------------------------------------------------------
+//   recordMidiSysex
+//    record and echo the sysex events which came in from
+//    dev on track
+//---------------------------------------------------------
 
-				int channelMask = r->channel;
-				if (channelMask == -1 || channelMask == 0)
-					continue;
-				for (int channel = 0; channel < MIDI_CHANNELS; ++channel)
-				{
-					if (!(channelMask & (1 << channel)))
-						continue;
+void Audio::recordMidiSysex(MidiTrack* track, MidiDevice* dev, bool extsync)
+{
+	int port = track->outPort();
+	MidiDevice* md = midiPorts[port].device();
+	MPEventList* playEvents = md ? md->playEvents() : 0;
+	MPEventList* rl = track->mpevents();
 
-					if (!dev->sysexFIFOProcessed())
-					{
-						// Set to the sysex fifo at first.
-						MidiRecFifo& rf = dev->recordEvents(MIDI_CHANNELS);
-						// Get the frozen snapshot of the size.
-						int count = dev->tmpRecordCount(MIDI_CHANNELS);
+	// Set to the sysex fifo at first.
+	MidiRecFifo& rf = dev->recordEvents(MIDI_CHANNELS);
+	// Get the frozen snapshot of the size.
+	int count = dev->tmpRecordCount(MIDI_CHANNELS);
 
-						for (int i = 0; i < count; ++i)
-						{
-							MidiPlayEvent event(rf.peek(i));
+	for (int i = 0; i < count; ++i)
+	{
+		MidiPlayEvent event(rf.peek(i));
 
-							event.setPort(port);
+		event.setPort(port);
 
-							// dont't echo controller changes back to software
-							// synthesizer:
-                            if (md && track->recEcho())
-								playEvents->add(event);
+		// dont't echo controller changes back to software
+		// synthesizer:
+		if (md && track->recEcho())
+			echoEvent(playEvents, event, extsync);
 
-							// If syncing externally the event time is already in units of ticks, set above.
-							if (!extsync)
-							{
-								event.setTime(tempomap.frame2tick(event.time())); // set tick time
-							}
+		// If syncing externally the event time is already in units of ticks, set above.
+		if (!extsync)
+		{
+			event.setTime(tempomap.frame2tick(event.time())); // set tick time
+		}
 
-							if (recording)
-								rl->add(event);
-						}
+		if (recording)
+			rl->add(event);
+	}
 
-						dev->setSysexFIFOProcessed(true);
-					}
+	dev->setSysexFIFOProcessed(true);
+}
 
-					{
-						MidiRecFifo& rf = dev->recordEvents(channel);
-						int count = dev->tmpRecordCount(channel);
+//---------------------------------------------------------
+//   recordMidiChannel
+//    record and echo the events which came in from dev
+//    on channel on track, inPort is the port of dev
+//---------------------------------------------------------
 
-						for (int i = 0; i < count; ++i)
-						{
-							MidiPlayEvent event(rf.peek(i));
+void Audio::recordMidiChannel(MidiTrack* track, MidiDevice* dev, int inPort, int channel, bool extsync)
+{
+	int port = track->outPort();
+	MidiDevice* md = midiPorts[port].device();
+	MPEventList* playEvents = md ? md->playEvents() : 0;
+	MPEventList* rl = track->mpevents();
+	MidiPort* tport = &midiPorts[port];
 
-							int defaultPort = devport;
+	MidiRecFifo& rf = dev->recordEvents(channel);
+	int count = dev->tmpRecordCount(channel);
 
-							int drumRecPitch = 0; //prevent compiler warning: variable used without initialization
-							MidiController *mc = 0;
-							int ctl = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		MidiPlayEvent event(rf.peek(i));
 
-							//Hmmm, hehhh...
-							// TODO: Clean up a bit around here when it comes to separate events for rec & for playback.
-							// But not before 0.7 (ml)
+		int devport = inPort;
+		int defaultPort = devport;
 
-							int prePitch = 0, preVelo = 0;
+		int drumRecPitch = 0; //prevent compiler warning: variable used without initialization
+		MidiController *mc = 0;
+		int ctl = 0;
 
-							event.setChannel(track->outChannel());
+		//Hmmm, hehhh...
+		// TODO: Clean up a bit around here when it comes to separate events for rec & for playback.
+		// But not before 0.7 (ml)
 
-							if (event.isNote() || event.isNoteOff())
-							{
-								//
-								// apply track values
-								//
+		int prePitch = 0, preVelo = 0;
 
-								//Apply drum inkey:
-								if (track->type() == Track::DRUM)
-								{
-									int pitch = event.dataA();
-									//Map note that is played according to drumInmap
-									drumRecPitch = drumMap[(unsigned int) drumInmap[pitch]].enote;
-									devport = drumMap[(unsigned int) drumInmap[pitch]].port;
-									event.setPort(devport);
-									channel = drumMap[(unsigned int) drumInmap[pitch]].channel;
-									event.setA(drumMap[(unsigned int) drumInmap[pitch]].anote);
-									event.setChannel(channel);
-								}
-								else
-								{ //Track transpose if non-drum
-									prePitch = event.dataA();
-									int pitch = prePitch + track->getTransposition();
-									if (pitch > 127)
-										pitch = 127;
-									if (pitch < 0)
-										pitch = 0;
-									event.setA(pitch);
-								}
+		event.setChannel(track->outChannel());
 
-								if (!event.isNoteOff())
-								{
-									preVelo = event.dataB();
-									int velo = preVelo + track->velocity;
-									velo = (velo * track->compression) / 100;
-									if (velo > 127)
-										velo = 127;
-									if (velo < 1)
-										velo = 1;
-									event.setB(velo);
-								}
-							}
-							else if (event.type() == ME_CONTROLLER)
-							{
-								//printf("11111111111111111111111111111111111111111111111111111\n");
-								if (track->type() == Track::DRUM)
-								{
-									//printf("2222222222222222222222222222222222222222222222222222222222\n");
-									ctl = event.dataA();
-									// Regardless of what port the event came from, is it a drum controller event
-									//  according to the track port's instrument?
-									mc = tport->drumController(ctl);
-									if (mc)
-									{
-
-										//printf("333333333333333333333333333333333333333333333333\n");
-										int pitch = ctl & 0x7f;
-										ctl &= ~0xff;
-										int dmindex = drumInmap[pitch] & 0x7f;
-										//Map note that is played according to drumInmap
-										drumRecPitch = drumMap[dmindex].enote;
-										devport = drumMap[dmindex].port;
-										event.setPort(devport);
-										channel = drumMap[dmindex].channel;
-										event.setA(ctl | drumMap[dmindex].anote);
-										event.setChannel(channel);
-									}
-								}
-							}
+		if (event.isNote() || event.isNoteOff())
+		{
+			//
+			// apply track values
+			//
 
-							// dont't echo controller changes back to software
-							// synthesizer:
+			//Apply drum inkey:
+			if (track->type() == Track::DRUM)
+			{
+				int pitch = event.dataA();
+				//Map note that is played according to drumInmap
+				drumRecPitch = drumMap[(unsigned int) drumInmap[pitch]].enote;
+				devport = drumMap[(unsigned int) drumInmap[pitch]].port;
+				event.setPort(devport);
+				channel = drumMap[(unsigned int) drumInmap[pitch]].channel;
+				event.setA(drumMap[(unsigned int) drumInmap[pitch]].anote);
+				event.setChannel(channel);
+			}
+			else
+			{ //Track transpose if non-drum
+				prePitch = event.dataA();
+				int pitch = prePitch + track->getTransposition();
+				if (pitch > 127)
+					pitch = 127;
+				if (pitch < 0)
+					pitch = 0;
+				event.setA(pitch);
+			}
 
-                            //if (!dev->isSynthPlugin())
-							//{
-								//printf("444444444444444444444444444444444444444444444444444444\n");
-								//Check if we're outputting to another port than default:
-								if (devport == defaultPort)
-								{
+			if (!event.isNoteOff())
+			{
+				preVelo = event.dataB();
+				int velo = preVelo + track->velocity;
+				velo = (velo * track->compression) / 100;
+				if (velo > 127)
+					velo = 127;
+				if (velo < 1)
+					velo = 1;
+				event.setB(velo);
+			}
+		}
+		else if (event.type() == ME_CONTROLLER)
+		{
+			//printf("11111111111111111111111111111111111111111111111111111\n");
+			if (track->type() == Track::DRUM)
+			{
+				//printf("2222222222222222222222222222222222222222222222222222222222\n");
+				ctl = event.dataA();
+				// Regardless of what port the event came from, is it a drum controller event
+				//  according to the track port's instrument?
+				mc = tport->drumController(ctl);
+				if (mc)
+				{
 
-									//printf("5555555555555555555555555555555555555555555\n");
-									event.setPort(port);
-									if (md && track->recEcho())
-										playEvents->add(event);
-								}
-								else
-								{
-									//printf("66666666666666666666666666666666666666\n");
-									// Hmm, this appears to work, but... Will this induce trouble with md->setNextPlayEvent??
-									MidiDevice* mdAlt = midiPorts[devport].device();
-									if (mdAlt && track->recEcho())
-										mdAlt->playEvents()->add(event);
-								}
-								// Shall we activate meters even while rec echo is off? Sure, why not...
-								if (event.isNote() && event.dataB() > track->activity())
-									track->setActivity(event.dataB());
-							//}
-
-							// p3.3.25
-							// If syncing externally the event time is already in units of ticks, set above.
-							if (!extsync)
-							{
-								//printf("7777777777777777777777777777777777777777777\n");
-								// p3.3.35
-								//time = tempomap.frame2tick(event.time());
-								//event.setTime(time);  // set tick time
-								event.setTime(tempomap.frame2tick(event.time())); // set tick time
-							}
+					//printf("333333333333333333333333333333333333333333333333\n");
+					int pitch = ctl & 0x7f;
+					ctl &= ~0xff;
+					int dmindex = drumInmap[pitch] & 0x7f;
+					//Map note that is played according to drumInmap
+					drumRecPitch = drumMap[dmindex].enote;
+					devport = drumMap[dmindex].port;
+					event.setPort(devport);
+					channel = drumMap[dmindex].channel;
+					event.setA(ctl | drumMap[dmindex].anote);
+					event.setChannel(channel);
+				}
+			}
+		}
 
-							// Special handling of events stored in rec-lists. a bit hACKish. TODO: Clean up (after 0.7)! :-/ (ml)
-							if (recording)
-							{
-								//printf("888888888888888888888888888888888888888888888888\n");
-								// In these next steps, it is essential to set the recorded event's port
-								//  to the track port so buildMidiEventList will accept it. Even though
-								//  the port may have no device "<none>".
-								//
-								if (track->type() == Track::DRUM)
-								{
-									//printf("99999999999999999999999999999999999999999999999999\n");
-									// Is it a drum controller event?
-									if (mc)
-									{
-										//printf("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n");
-										MidiPlayEvent drumRecEvent = event;
-										drumRecEvent.setA(ctl | drumRecPitch);
-										// In this case, preVelo is simply the controller value.
-										drumRecEvent.setB(preVelo);
-										drumRecEvent.setPort(port); //rec-event to current port
-										drumRecEvent.setChannel(track->outChannel()); //rec-event to current channel
-										rl->add(drumRecEvent);
-									}
-									else
-									{
-										//printf("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\n");
-
-										MidiPlayEvent drumRecEvent = event;
-										drumRecEvent.setA(drumRecPitch);
-										drumRecEvent.setB(preVelo);
-										// Changed by T356.
-										// Tested: Events were not being recorded for a drum map entry pointing to a
-										//  different port. This must have been wrong - buildMidiEventList would ignore this.
-										//drumRecEvent.setPort(devport);
-										drumRecEvent.setPort(port); //rec-event to current port
-
-										drumRecEvent.setChannel(track->outChannel()); //rec-event to current channel
-										rl->add(drumRecEvent);
-									}
-								}
-								else
-								{
-									//printf("ccccccccccccccccccccccccccccccccccccccccccccc\n");
-									// Restore record-pitch to non-transposed value since we don't want the note transposed twice next
-									MidiPlayEvent recEvent = event;
-									recEvent.setPort(port);
-									recEvent.setChannel(track->outChannel());
-
-									rl->add(recEvent);
-									if (prePitch)
-										recEvent.setA(prePitch);
-									if (preVelo)
-										recEvent.setB(preVelo);
-								}
-							}
-						}
+		// dont't echo controller changes back to software
+		// synthesizer:
+
+		//if (!dev->isSynthPlugin())
+		//{
+			//printf("444444444444444444444444444444444444444444444444444444\n");
+			//Check if we're outputting to another port than default:
+			if (devport == defaultPort)
+			{
+
+				//printf("5555555555555555555555555555555555555555555\n");
+				event.setPort(port);
+				if (md && track->recEcho())
+					echoEvent(playEvents, event, extsync);
+			}
+			else
+			{
+				//printf("66666666666666666666666666666666666666\n");
+				// Hmm, this appears to work, but... Will this induce trouble with md->setNextPlayEvent??
+				MidiDevice* mdAlt = midiPorts[devport].device();
+				if (mdAlt && track->recEcho())
+					echoEvent(mdAlt->playEvents(), event, extsync);
+			}
+			// Shall we activate meters even while rec echo is off? Sure, why not...
+			if (event.isNote() && event.dataB() > track->activity())
+				track->setActivity(event.dataB());
+		//}
+
+		// p3.3.25
+		// If syncing externally the event time is already in units of ticks, set above.
+		if (!extsync)
+		{
+			//printf("7777777777777777777777777777777777777777777\n");
+			// p3.3.35
+			//time = tempomap.frame2tick(event.time());
+			//event.setTime(time);  // set tick time
+			event.setTime(tempomap.frame2tick(event.time())); // set tick time
+		}
+
+		// Special handling of events stored in rec-lists. a bit hACKish. TODO: Clean up (after 0.7)! :-/ (ml)
+		if (recording)
+		{
+			//printf("888888888888888888888888888888888888888888888888\n");
+			// In these next steps, it is essential to set the recorded event's port
+			//  to the track port so buildMidiEventList will accept it. Even though
+			//  the port may have no device "<none>".
+			//
+			if (track->type() == Track::DRUM)
+			{
+				//printf("99999999999999999999999999999999999999999999999999\n");
+				// Is it a drum controller event?
+				if (mc)
+				{
+					//printf("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n");
+					MidiPlayEvent drumRecEvent = event;
+					drumRecEvent.setA(ctl | drumRecPitch);
+					// In this case, preVelo is simply the controller value.
+					drumRecEvent.setB(preVelo);
+					drumRecEvent.setPort(port); //rec-event to current port
+					drumRecEvent.setChannel(track->outChannel()); //rec-event to current channel
+					rl->add(drumRecEvent);
+				}
+				else
+				{
+					//printf("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\n");
+
+					MidiPlayEvent drumRecEvent = event;
+					drumRecEvent.setA(drumRecPitch);
+					drumRecEvent.setB(preVelo);
+					// Changed by T356.
+					// Tested: Events were not being recorded for a drum map entry pointing to a
+					//  different port. This must have been wrong - buildMidiEventList would ignore this.
+					//drumRecEvent.setPort(devport);
+					drumRecEvent.setPort(port); //rec-event to current port
+
+					drumRecEvent.setChannel(track->outChannel()); //rec-event to current channel
+					rl->add(drumRecEvent);
+				}
+			}
+			else
+			{
+				//printf("ccccccccccccccccccccccccccccccccccccccccccccc\n");
+				// Restore record-pitch to non-transposed value since we don't want the note transposed twice next
+				MidiPlayEvent recEvent = event;
+				recEvent.setPort(port);
+				recEvent.setChannel(track->outChannel());
+
+				rl->add(recEvent);
+				if (prePitch)
+					recEvent.setA(prePitch);
+				if (preVelo)
+					recEvent.setB(preVelo);
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   recordMidiInputs
+//    The input routes of all midi tracks, grouped by port,
+//    see compilePlan(). Each channel fifo of a device is
+//    only looked at once, and its events go to the armed
+//    tracks listening.
+//---------------------------------------------------------
+
+void Audio::recordMidiInputs(const std::vector<MidiInputRoute>& inputs, bool extsync)
+{
+	for (unsigned k = 0; k < inputs.size();)
+	{
+		int devport = inputs[k].port;
+		unsigned end = k + 1;
+		while (end < inputs.size() && inputs[end].port == devport)
+			++end;
+		MidiDevice* dev = midiPorts[devport].device();
+		if (dev)
+		{
+			// Sysex goes to the first armed track listening to the device,
+			//  in track order whatever the channels.
+			if (!dev->sysexFIFOProcessed())
+			{
+				for (unsigned r = k; r < end; ++r)
+				{
+					if (inputs[r].track->recordFlag())
+					{
+						recordMidiSysex(inputs[r].track, dev, extsync);
+						break;
 					}
-				}//END for loop
+				}
+			}
+			for (int channel = 0; channel < MIDI_CHANNELS; ++channel)
+			{
+				if (dev->tmpRecordCount(channel) == 0)
+					continue;
+				for (unsigned r = k; r < end; ++r)
+				{
+					const MidiInputRoute& ir = inputs[r];
+					if ((ir.channelMask & (1 << channel)) && ir.track->recordFlag())
+						recordMidiChannel(ir.track, dev, devport, channel, extsync);
+				}
 			}
 		}
+		k = end;
 	}
+}
+
+//---------------------------------------------------------
+//   recordMidiRoutes
+//    recordMidiInputs() without the index, track by track
+//---------------------------------------------------------
+
+void Audio::recordMidiRoutes(bool extsync)
+{
+	for (iMidiTrack t = song->midis()->begin(); t != song->midis()->end(); ++t)
+	{
+		MidiTrack* track = *t;
+		if (!track->recordFlag())
+			continue;
+		const RouteList* irl = track->inRoutes();
+		for (ciRoute r = irl->begin(); r != irl->end(); ++r)
+		{
+			if (!r->isValid() || r->type != Route::MIDI_PORT_ROUTE || r->midiPort == -1)
+				continue;
+			if (r->channel == -1 || r->channel == 0)
+				continue;
+			MidiDevice* dev = midiPorts[r->midiPort].device();
+			if (!dev)
+				continue;
+			if (!dev->sysexFIFOProcessed())
+				recordMidiSysex(track, dev, extsync);
+			for (int channel = 0; channel < MIDI_CHANNELS; ++channel)
+			{
+				if (r->channel & (1 << channel))
+					recordMidiChannel(track, dev, r->midiPort, channel, extsync);
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   processMidi
+//    - collects midi events for current audio segment and
+//       sends them to midi thread
+//    - current audio segment position is (curTickPos, nextTickPos)
+//    - called from midiseq thread,
+//      executed in audio thread
+//---------------------------------------------------------
+
+void Audio::processMidi()
+{
+	midiBusy = true;
+	//
+	// TODO: syntis should directly write into recordEventList
+	//
+	for (iMidiDevice id = midiDevices.begin(); id != midiDevices.end(); ++id)
+	{
+		MidiDevice* md = *id;
+		md->collectMidiEvents();
+
+		// Take snapshots of the current sizes of the recording fifos,
+		//  because they may change while here in process, asynchronously.
+		md->beforeProcess();
+	}
+
+	bool extsync = extSyncFlag.value();
+
+	for (iMidiTrack t = song->midis()->begin(); t != song->midis()->end(); ++t)
+	{
+		MidiTrack* track = *t;
+		MidiDevice* md = midiPorts[track->outPort()].device();
+
+		// only add track events if the track is unmuted
+		if (md && !track->isMute())
+		{
+			if (isPlaying() && (curTickPos < nextTickPos))
+				collectEvents(track, curTickPos, nextTickPos);
+		}
+	}
+
+	//
+	//----------midi recording
+	//
+	// The plan has the input routes indexed by port. It is outdated for
+	//  the few cycles after a route change, walk the routes meanwhile.
+	//
+	ProcessPlan* plan = _plan;
+	if (plan && plan->serial == _topologySerial)
+		recordMidiInputs(plan->midiInputs, extsync);
+	else
+		recordMidiRoutes(extsync);
 
 	//
 	// clear all recorded events in midiDevices
@@ -1350,29 +1571,20 @@ void Audio::processMidi()
 		// We are done with the 'frozen' recording fifos, remove the events.
 		md->afterProcess();
 
-		MPEventList* stuckNotes = md->stuckNotes();
+		MidiEventWheel* stuckNotes = md->stuckNotes();
 		MPEventList* playEvents = md->playEvents();
 
-		iMPEvent k;
-		for (k = stuckNotes->begin(); k != stuckNotes->end(); ++k)
+		MidiPlayEvent ev;
+		while (stuckNotes->next(nextTickPos, ev))
 		{
-			if (k->time() >= nextTickPos)
-				break;
-			MidiPlayEvent ev(*k);
-
-			if (extsync)
-			{
-				ev.setTime(k->time());
-			}
-			else
+			if (!extsync)
 			{
-				int frame = tempomap.tick2frame(k->time()) + frameOffset;
+				int frame = tempomap.tick2frame(ev.time()) + frameOffset;
 				ev.setTime(frame);
 			}
 
 			playEvents->add(ev);
 		}
-		stuckNotes->erase(stuckNotes->begin(), k);
 	}
 
 	//---------------------------------------------------
@@ -1385,7 +1597,7 @@ void Audio::processMidi()
 	if (song->click() && (isPlaying() || state == PRECOUNT))
 	{
 		MPEventList* playEvents = 0;
-		MPEventList* stuckNotes = 0;
+		MidiEventWheel* stuckNotes = 0;
 		if (md)
 		{
 			playEvents = md->playEvents();
@@ -1461,7 +1673,7 @@ void Audio::processMidi()
 		{
 			MidiDevice* md = *imd;
 			MPEventList* playEvents = md->playEvents();
-			MPEventList* stuckNotes = md->stuckNotes();
+			MidiEventWheel* stuckNotes = md->stuckNotes();
 			if(playEvents->size())
 			{
 				/*if(debugMsg)
@@ -1472,15 +1684,14 @@ void Audio::processMidi()
 					);*/
 				//playEvents->clear();
 			}	
-			for (iMPEvent k = stuckNotes->begin(); k != stuckNotes->end(); ++k)
+			MidiPlayEvent ev;
+			while (stuckNotes->flush(ev))
 			{
-				MidiPlayEvent ev(*k);
 				//THis is why we are getting those error messages on song stop because it is setting all the 
 				//event times to the same point in time 
 				ev.setTime(0); // play now
 				playEvents->add(ev);
 			}
-			stuckNotes->clear();
 		}
 	}
 
@@ -1494,7 +1705,33 @@ void Audio::processMidi()
 		(*id)->processMidi();
 	}
 
+	//
+	// Tell the midi thread when the first event of the devices
+	// it plays is due, in case it sleeps until then.
+	//
+	unsigned nextFrame = ~0u;
+	if (!extsync)
+	{
+		for (iMidiDevice id = midiDevices.begin(); id != midiDevices.end(); ++id)
+		{
+			MidiDevice* md = *id;
+			if (md->deviceType() == MidiDevice::JACK_MIDI || md->isSynthPlugin())
+				continue;
+			MPEventList* el = md->playEvents();
+			if (el->empty())
+				continue;
+			// the midi thread takes them this much early
+			unsigned ahead = md->scheduleAhead();
+			unsigned frame = el->begin()->time();
+			frame = frame > ahead ? frame - ahead : 0;
+			if (frame < nextFrame)
+				nextFrame = frame;
+		}
+	}
+
 	midiBusy = false;
+	if (nextFrame != ~0u)
+		midiSeq->wakeup(nextFrame);
 }
 
 
@@ -12,6 +12,7 @@
 #include <list>
 
 #include "mpevent.h"
+#include "eventwheel.h"
 //#include "sync.h"
 #include "route.h"
 #include "globaldefs.h"
@@ -34,7 +35,7 @@ struct NRPNCache {
 //---------------------------------------------------------
 
 class MidiDevice {
-    MPEventList _stuckNotes;
+    MidiEventWheel _stuckNotes;
     MPEventList _playEvents;
 
     // Used for multiple reads of fifos during process.
@@ -169,6 +170,12 @@ public:
         return 0;
     }
 
+    // Frames before their time the midi thread hands events to
+    //  putEvent(), for devices which schedule them themselves.
+    virtual unsigned scheduleAhead() {
+        return 0;
+    }
+
     virtual void flush() {
     }
 
@@ -190,7 +197,7 @@ public:
     virtual void processMidi() {
     }
 
-    MPEventList* stuckNotes() {
+    MidiEventWheel* stuckNotes() {
         return &_stuckNotes;
     }
 
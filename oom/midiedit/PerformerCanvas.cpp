@@ -27,6 +27,7 @@
 #include "velocity.h"
 #include "song.h"
 #include "audio.h"
+#include "edittransaction.h"
 #include "gconfig.h"
 #include "traverso_shared/TConfig.h"
 #include "tracklistview.h"
@@ -979,6 +980,7 @@ void PerformerCanvas::pianoCmd(int cmd)/*{{{*/
 			if (part == 0)
 				break;
 			song->startUndo();
+			EditTransaction edits;
 			EventList* el = part->events();
 
 			std::list <Event> elist;
@@ -991,8 +993,9 @@ void PerformerCanvas::pianoCmd(int cmd)/*{{{*/
 				newEvent.setTick(event.tick() + editor->raster()); // - part->tick());
 				// Indicate no undo, and do not do port controller values and clone parts.
 				//audio->msgChangeEvent(event, newEvent, part, false);
-				audio->msgChangeEvent(event, newEvent, part, false, false, false);
+				edits.changeEvent(event, newEvent, part, false, false);
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
 			Pos p(editor->rasterVal(_pos[0] + editor->rasterStep(_pos[0])), true);
 			song->setPos(0, p, true, false, true);
@@ -1006,6 +1009,7 @@ void PerformerCanvas::pianoCmd(int cmd)/*{{{*/
 			if (part == 0)
 				break;
 			song->startUndo();
+			EditTransaction edits;
 			EventList* el = part->events();
 
 			std::list<Event> elist;
@@ -1018,8 +1022,9 @@ void PerformerCanvas::pianoCmd(int cmd)/*{{{*/
 				newEvent.setTick(event.tick() - editor->raster() - part->tick());
 				// Indicate no undo, and do not do port controller values and clone parts.
 				//audio->msgChangeEvent(event, newEvent, part, false);
-				audio->msgChangeEvent(event, newEvent, part, false, false, false);
+				edits.changeEvent(event, newEvent, part, false, false);
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
 			Pos p(editor->rasterVal(_pos[0] - editor->rasterStep(_pos[0])), true);
 			song->setPos(0, p, true, false, true);
@@ -1275,7 +1280,9 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 	{
 		case CMD_CUT:
 			copy();
+		{
 			song->startUndo();
+			EditTransaction edits;
 			for (iCItem i = _items.begin(); i != _items.end(); ++i)
 			{
 				if (!(i->second->isSelected()))
@@ -1283,9 +1290,11 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 				NEvent* e = (NEvent*) (i->second);
 				Event ev = e->event();
 				// Indicate no undo, and do not do port controller values and clone parts.
-				audio->msgDeleteEvent(ev, e->part(), false, false, false);
+				edits.deleteEvent(ev, e->part(), false, false);
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_REMOVED);
+		}
 			break;
 		case CMD_COPY:
 			copy();
@@ -1533,6 +1542,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 			int offset = w.offsetVal();
 
 			song->startUndo();
+			EditTransaction edits;
 			for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				NEvent* nevent = (NEvent*) (k->second);
@@ -1561,10 +1571,11 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 						newEvent.setLenTick(len);
 						// Indicate no undo, and do not do port controller values and clone parts.
 						//audio->msgChangeEvent(event, newEvent, nevent->part(), false);
-						audio->msgChangeEvent(event, newEvent, nevent->part(), false, false, false);
+						edits.changeEvent(event, newEvent, nevent->part(), false, false);
 					}
 				}
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
 		}
 			break;
@@ -1580,6 +1591,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 			int offset = w.offsetVal();
 
 			song->startUndo();
+			EditTransaction edits;
 	    	for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				NEvent* nevent = (NEvent*) (k->second);
@@ -1611,10 +1623,11 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 						newEvent.setVelo(velo);
 						// Indicate no undo, and do not do port controller values and clone parts.
 						//audio->msgChangeEvent(event, newEvent, nevent->part(), false);
-						audio->msgChangeEvent(event, newEvent, nevent->part(), false, false, false);
+						edits.changeEvent(event, newEvent, nevent->part(), false, false);
 					}
 				}
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
 		}
 			break;
@@ -1622,7 +1635,9 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 		case CMD_FIXED_LEN: //Set notes to the length specified in the drummap
 			if (!selectionSize())
 				break;
+		{
 			song->startUndo();
+			EditTransaction edits;
 			for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				if (k->second->isSelected())
@@ -1633,17 +1648,20 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					newEvent.setLenTick(editor->raster());
 					// Indicate no undo, and do not do port controller values and clone parts.
 					//audio->msgChangeEvent(event, newEvent, nevent->part() , false);
-					audio->msgChangeEvent(event, newEvent, nevent->part(), false, false, false);
+					edits.changeEvent(event, newEvent, nevent->part(), false, false);
 				}
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
+		}
 			break;
 
 		case CMD_DELETE_OVERLAPS:
 			if (!selectionSize())
 				break;
-
+		{
 			song->startUndo();
+			EditTransaction edits;
 	    	for (iCItem k = _items.begin(); k != _items.end(); k++)
 			{
 				if (k->second->isSelected() == false)
@@ -1706,10 +1724,12 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					newEvent.setLenTick(newlen);
 					// Indicate no undo, and do not do port controller values and clone parts.
 					//audio->msgChangeEvent(ce1, newEvent, e1->part(), false);
-					audio->msgChangeEvent(ce1, newEvent, e1->part(), false, false, false);
+					edits.changeEvent(ce1, newEvent, e1->part(), false, false);
 				}
 			}
+			audio->msgEditTransaction(edits, false);
 			song->endUndo(SC_EVENT_MODIFIED);
+		}
 			break;
 
 
@@ -1739,6 +1759,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 void PerformerCanvas::quantize(int strength, int limit, bool quantLen)/*{{{*/
 {
 	song->startUndo();
+	EditTransaction edits;
     for (iCItem k = _items.begin(); k != _items.end(); ++k)
 	{
 		NEvent* nevent = (NEvent*) (k->second);
@@ -1777,9 +1798,10 @@ void PerformerCanvas::quantize(int strength, int limit, bool quantLen)/*{{{*/
 			newEvent.setLenTick(len);
 			// Indicate no undo, and do not do port controller values and clone parts.
 			//audio->msgChangeEvent(event, newEvent, part, false);
-			audio->msgChangeEvent(event, newEvent, part, false, false, false);
+			edits.changeEvent(event, newEvent, part, false, false);
 		}
 	}
+	audio->msgEditTransaction(edits, false);
 	song->endUndo(SC_EVENT_MODIFIED);
 }/*}}}*/
 
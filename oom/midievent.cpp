@@ -160,9 +160,7 @@ void MidiEventBase::read(Xml& xml)
 			{
 				QByteArray ba = tag.toLatin1();
 				const char*s = ba.constData();
-				edata.data = new unsigned char[dataLen];
-				edata.dataLen = dataLen;
-				unsigned char* d = edata.data;
+				unsigned char* d = edata.resize(dataLen);
 				for (int i = 0; i < dataLen; ++i)
 				{
 					char* endp;
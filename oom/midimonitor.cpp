@@ -4,6 +4,7 @@
 
 #include <poll.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <values.h>
 #include <cmath>
@@ -32,6 +33,12 @@ static void readMsgMM(void* m, void*)
 	mm->readMsg1(sizeof (MonitorMsg));
 }
 
+static void readFeedbackMM(void* m, void*)
+{
+	MidiMonitor* mm = (MidiMonitor*) m;
+	mm->readFeedback();
+}
+
 MidiMonitor::MidiMonitor(const char* name) : Thread(name)
 {
 	//Start with this mode on so we dont process any events at all untill populateList is called
@@ -68,6 +75,20 @@ MidiMonitor::MidiMonitor(const char* name) : Thread(name)
 	sigFd = filedes[1];
 	QSocketNotifier* ss = new QSocketNotifier(filedes[0], QSocketNotifier::Read);
 	song->connect(ss, SIGNAL(activated(int)), song, SLOT(playMonitorEvent(int)));/*}}}*/
+
+	memset(m_feedbackSlots, 0, sizeof (m_feedbackSlots));
+	memset(m_feedbackDirty, 0, sizeof (m_feedbackDirty));
+	m_feedbackWake = 0;
+	m_feedbackDropped = 0;
+	if (pipe(filedes) == -1)
+	{
+		perror("creating feedback pipe");
+		exit(-1);
+	}
+	feedbackFdr = filedes[0];
+	feedbackFdw = filedes[1];
+	if (fcntl(feedbackFdr, F_SETFL, O_NONBLOCK) == -1 || fcntl(feedbackFdw, F_SETFL, O_NONBLOCK) == -1)
+		perror("set feedback pipe O_NONBLOCK");
 }
 
 MidiMonitor::~MidiMonitor()
@@ -295,10 +316,41 @@ void MidiMonitor::setLastFeedbackMessage(int port, int channel, int controller,
     m_lastFeedbackMessages.append(newMsg);
 }
 
+//---------------------------------------------------------
+//   processOutputFeedback
+//    send a controller played on track back to the
+//    assigned control surface
+//---------------------------------------------------------
+
+void MidiMonitor::processOutputFeedback(Track* track, int ctl, int val)/*{{{*/
+{
+	if(!m_feedback || !track)
+		return;
+	MidiAssignData* data = track->midiAssign();
+	if(!data->enabled || data->midimap.isEmpty())
+		return;
+	CCInfo* info = data->midimap.value(ctl);
+	if(info && info->assignedControl() >= 0)
+	{
+		if (m_feedbackMode == FEEDBACK_MODE_READ)
+		{
+			MidiPlayEvent ev(0, info->port(), info->channel(), ME_CONTROLLER, info->assignedControl(), val);
+			ev.setEventSource(MonitorSource);
+			midiPorts[ev.port()].device()->putEvent(ev);
+		}
+		else
+		{
+			setLastFeedbackMessage(info->port(), info->channel(), info->assignedControl(), val);
+			updateLater();
+		}
+	}
+}/*}}}*/
+
 void MidiMonitor::start(int priority)/*{{{*/
 {
 	clearPollFd();
 	addPollFd(toThreadFdr, POLLIN, ::readMsgMM, this, 0);
+	addPollFd(feedbackFdr, POLLIN, ::readFeedbackMM, this, 0);
 	Thread::start(priority);
 }/*}}}*/
 
@@ -327,16 +379,159 @@ void MidiMonitor::msgSendMidiOutputEvent(Track* track,  int ctl, int val)/*{{{*/
 	sendMsg1(&msg, sizeof (msg));
 }/*}}}*/
 
-void MidiMonitor::msgSendMidiOutputEvent(MidiPlayEvent ev)/*{{{*/
+//---------------------------------------------------------
+//   msgSendMidiOutputEvent
+//    called for every controller played by a midi device,
+//    from the jack process or the alsa midi thread. Only
+//    stores the latest value in the feedback table; the
+//    pipe is written once until readFeedback() drained it.
+//
+//    A controller goes to one of MONITOR_FEEDBACK_WAYS
+//    slots, and to one of them only. It takes over a slot
+//    whose value was already read, so the table never
+//    fills up with controllers which are not played any
+//    more. Only if all of them hold unread values of other
+//    controllers the value is dropped.
+//---------------------------------------------------------
+
+void MidiMonitor::msgSendMidiOutputEvent(const MidiPlayEvent& ev)/*{{{*/
 {
-	if(!isRunning())
+	if(!isRunning() || !m_feedback)
 		return;
-	//printf("MidiMonitor::msgSendMidiOutputEvent \n");
-	MonitorMsg msg;
-	msg.id = MONITOR_MIDI_OUT_EVENT;
-	msg.mevent = ev;
-	
-	sendMsg1(&msg, sizeof (msg));
+	unsigned long long key = ((((unsigned long long) ev.port()) << 32) | (ev.channel() << 24) | (ev.dataA() & 0xffffff)) + 1;
+	unsigned idx = (unsigned) ((key * 0x9e3779b97f4a7c15ULL) >> 32);
+	FeedbackSlot* set = &m_feedbackSlots[(idx % (MONITOR_FEEDBACK_SLOTS / MONITOR_FEEDBACK_WAYS)) * MONITOR_FEEDBACK_WAYS];
+
+	// Another writer may take the chosen slot first, look again then.
+	FeedbackSlot* slot = 0;
+	unsigned seq = 0;
+	for (int tries = 0; tries < 2 * MONITOR_FEEDBACK_WAYS && !slot; ++tries)
+	{
+		FeedbackSlot* mine = 0;
+		FeedbackSlot* spare = 0;
+		unsigned mineSeq = 0, spareSeq = 0;
+		unsigned long long spareKey = 0;
+		bool busy = false;
+		for (int i = 0; i < MONITOR_FEEDBACK_WAYS; ++i)
+		{
+			FeedbackSlot* s = &set[i];
+			unsigned sq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+			unsigned long long k = __atomic_load_n(&s->key, __ATOMIC_SEQ_CST);
+			if (k == key)
+			{
+				// Another writer of this controller, never move it
+				//  to a second slot meanwhile.
+				busy = sq & FEEDBACK_WRITING;
+				mine = s;
+				mineSeq = sq;
+				break;
+			}
+			if (!spare && !(sq & (FEEDBACK_WRITING | FEEDBACK_PENDING)))
+			{
+				spare = s;
+				spareSeq = sq;
+				spareKey = k;
+			}
+		}
+		if (busy)
+			continue;
+		FeedbackSlot* s = mine ? mine : spare;
+		unsigned sq = mine ? mineSeq : spareSeq;
+		if (!s)
+			break;
+		// The slot is ours if nobody wrote it since we looked at it.
+		if (!__atomic_compare_exchange_n(&s->seq, &sq, sq | FEEDBACK_WRITING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			continue;
+		if (!mine)
+		{
+			// Claim the spare for the controller. Two writers doing so
+			//  in different ways at once see each other's key, as
+			//  claiming and looking are sequentially consistent, and
+			//  who finds the key in another way gives back the spare.
+			bool claimed = __atomic_compare_exchange_n(&s->key, &spareKey, key, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			for (int i = 0; claimed && i < MONITOR_FEEDBACK_WAYS; ++i)
+			{
+				if (&set[i] != s && __atomic_load_n(&set[i].key, __ATOMIC_SEQ_CST) == key)
+					claimed = false;
+			}
+			if (!claimed)
+			{
+				__atomic_store_n(&s->key, 0, __ATOMIC_RELAXED);
+				__atomic_store_n(&s->seq, (sq + 4) & ~3u, __ATOMIC_RELEASE);
+				continue;
+			}
+		}
+		slot = s;
+		seq = sq;
+	}
+	if (!slot)
+	{
+		__atomic_add_fetch(&m_feedbackDropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	__atomic_store_n(&slot->track, ev.track(), __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->value, ev.dataB(), __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, ((seq + 4) & ~3u) | FEEDBACK_PENDING, __ATOMIC_RELEASE);
+
+	// Already queued if it was pending, readFeedback() then finds the new value.
+	if (seq & FEEDBACK_PENDING)
+		return;
+	int n = slot - m_feedbackSlots;
+	__atomic_fetch_or(&m_feedbackDirty[n / 32], 1u << (n % 32), __ATOMIC_SEQ_CST);
+	if (__atomic_exchange_n(&m_feedbackWake, 1, __ATOMIC_SEQ_CST) == 0)
+	{
+		// A full pipe has a wakeup in it already. On any other
+		//  error let the next value try again.
+		if (write(feedbackFdw, "f", 1) != 1 && errno != EAGAIN)
+			__atomic_store_n(&m_feedbackWake, 0, __ATOMIC_SEQ_CST);
+	}
+}/*}}}*/
+
+//---------------------------------------------------------
+//   readFeedback
+//    monitor thread: handle the controllers queued by
+//    msgSendMidiOutputEvent()
+//---------------------------------------------------------
+
+void MidiMonitor::readFeedback()/*{{{*/
+{
+	char buf[16];
+	while (read(feedbackFdr, buf, sizeof (buf)) > 0)
+		;
+	__atomic_store_n(&m_feedbackWake, 0, __ATOMIC_SEQ_CST);
+
+	for (int w = 0; w < MONITOR_FEEDBACK_SLOTS / 32; ++w)
+	{
+		unsigned bits = __atomic_exchange_n(&m_feedbackDirty[w], 0, __ATOMIC_SEQ_CST);
+		while (bits)
+		{
+			FeedbackSlot* slot = &m_feedbackSlots[w * 32 + __builtin_ctz(bits)];
+			bits &= bits - 1;
+			for (;;)
+			{
+				unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+				if (seq & FEEDBACK_WRITING)
+					continue; // a realtime thread is in the middle of it
+				if (!(seq & FEEDBACK_PENDING))
+					break;
+				unsigned long long key = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+				Track* track = __atomic_load_n(&slot->track, __ATOMIC_RELAXED);
+				int val = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+				// Only take the values if nothing was written since seq,
+				//  this also marks them as read.
+				if (__atomic_compare_exchange_n(&slot->seq, &seq, seq & ~FEEDBACK_PENDING, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				{
+					processOutputFeedback(track, (key - 1) & 0xffffff, val);
+					break;
+				}
+			}
+		}
+	}
+
+	unsigned dropped = __atomic_exchange_n(&m_feedbackDropped, 0, __ATOMIC_RELAXED);
+	if (dropped && debugMsg)
+		printf("MidiMonitor::readFeedback: %u controller values dropped\n", dropped);
 }/*}}}*/
 
 void MidiMonitor::msgSendAudioOutputEvent(Track* track, int ctl, double val)/*{{{*/
@@ -670,8 +865,12 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 									else
 									{
 										//printf("track volume\n");
-										audio->msgSetVolume((AudioTrack*) info->track(), dbToTrackVol(midiToDb(msg->mevent.dataB())));
-										((AudioTrack*) info->track())->startAutoRecord(AC_VOLUME, dbToTrackVol(midiToDb(msg->mevent.dataB())));
+										// Audio messages are only sent from the gui thread.
+										MonitorData mdata;
+										mdata.track = info->track();
+										mdata.dataType = AUDIO_VOLUME;
+										mdata.value = msg->mevent.dataB();
+										write(sigFd, &mdata, sizeof (MonitorData));
 									}/*}}}*/
 								}
 								break;
@@ -732,8 +931,11 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 									else
 									{
 										//printf("track pan\n");
-										audio->msgSetPan(((AudioTrack*) info->track()), midiToTrackPan(msg->mevent.dataB()));
-										((AudioTrack*) info->track())->recordAutomation(AC_PAN, midiToTrackPan(msg->mevent.dataB()));
+										MonitorData mdata;
+										mdata.track = info->track();
+										mdata.dataType = AUDIO_PAN;
+										mdata.value = msg->mevent.dataB();
+										write(sigFd, &mdata, sizeof (MonitorData));
 									}/*}}}*/
 								}
 								break;
@@ -859,41 +1061,6 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 				//audio->msgPlayMidiEvent(&ev);
 			}/*}}}*/
 		break;
-		case MONITOR_MIDI_OUT_EVENT:	//Used to process outgoing midi from midi tracks
-		{
-			//printf("MidiMonitor::processMsg1() Midi Output\n");
-			if(!m_feedback)
-				return;
-			Track* track = msg->mevent.track();
-			if(track/* && isAssigned(msg->track->name())*/)/*{{{*/
-			{
-				MidiAssignData* data = track->midiAssign();//m_assignments.value(msg->track->name());
-				if(/*!isManagedController(msg->ctl) || */!data->enabled || data->midimap.isEmpty())
-					return;
-				CCInfo* info = data->midimap.value(msg->mevent.dataA());
-				if(info && info->assignedControl() >= 0)
-				{
-					//int ccval = data->midimap.value(msg->ctl);
-					//if(ccval < 0)
-					//	return;
-					//printf("Sending midivalue from audio track: %d\n", msg->mval);
-					//TODO: Check if feedback is required before bothering with this
-
-                    if (m_feedbackMode == FEEDBACK_MODE_READ)
-                    {
-                        MidiPlayEvent ev(0, info->port(), info->channel(), ME_CONTROLLER, info->assignedControl(), msg->mevent.dataB());
-                        ev.setEventSource(MonitorSource);
-                        midiPorts[ev.port()].device()->putEvent(ev);
-                    }
-                    else
-                    {
-                        setLastFeedbackMessage(info->port(), info->channel(), info->assignedControl(), msg->mevent.dataB());
-                        updateLater();
-                    }
-				}
-			}/*}}}*/
-		}
-		break;
 		case MONITOR_MIDI_OUT:	//Used to process outgoing midi from midi tracks
 			//printf("MidiMonitor::processMsg1() Midi Output\n");
 			if(!m_feedback)
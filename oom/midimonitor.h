@@ -20,7 +20,6 @@ enum {
 	MONITOR_AUDIO_OUT,	//Used to process outgoing midi from audio tracks
 	MONITOR_MIDI_IN,	//Used to process incomming midi going to midi tracks/controllers
 	MONITOR_MIDI_OUT,	//Used to process outgoing midi from midi tracks
-	MONITOR_MIDI_OUT_EVENT,	//Used to process outgoing midi from midi tracks
 	MONITOR_MODIFY_CC,
 	MONITOR_DEL_CC,
 	MONITOR_MODIFY_PORT,
@@ -41,7 +40,9 @@ enum FeedbackMode {
 enum MonitorDataType {
 	MIDI_LEARN = 0,
 	MIDI_LEARN_NRPN,
-	MIDI_INPUT
+	MIDI_INPUT,
+	AUDIO_VOLUME,
+	AUDIO_PAN
 };
 
 struct MonitorData
@@ -71,6 +72,34 @@ struct MonitorMsg : public ThreadMsg
 	CCInfo* info;
 };
 
+// Number of (port, channel, controller) entries in the
+//  feedback table, a multiple of 32, and the number of
+//  entries a controller can go to
+#define MONITOR_FEEDBACK_SLOTS 1024
+#define MONITOR_FEEDBACK_WAYS 4
+
+// FeedbackSlot::seq bits
+#define FEEDBACK_WRITING 1 // a writer is changing the slot
+#define FEEDBACK_PENDING 2 // not yet seen by readFeedback()
+
+//---------------------------------------------------------
+//   FeedbackSlot
+//    latest controller value played by the midi devices
+//    for one (port, channel, controller), filled by
+//    msgSendMidiOutputEvent() from the realtime threads.
+//    key, track and value are only written under the
+//    FEEDBACK_WRITING bit of seq, and every write counts
+//    seq up, so the reader can tell a torn read.
+//---------------------------------------------------------
+
+struct FeedbackSlot
+{
+	unsigned seq;
+	unsigned long long key; // 0 = free
+	Track* track;
+	int value;
+};
+
 struct LastMidiInMessage
 {
     int port;
@@ -117,6 +146,15 @@ class MidiMonitor : public Thread
     int fromThreadFdw, fromThreadFdr; // message pipes
     int sigFd; // pipe fd for messages to gui
 
+	// Controller feedback from the midi devices. Written by the
+	// jack process and alsa midi threads without locking and
+	// coalesced to the latest value per (port, channel, controller).
+	FeedbackSlot m_feedbackSlots[MONITOR_FEEDBACK_SLOTS];
+	unsigned m_feedbackDirty[MONITOR_FEEDBACK_SLOTS / 32];
+	int m_feedbackWake; // set while a wakeup is in the pipe
+	unsigned m_feedbackDropped; // values which found no slot
+	int feedbackFdr, feedbackFdw;
+
 	virtual void processMsg1(const void*);
 	void addMonitoredTrack(Track*);
     void deleteMonitoredTrack(Track*);
@@ -129,6 +167,7 @@ class MidiMonitor : public Thread
 
     LastFeedbackMessage* getLastFeedbackMessage(int port, int channel, int controller);
     void setLastFeedbackMessage(int port, int channel, int controller, int value);
+	void processOutputFeedback(Track*, int ctl, int val);
 
 public:
 	MidiMonitor(const char* name);
@@ -141,7 +180,8 @@ public:
 
 	void msgSendMidiInputEvent(MEvent&);
 	void msgSendMidiOutputEvent(Track*,  int ctl, int val);
-	void msgSendMidiOutputEvent(MidiPlayEvent ev);
+	void msgSendMidiOutputEvent(const MidiPlayEvent& ev);
+	void readFeedback();
 	void msgSendAudioOutputEvent(Track*, int ctl, double val);
 	void msgModifyTrackController(Track*, int ctl, CCInfo* cc);
 	void msgDeleteTrackController(CCInfo* cc);
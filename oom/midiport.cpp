@@ -31,6 +31,7 @@
 
 MidiPort midiPorts[MIDI_PORTS];
 QHash<qint64, MidiPort*> oomMidiPorts;
+unsigned activeMidiPorts[MIDI_PORT_WORDS];
 
 //---------------------------------------------------------
 //   initMidiPorts
@@ -61,21 +62,13 @@ MidiPort::MidiPort()
 	_device = 0;
 	_instrument = 0;
 	_controller = new MidiCtrlValListList();
+	_managedControllers = false;
 	_foundInSongFile = false;
 	_patchSequences = QList<PatchSequence*>();
 	m_portId = create_id();
 
-	//
-	// create minimum set of managed controllers
-	// to make midi mixer operational
-	//
 	for (int i = 0; i < MIDI_CHANNELS; ++i)
-	{
-		addManagedController(i, CTRL_PROGRAM);
-		addManagedController(i, CTRL_VOLUME);
-		addManagedController(i, CTRL_PANPOT);
 		_automationType[i] = AUTO_READ;
-	}
 }
 
 //---------------------------------------------------------
@@ -138,6 +131,9 @@ void MidiPort::setMidiDevice(MidiDevice* dev)
 			}
 		}
 		_device = dev;
+		int port = portno();
+		__atomic_fetch_or(&activeMidiPorts[port >> 5], 1u << (port & 31), __ATOMIC_RELEASE);
+		addManagedControllers();
         if (_device->isSynthPlugin())
 		{
             SynthPluginDevice* s = (SynthPluginDevice*) _device;
@@ -158,6 +154,10 @@ void MidiPort::setMidiDevice(MidiDevice* dev)
 
 void MidiPort::clearDevice()
 {
+	int port = portno();
+	__atomic_fetch_and(&activeMidiPorts[port >> 5], ~(1u << (port & 31)), __ATOMIC_RELEASE);
+	// Song::beat() no longer times out the sync detectors of this port.
+	_syncInfo.clearDetect();
 	_device = 0;
 	_state = "not configured";
 }
@@ -168,12 +168,10 @@ void MidiPort::clearDevice()
 
 int MidiPort::portno() const
 {
-	for (int i = 0; i < MIDI_PORTS; ++i)
-	{
-		if (&midiPorts[i] == this)
-			return i;
-	}
-	return -1;
+	int i = this - midiPorts;
+	if (i < 0 || i >= MIDI_PORTS)
+		return -1;
+	return i;
 }
 
 //---------------------------------------------------------
@@ -504,6 +502,27 @@ void MidiPort::sendSongpos(int pos)
 	}
 }
 
+//---------------------------------------------------------
+//   addManagedControllers
+//    create minimum set of managed controllers
+//    to make midi mixer operational. Done once the port
+//    gets a device or a track, most of the MIDI_PORTS
+//    never need them.
+//---------------------------------------------------------
+
+void MidiPort::addManagedControllers()
+{
+	if (_managedControllers)
+		return;
+	_managedControllers = true;
+	for (int i = 0; i < MIDI_CHANNELS; ++i)
+	{
+		addManagedController(i, CTRL_PROGRAM);
+		addManagedController(i, CTRL_VOLUME);
+		addManagedController(i, CTRL_PANPOT);
+	}
+}
+
 //---------------------------------------------------------
 //   addManagedController
 //---------------------------------------------------------
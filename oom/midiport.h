@@ -55,6 +55,8 @@ class MidiPort
 
     RouteList _inRoutes, _outRoutes;
 
+    bool _managedControllers; // created by addManagedControllers()
+
     void clearDevice();
 
 public:
@@ -132,6 +134,7 @@ public:
 
     MidiController* midiController(int num) const;
     MidiCtrlValList* addManagedController(int channel, int ctrl);
+    void addManagedControllers();
     void tryCtrlInitVal(int chan, int ctl, int val);
     int limitValToInstrCtlRange(int ctl, int val);
     int limitValToInstrCtlRange(MidiController* mc, int val);
@@ -252,6 +255,33 @@ extern MidiPort midiPorts[MIDI_PORTS];
 extern QHash<qint64, MidiPort*> oomMidiPorts;
 extern void initMidiPorts();
 
+//---------------------------------------------------------
+//   activeMidiPorts
+//    one bit per port which has a device, kept up to date
+//    by MidiPort::setMidiDevice(). Loops which only care
+//    about ports with a device (most of the realtime ones)
+//    visit them with
+//
+//    for (int i = nextActiveMidiPort(0); i < MIDI_PORTS; i = nextActiveMidiPort(i + 1))
+//---------------------------------------------------------
+
+#define MIDI_PORT_WORDS (MIDI_PORTS / 32)
+extern unsigned activeMidiPorts[MIDI_PORT_WORDS];
+
+// first port >= port with a device, MIDI_PORTS if there is none
+static inline int nextActiveMidiPort(int port)
+{
+    for (int w = port >> 5; w < MIDI_PORT_WORDS; ++w)
+    {
+        unsigned bits = __atomic_load_n(&activeMidiPorts[w], __ATOMIC_ACQUIRE);
+        if (w == port >> 5)
+            bits &= ~0u << (port & 31);
+        if (bits)
+            return (w << 5) + __builtin_ctz(bits);
+    }
+    return MIDI_PORTS;
+}
+
 class QMenu;
 class QWidget;
 //extern QPopupMenu* midiPortsPopup(QWidget*);
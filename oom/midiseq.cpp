@@ -34,6 +34,11 @@ MidiSeq* midiSeq;
 int MidiSeq::ticker = 0;
 volatile bool midiBusy = false;
 
+// event driven timer (config.eventDrivenMidi)
+static const long MIDI_BUSY_RETRY = 100000; // nsec, audio thread in processMidi()
+static const long MIDI_FULL_RETRY = 1000000; // nsec, device did not take an event
+static const int MIDI_MAX_SLEEP = 10; // 1/n sec
+
 
 //---------------------------------------------------------
 //   readMsg
@@ -141,6 +146,9 @@ void MidiSeq::processMsg(const ThreadMsg* m)
 			printf("MidiSeq::processMsg() unknown id %d\n", msg->id);
 			break;
 	}
+	// Stop and seek queue events, SEQM_IDLE may end idle mode.
+	if (_eventTimer)
+		_eventTimer->setTimeout(0);
 }
 
 //---------------------------------------------------------
@@ -151,6 +159,8 @@ void MidiSeq::processStop()
 {
 	playStateExt = false; // not playing
 
+	alsaRemoveScheduled();
+
 	//
 	//    stop stuck notes
 	//
@@ -160,15 +170,14 @@ void MidiSeq::processStop()
 		if (md->midiPort() == -1)
 			continue;
 		MPEventList* pel = md->playEvents();
-		MPEventList* sel = md->stuckNotes();
+		MidiEventWheel* sel = md->stuckNotes();
 		pel->clear();
-		for (iMPEvent i = sel->begin(); i != sel->end(); ++i)
+		MidiPlayEvent ev;
+		while (sel->flush(ev))
 		{
-			MidiPlayEvent ev = *i;
 			ev.setTime(0);
 			pel->add(ev);
 		}
-		sel->clear();
 	}
 }
 
@@ -179,6 +188,8 @@ void MidiSeq::processStop()
 void MidiSeq::processSeek()
 {
 	int pos = audio->tickPos();
+	if (audio->isPlaying())
+		alsaRemoveScheduled();
 	if (pos == 0 && !song->record())
 		audio->initDevices();
 
@@ -201,14 +212,13 @@ void MidiSeq::processSeek()
 		{
 			// stop all notes
 			el->clear();
-			MPEventList* sel = dev->stuckNotes();
-			for (iMPEvent i = sel->begin(); i != sel->end(); ++i)
+			MidiEventWheel* sel = dev->stuckNotes();
+			MidiPlayEvent ev;
+			while (sel->flush(ev))
 			{
-				MidiPlayEvent ev = *i;
 				ev.setTime(0);
 				el->add(ev);
 			}
-			sel->clear();
 		}
 
 		for (iMidiCtrlValList ivl = cll->begin(); ivl != cll->end(); ++ivl)
@@ -244,6 +254,9 @@ MidiSeq::MidiSeq(const char* name)
 	lastTempo = 0;
 	storedtimediffs = 0;
 	playStateExt = false; // not playing
+	_eventTimer = 0;
+	_wakeFrame = 0;
+	_wakePending = 0;
 	doSetuid();
 	timerFd = selectTimer();
 	undoSetuid();
@@ -268,6 +281,21 @@ signed int MidiSeq::selectTimer()
 {
 	int tmrFd;
 
+	if (config.eventDrivenMidi)
+	{
+		printf("Trying POSIX timer...\n");
+		_eventTimer = new PosixTimer();
+		timer = _eventTimer;
+		tmrFd = timer->initTimer();
+		if (tmrFd != -1)
+		{ // ok!
+			printf("got timer = %d\n", tmrFd);
+			return tmrFd;
+		}
+		delete timer;
+		_eventTimer = 0;
+	}
+
 	printf("Trying RTC timer...\n");
 	timer = new RtcTimer();
 	tmrFd = timer->initTimer();
@@ -419,8 +447,11 @@ void MidiSeq::threadStop()
 bool MidiSeq::setRtcTicks()
 {
 	timer->setTimerFreq(config.rtcTicks);
-	timer->startTimer();
 	realRtcTicks = config.rtcTicks;
+	if (_eventTimer)
+		_eventTimer->setTimeout(0);
+	else
+		timer->startTimer();
 	return true;
 }
 
@@ -485,20 +516,34 @@ void MidiSeq::processTimerTick()
 
 	if (idle)
 	{
+		// the event timer is armed again when idle mode ends
 		return;
 	}
 	if (midiBusy)
 	{
 		// we hit audio: midiSeq->msgProcess
 		// miss this timer tick
+		if (_eventTimer)
+			_eventTimer->setTimeout(MIDI_BUSY_RETRY);
 		return;
 	}
 
+	if (_eventTimer)
+	{
+		// until the timer is armed again, any wakeup() counts
+		_wakeFrame = ~0u;
+		__atomic_store_n(&_wakePending, 0, __ATOMIC_SEQ_CST);
+	}
+
 	unsigned curFrame = audio->curFrame();
+	// earliest frame something is left to do at
+	unsigned nextFrame = curFrame + sampleRate / MIDI_MAX_SLEEP;
 
 	if (!extSyncFlag.value())
 	{
-		int curTick = lrint((double(curFrame) / double(sampleRate)) * double(tempomap.globalTempo()) * double(config.division) * 10000.0 / double(tempomap.tempo(song->cpos())));
+		double ticksPerSec = double(tempomap.globalTempo()) * double(config.division) * 10000.0 / double(tempomap.tempo(song->cpos(), _tempoCursor));
+		double tick = (double(curFrame) / double(sampleRate)) * ticksPerSec;
+		int curTick = lrint(tick);
 
 		if (midiClock > curTick)
 			midiClock = curTick;
@@ -510,13 +555,16 @@ void MidiSeq::processTimerTick()
 
 			bool used = false;
 
-			for (int port = 0; port < MIDI_PORTS; ++port)
+			for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
 			{
 				MidiPort* mp = &midiPorts[port];
 
 				// No device? Clock out not turned on?
 				if (!mp->device() || !mp->syncInfo().MCOut())
 					continue;
+				// Jack midi devices put the clock into their buffers.
+				if (mp->device()->deviceType() == MidiDevice::JACK_MIDI)
+					continue;
 
 				used = true;
 
@@ -548,6 +596,23 @@ void MidiSeq::processTimerTick()
 			// Using equalization periods...
 			midiClock += (perr * div);
 		}
+
+		if (_eventTimer)
+		{
+			for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
+			{
+				MidiPort* mp = &midiPorts[port];
+				if (mp->device() && mp->syncInfo().MCOut() && mp->device()->deviceType() != MidiDevice::JACK_MIDI)
+				{
+					// wake up for the next clock
+					double frames = (double(midiClock + div) - 0.5 - tick) * double(sampleRate) / ticksPerSec;
+					unsigned clockFrame = curFrame + (frames > 0.0 ? unsigned(ceil(frames)) : 0);
+					if (clockFrame < nextFrame)
+						nextFrame = clockFrame;
+					break;
+				}
+			}
+		}
 	}
 
 	int tickpos = audio->tickPos();
@@ -571,12 +636,15 @@ void MidiSeq::processTimerTick()
 		MPEventList* el = md->playEvents();
 		if (el->empty())
 			continue;
+		// Devices which schedule the events themselves take them early.
+		unsigned ahead = md->scheduleAhead();
 		iMPEvent i = el->begin(); 
+		bool full = false;
 		for (; i != el->end(); ++i)
 		{
 			// If syncing to external midi sync, we cannot use the tempo map.
 			// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
-			if (i->time() > (extsync ? tickpos : curFrame))
+			if (i->time() > (extsync ? tickpos : curFrame + ahead))
 			{
 				break; // skip this event
 			}
@@ -584,16 +652,77 @@ void MidiSeq::processTimerTick()
 			if (mp)
 			{
 				if (mp->sendEvent(*i))
+				{
+					full = true;
 					break;
+				}
 			}
 			else
 			{
 				if (md->putEvent(*i))
+				{
+					full = true;
 					break;
+				}
 			}
 		}
+		if (i != el->end() && !extsync && !full && i->time() - ahead < nextFrame)
+			nextFrame = i->time() - ahead;
 		el->erase(el->begin(), i);
+		if (full && _eventTimer)
+		{
+			// let the device drain
+			unsigned retryFrame = curFrame + unsigned((long long) sampleRate * MIDI_FULL_RETRY / 1000000000);
+			if (retryFrame < nextFrame)
+				nextFrame = retryFrame;
+		}
 	}
+
+	if (_eventTimer)
+	{
+		if (extsync)
+		{
+			// event times are ticks, keep polling
+			_eventTimer->setTimeout(1000000000 / realRtcTicks);
+		}
+		else
+			armEventTimer(curFrame, nextFrame);
+	}
+}
+
+//---------------------------------------------------------
+//   armEventTimer
+//    sleep until frame
+//---------------------------------------------------------
+
+void MidiSeq::armEventTimer(unsigned curFrame, unsigned frame)
+{
+	long nsec = 0;
+	if (frame > curFrame)
+		nsec = long((long long) (frame - curFrame) * 1000000000 / sampleRate);
+	_wakeFrame = frame;
+	_eventTimer->setTimeout(nsec);
+	// wakeup() came in while we were busy here and its
+	//  timeout may just have been overwritten
+	if (__atomic_load_n(&_wakePending, __ATOMIC_SEQ_CST))
+		_eventTimer->setTimeout(0);
+}
+
+//---------------------------------------------------------
+//   wakeup
+//    called from the audio thread after it has queued
+//    events for the devices played here; frame is the
+//    earliest one. Wakes the midi thread if it would
+//    sleep past it.
+//---------------------------------------------------------
+
+void MidiSeq::wakeup(unsigned frame)
+{
+	if (!_eventTimer || frame >= _wakeFrame)
+		return;
+	_wakeFrame = frame;
+	__atomic_store_n(&_wakePending, 1, __ATOMIC_SEQ_CST);
+	_eventTimer->setTimeout(0);
 }
 
 //---------------------------------------------------------
@@ -11,8 +11,10 @@
 
 #include "thread.h"
 #include "mpevent.h"
+#include "tempo.h"
 #include "driver/alsatimer.h"
 #include "driver/rtctimer.h"
+#include "driver/posixtimer.h"
 
 class MPEventList;
 class SynthI;
@@ -31,6 +33,7 @@ class MidiSeq : public Thread
     int idle;
     int prio; // realtime priority
     int midiClock;
+    TempoCursor _tempoCursor; // for processTimerTick()
     static int ticker;
 
     /* Testing */
@@ -50,11 +53,17 @@ class MidiSeq : public Thread
     /* Testing */
 
     Timer *timer;
+    // Set when the midi thread sleeps until the next event is due
+    //  (config.eventDrivenMidi) instead of polling at rtcTicks.
+    PosixTimer* _eventTimer;
+    volatile unsigned _wakeFrame; // frame the event timer expires at
+    volatile int _wakePending; // set by wakeup()
 
     signed int selectTimer();
     bool setRtcTicks();
     static void midiTick(void* p, void*);
     void processTimerTick();
+    void armEventTimer(unsigned curFrame, unsigned frame);
     void processSeek();
     void processStop();
     void processMidiClock();
@@ -96,6 +105,7 @@ public:
     void msgAddSynthI(SynthI* synth);
     void msgRemoveSynthI(SynthI* synth);
     void msgSetMidiDevice(MidiPort*, MidiDevice*);
+    void wakeup(unsigned frame);
 };
 
 extern MidiSeq* midiSeq;
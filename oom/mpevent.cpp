@@ -120,15 +120,11 @@ bool MEvent::operator<(const MEvent& e) const
 
 bool MidiFifo::put(const MidiPlayEvent& event)
 {
-	if (size < MIDI_FIFO_SIZE)
-	{
-		fifo[wIndex] = event;
-		wIndex = (wIndex + 1) % MIDI_FIFO_SIZE;
-		// q_atomic_increment(&size);
-		++size;
-		return false;
-	}
-	return true;
+	if (ring.full())
+		return true;
+	fifo[ring.writeIndex()] = event;
+	ring.push();
+	return false;
 }
 
 //---------------------------------------------------------
@@ -137,10 +133,8 @@ bool MidiFifo::put(const MidiPlayEvent& event)
 
 MidiPlayEvent MidiFifo::get()
 {
-	MidiPlayEvent event(fifo[rIndex]);
-	rIndex = (rIndex + 1) % MIDI_FIFO_SIZE;
-	// q_atomic_decrement(&size);
-	--size;
+	MidiPlayEvent event(fifo[ring.readIndex()]);
+	ring.pop();
 	return event;
 }
 
@@ -150,8 +144,7 @@ MidiPlayEvent MidiFifo::get()
 
 const MidiPlayEvent& MidiFifo::peek(int n)
 {
-	int idx = (rIndex + n) % MIDI_FIFO_SIZE;
-	return fifo[idx];
+	return fifo[ring.readIndex(n)];
 }
 
 //---------------------------------------------------------
@@ -160,8 +153,7 @@ const MidiPlayEvent& MidiFifo::peek(int n)
 
 void MidiFifo::remove()
 {
-	rIndex = (rIndex + 1) % MIDI_FIFO_SIZE;
-	--size;
+	ring.pop();
 }
 
 //---------------------------------------------------------
@@ -171,14 +163,11 @@ void MidiFifo::remove()
 
 bool MidiRecFifo::put(const MidiPlayEvent& event)
 {
-	if (size < MIDI_REC_FIFO_SIZE)
-	{
-		fifo[wIndex] = event;
-		wIndex = (wIndex + 1) % MIDI_REC_FIFO_SIZE;
-		++size;
-		return false;
-	}
-	return true;
+	if (ring.full())
+		return true;
+	fifo[ring.writeIndex()] = event;
+	ring.push();
+	return false;
 }
 
 //---------------------------------------------------------
@@ -187,9 +176,8 @@ bool MidiRecFifo::put(const MidiPlayEvent& event)
 
 MidiPlayEvent MidiRecFifo::get()
 {
-	MidiPlayEvent event(fifo[rIndex]);
-	rIndex = (rIndex + 1) % MIDI_REC_FIFO_SIZE;
-	--size;
+	MidiPlayEvent event(fifo[ring.readIndex()]);
+	ring.pop();
 	return event;
 }
 
@@ -199,8 +187,7 @@ MidiPlayEvent MidiRecFifo::get()
 
 const MidiPlayEvent& MidiRecFifo::peek(int n)
 {
-	int idx = (rIndex + n) % MIDI_REC_FIFO_SIZE;
-	return fifo[idx];
+	return fifo[ring.readIndex(n)];
 }
 
 //---------------------------------------------------------
@@ -209,6 +196,5 @@ const MidiPlayEvent& MidiRecFifo::peek(int n)
 
 void MidiRecFifo::remove()
 {
-	rIndex = (rIndex + 1) % MIDI_REC_FIFO_SIZE;
-	--size;
+	ring.pop();
 }
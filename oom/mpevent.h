@@ -14,6 +14,7 @@
 #include "evdata.h"
 #include "memory.h"
 #include "config.h"
+#include "spscring.h"
 
 //#define MIDI_FIFO_SIZE    2100
 //#define MIDI_REC_FIFO_SIZE    160
@@ -320,16 +321,13 @@ typedef MPEventList::const_iterator ciMPEvent;
 
 class MidiFifo
 {
-    MidiPlayEvent fifo[MIDI_FIFO_SIZE];
-    volatile int size;
-    int wIndex;
-    int rIndex;
+    SPSCRing ring; // lock free, one writer and one reader thread
+    MidiPlayEvent fifo[SPSCRingSize<MIDI_FIFO_SIZE>::value];
 
 public:
 
-    MidiFifo()
+    MidiFifo() : ring(MIDI_FIFO_SIZE)
     {
-        clear();
     }
     bool put(const MidiPlayEvent& event); // returns true on fifo overflow
     MidiPlayEvent get();
@@ -338,36 +336,34 @@ public:
 
     bool isEmpty() const
     {
-        return size == 0;
+        return ring.empty();
     }
 
     void clear()
     {
-        size = 0, wIndex = 0, rIndex = 0;
+        ring.clear();
     }
 
     int getSize() const
     {
-        return size;
+        return ring.size();
     }
 };
 
 class MidiRecFifo
 {
-	MidiPlayEvent fifo[MIDI_REC_FIFO_SIZE];
-	volatile int size;
-	int wIndex;
-	int rIndex;
+	SPSCRing ring; // lock free, one writer and one reader thread
+	MidiPlayEvent fifo[SPSCRingSize<MIDI_REC_FIFO_SIZE>::value];
 
 public:
-	MidiRecFifo() { clear(); }
+	MidiRecFifo() : ring(MIDI_REC_FIFO_SIZE) {}
 	bool put(const MidiPlayEvent&);
 	MidiPlayEvent get();
 	const MidiPlayEvent& peek(int n = 0);
 	void remove();
-	bool isEmpty() const { return size == 0; }
-	void clear() { size = 0, wIndex = 0, rIndex = 0; }
-	int getSize() const { return size; }
+	bool isEmpty() const { return ring.empty(); }
+	void clear() { ring.clear(); }
+	int getSize() const { return ring.size(); }
 };
 
 #endif
@@ -336,12 +336,10 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	printf("OOMidi: AudioTrack::copyData name:%s processed:%d\n", name().toLatin1().constData(), processed());
 #endif
 
-	// Special consideration for metronome: It is not part of the track list,
-	//  and it has no in or out routes, yet multiple output tracks may call addData on it !
-	// We can't tell how many output tracks call it, so we can only assume there might be more than one.
-	// Not strictly necessary here because only addData is ever called, but just to be consistent...
-	//bool usedirectbuf = (outRoutes()->size() <= 1) || (type() == AUDIO_OUTPUT);
-	bool usedirectbuf = ((outRoutes()->size() <= 1) || (type() == AUDIO_OUTPUT)) && (this != metronome);
+	// Use the supplied buffers directly if there is only one (or no) output route.
+	// Decided by Audio::updateTopology() when the routes change, false for the metronome:
+	//  it has no out routes, yet multiple output tracks may call addData on it !
+	bool usedirectbuf = _directBuffer;
 
 	int i;
 
@@ -353,7 +351,10 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	double _pan = pan();
 	vol[0] = _volume * (1.0 - _pan);
 	vol[1] = _volume * (1.0 + _pan);
-	float meter[srcChans];
+	// sample accurate gains, if automation moves volume or pan during this period
+	float rampData[3 * nframes];
+	float* ramp[2] = { rampData, rampData + nframes };
+	bool ramped = gainRamp(pos, nframes, ramp[0], ramp[1], rampData + 2 * nframes);
 
 	// Have we been here already during this process cycle?
 	if (processed())
@@ -377,10 +378,7 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 			for (i = 0; i < dstChannels; ++i)
 			{
 				if (config.useDenormalBias)
-				{
-					for (unsigned int q = 0; q < nframes; ++q)
-						dstBuffer[i][q] = denormalBias;
-				}
+					AL::dsp->fill(dstBuffer[i], denormalBias, nframes);
 				else
 					memset(dstBuffer[i], 0, sizeof (float) * nframes);
 			}
@@ -396,11 +394,19 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		for (i = 0; i < srcTotalOutChans; ++i)
 			buffer[i] = data + i * nframes;
 
+		// Was the data already fetched and run through the effects by an audio worker thread?
+		bool preRendered = (_preRenderCycle == _processCycle);
+		if (preRendered)
+		{
+			for (i = 0; i < srcTotalOutChans; ++i)
+				buffer[i] = _preBuffer[i];
+		}
+
 		// getData can use the supplied buffers, or change buffer to point to its own local buffers or Jack buffers etc.
 		// For ex. if this is an audio input, Jack will set the pointers for us in AudioInput::getData!
 		// p3.3.29 1/27/10 Don't do any processing at all if off. Whereas, mute needs to be ready for action at all times,
 		//  so still call getData before it. Off is NOT meant to be toggled rapidly, but mute is !
-		if (off() || !getData(pos, srcTotalOutChans, nframes, buffer) || (isMute() && !_prefader))
+		if (off() || !(preRendered ? _preRenderOk : getData(pos, srcTotalOutChans, nframes, buffer)) || (isMute() && !_prefader))
 		//if (off() || !getData(pos, srcTotalOutChans, nframes, buffer) || isMute())
 		{
 #ifdef NODE_DEBUG
@@ -408,14 +414,10 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 #endif
 
 			// No data was available. Zero the supplied buffers.
-			unsigned int q;
 			for (i = 0; i < dstChannels; ++i)
 			{
 				if (config.useDenormalBias)
-				{
-					for (q = 0; q < nframes; ++q)
-						dstBuffer[i][q] = denormalBias;
-				}
+					AL::dsp->fill(dstBuffer[i], denormalBias, nframes);
 				else
 					memset(dstBuffer[i], 0, sizeof (float) * nframes);
 			}
@@ -426,7 +428,7 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 			}
 
 			_haveData = false;
-			_processed = true;
+			_processedCycle = _processCycle;
 			return;
 		}
 
@@ -435,7 +437,8 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		//---------------------------------------------------
 
 		//fprintf(stderr, "AudioTrack::copyData %s efx apply srcChans:%d\n", name().toLatin1().constData(), srcChans);
-		_efxPipe->apply(srcChans, nframes, buffer);
+		if (!preRendered)
+			_efxPipe->apply(srcChans, nframes, buffer);
 
 		//---------------------------------------------------
 		// aux sends
@@ -463,12 +466,14 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 						{
 							float* db = dst[ch % a->channels()]; // no matter whether there's one or two dst buffers
 							float* sb = buffer[ch];
-							for (unsigned f = 0; f < nframes; ++f)
+							if (preaux)
+								AL::dsp->mixWithGain(db, sb, nframes, m); // add to mix
+							else if (!ramped)
+								AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]);
+							else
 							{
-								if(preaux)
-									*db++ += (*sb++ * m);// * vol[ch]); // add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
+								for (unsigned f = 0; f < nframes; ++f)
+									*db++ += (*sb++ * m * ramp[ch][f]);
 							}
 						}
 					}
@@ -478,12 +483,14 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 						{
 							float* db = dst[ch % a->channels()];
 							float* sb = buffer[0];
-							for (unsigned f = 0; f < nframes; ++f)
+							if (preaux)
+								AL::dsp->mixWithGain(db, sb, nframes, m); // add to mix
+							else if (!ramped)
+								AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]);
+							else
 							{
-								if(preaux)
-									*db++ += (*sb++ * m);// * vol[ch]); // add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
+								for (unsigned f = 0; f < nframes; ++f)
+									*db++ += (*sb++ * m * ramp[ch][f]);
 							}
 						}
 					}
@@ -499,16 +506,7 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		{
 			for (i = 0; i < srcChans; ++i)
 			{
-				float* p = buffer[i];
-				meter[i] = 0.0;
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					double f = fabs(*p);
-					if (f > meter[i])
-						meter[i] = f;
-					++p;
-				}
-				_meter[i] = meter[i];
+				_meter[i] = AL::dsp->peak(buffer[i], nframes, 0.0);
 				if (_meter[i] > _peak[i])
 					_peak[i] = _meter[i];
 			}
@@ -516,20 +514,16 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 
 		if (isMute())
 		{
-			unsigned int q;
 			for (i = 0; i < dstChannels; ++i)
 			{
 				if (config.useDenormalBias)
-				{
-					for (q = 0; q < nframes; q++)
-						dstBuffer[i][q] = denormalBias;
-				}
+					AL::dsp->fill(dstBuffer[i], denormalBias, nframes);
 				else
 					memset(dstBuffer[i], 0, sizeof (float) * nframes);
 			}
 
 			_haveData = false;
-			_processed = true;
+			_processedCycle = _processCycle;
 			return;
 		}
 
@@ -537,7 +531,10 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		if (!usedirectbuf)
 		{
 			for (i = 0; i < srcTotalOutChans; ++i)
-				AL::dsp->cpy(outBuffers[i], buffer[i], nframes);
+			{
+				if (buffer[i] != outBuffers[i])
+					AL::dsp->cpy(outBuffers[i], buffer[i], nframes);
+			}
 		}
 
 		// We have some data! Set to true.
@@ -547,18 +544,14 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	// Sanity check. Is source starting channel out of range? Just zero and return.
 	if (srcStartChan >= srcTotalOutChans)
 	{
-		unsigned int q;
 		for (i = 0; i < dstChannels; ++i)
 		{
 			if (config.useDenormalBias)
-			{
-				for (q = 0; q < nframes; q++)
-					dstBuffer[i][q] = denormalBias;
-			}
+				AL::dsp->fill(dstBuffer[i], denormalBias, nframes);
 			else
 				memset(dstBuffer[i], 0, sizeof (float) * nframes);
 		}
-		_processed = true;
+		_processedCycle = _processCycle;
 		return;
 	}
 	// Force a source range to fit actual available total out channels.
@@ -571,37 +564,19 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	//---------------------------------------------------
 
 
-	if (srcChans == dstChannels)
+	if (ramped)
+		applyGainRamp(buffer + srcStartChan, srcChans, dstBuffer, dstChannels, ramp, rampData + 2 * nframes, nframes, false);
+	else if (srcChans == dstChannels)
 	{
-		if (_prefader)
-		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ = (*sp++ * vol[c]);
-			}
-		}
-		else
+		for (int c = 0; c < dstChannels; ++c)
 		{
-			for (int c = 0; c < dstChannels; ++c)
+			float* sp = buffer[c + srcStartChan];
+			AL::dsp->cpyWithGain(dstBuffer[c], sp, nframes, vol[c]);
+			if (!_prefader)
 			{
-				meter[c] = 0.0;
-
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					float val = *sp++ * vol[c];
-					*dp++ = val;
-					double f = fabs(val);
-					if (f > meter[c])
-						meter[c] = f;
-				}
-				_meter[c] = meter[c];
+				// |x * v| is monotonic in |x|, so this is the same as
+				//  the peak of the scaled signal.
+				_meter[c] = AL::dsp->peak(sp, nframes, 0.0) * fabsf(vol[c]);
 				if (_meter[c] > _peak[c])
 					_peak[c] = _meter[c];
 			}
@@ -611,28 +586,11 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	{
 		float* sp = buffer[srcStartChan];
 
-		if (_prefader)
+		AL::dsp->cpyWithGain(dstBuffer[0], sp, nframes, vol[0]);
+		AL::dsp->cpyWithGain(dstBuffer[1], sp, nframes, vol[1]);
+		if (!_prefader)
 		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ = (*sp++ * vol[c]);
-			}
-		}
-		else
-		{
-			meter[0] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val = *sp++;
-				double f = fabs(val) * _volume;
-				if (f > meter[0])
-					meter[0] = f;
-				*(dstBuffer[0] + k) = val * vol[0];
-				*(dstBuffer[1] + k) = val * vol[1];
-			}
-			_meter[0] = meter[0];
+			_meter[0] = AL::dsp->peak(sp, nframes, 0.0) * _volume;
 			if (_meter[0] > _peak[0])
 				_peak[0] = _meter[0];
 		}
@@ -642,39 +600,102 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		float* sp1 = buffer[srcStartChan];
 		float* sp2 = buffer[srcStartChan + 1];
 
-		if (_prefader)
+		AL::dsp->cpyWithGain(dstBuffer[0], sp1, nframes, vol[0]);
+		AL::dsp->mixWithGain(dstBuffer[0], sp2, nframes, vol[1]);
+		if (!_prefader)
 		{
-			float* dp = dstBuffer[0];
-			for (unsigned k = 0; k < nframes; ++k)
-				*dp++ = (*sp1++ * vol[0] + *sp2++ * vol[1]);
+			for (int c = 0; c < 2; ++c)
+			{
+				_meter[c] = AL::dsp->peak(buffer[srcStartChan + c], nframes, 0.0) * fabsf(vol[c]);
+				if (_meter[c] > _peak[c])
+					_peak[c] = _meter[c];
+			}
 		}
-		else
+	}
+
+	_processedCycle = _processCycle;
+}
+
+//---------------------------------------------------------
+//   applyGainRamp
+//    Apply the per frame gains from gainRamp() and copy
+//    (or add) to dst. Does the postfader metering.
+//---------------------------------------------------------
+
+void AudioTrack::applyGainRamp(float** src, int srcChans, float** dst, int dstChannels, float** ramp, float* vol, unsigned n, bool add)
+{
+	if (srcChans == dstChannels)
+	{
+		for (int c = 0; c < dstChannels; ++c)
 		{
-			float* dp = dstBuffer[0];
-			meter[0] = 0.0;
-			meter[1] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
+			if (add)
+				AL::dsp->mixWithGainRamp(dst[c], src[c], ramp[c], n);
+			else
+				AL::dsp->cpyWithGainRamp(dst[c], src[c], ramp[c], n);
+			if (!_prefader)
 			{
-				float val1 = *sp1++ * vol[0];
-				float val2 = *sp2++ * vol[1];
-				double f1 = fabs(val1);
-				if (f1 > meter[0])
-					meter[0] = f1;
-				double f2 = fabs(val2);
-				if (f2 > meter[1])
-					meter[1] = f2;
-				*dp++ = (val1 + val2);
+				_meter[c] = AL::dsp->peakWithGainRamp(src[c], ramp[c], n, 0.0);
+				if (_meter[c] > _peak[c])
+					_peak[c] = _meter[c];
 			}
-			_meter[0] = meter[0];
+		}
+	}
+	else if (srcChans == 1 && dstChannels == 2)
+	{
+		for (int c = 0; c < dstChannels; ++c)
+		{
+			if (add)
+				AL::dsp->mixWithGainRamp(dst[c], src[0], ramp[c], n);
+			else
+				AL::dsp->cpyWithGainRamp(dst[c], src[0], ramp[c], n);
+		}
+		if (!_prefader)
+		{
+			_meter[0] = AL::dsp->peakWithGainRamp(src[0], vol, n, 0.0);
 			if (_meter[0] > _peak[0])
 				_peak[0] = _meter[0];
-			_meter[1] = meter[1];
-			if (_meter[1] > _peak[1])
-				_peak[1] = _meter[1];
 		}
 	}
+	else if (srcChans == 2 && dstChannels == 1)
+	{
+		if (add)
+			AL::dsp->mixWithGainRamp(dst[0], src[0], ramp[0], n);
+		else
+			AL::dsp->cpyWithGainRamp(dst[0], src[0], ramp[0], n);
+		AL::dsp->mixWithGainRamp(dst[0], src[1], ramp[1], n);
+		if (!_prefader)
+		{
+			for (int c = 0; c < 2; ++c)
+			{
+				_meter[c] = AL::dsp->peakWithGainRamp(src[c], ramp[c], n, 0.0);
+				if (_meter[c] > _peak[c])
+					_peak[c] = _meter[c];
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   preRender
+//    Fetch the data and run the effect rack ahead of the
+//    output pull, possibly from an audio worker thread.
+//    Only for tracks which canPreRender(). The result is
+//    picked up by the first copyData/addData this cycle.
+//---------------------------------------------------------
+
+void AudioTrack::preRender(unsigned pos, unsigned nframes)
+{
+	int srcTotalOutChans = totalOutChannels();
+	if (channels() == 1)
+		srcTotalOutChans = 1;
+
+	for (int i = 0; i < srcTotalOutChans; ++i)
+		_preBuffer[i] = outBuffers[i];
 
-	_processed = true;
+	_preRenderOk = getData(pos, srcTotalOutChans, nframes, _preBuffer);
+	if (_preRenderOk)
+		_efxPipe->apply(channels(), nframes, _preBuffer);
+	_preRenderCycle = _processCycle;
 }
 
 //---------------------------------------------------------
@@ -694,7 +715,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 
 	if (off())
 	{
-		_processed = true;
+		_processedCycle = _processCycle;
 		return;
 	}
 
@@ -706,10 +727,9 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	if (channels() == 1)
 		srcTotalOutChans = 1;
 
-	// Special consideration for metronome: It is not part of the track list,
-	//  and it has no in or out routes, yet multiple output tracks may call addData on it !
-	// We can't tell how many output tracks call it, so we can only assume there might be more than one.
-	bool usedirectbuf = ((outRoutes()->size() <= 1) || (type() == AUDIO_OUTPUT)) && (this != metronome);
+	// Use the supplied buffers directly if there is only one (or no) output route.
+	// Decided by Audio::updateTopology() when the routes change, false for the metronome.
+	bool usedirectbuf = _directBuffer;
 
 	int i;
 
@@ -721,7 +741,10 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	double _pan = pan();
 	vol[0] = _volume * (1.0 - _pan);
 	vol[1] = _volume * (1.0 + _pan);
-	float meter[srcChans];
+	// sample accurate gains, if automation moves volume or pan during this period
+	float rampData[3 * nframes];
+	float* ramp[2] = { rampData, rampData + nframes };
+	bool ramped = gainRamp(pos, nframes, ramp[0], ramp[1], rampData + 2 * nframes);
 
 	// Have we been here already during this process cycle?
 	if (processed())
@@ -753,9 +776,16 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 			buffer[i] = data + i * nframes;
 
 
+		bool preRendered = (_preRenderCycle == _processCycle);
+		if (preRendered)
+		{
+			for (i = 0; i < srcTotalOutChans; ++i)
+				buffer[i] = _preBuffer[i];
+		}
+
 		// getData can use the supplied buffers, or change buffer to point to its own local buffers or Jack buffers etc.
 		// For ex. if this is an audio input, Jack will set the pointers for us.
-		if (!getData(pos, srcTotalOutChans, nframes, buffer))
+		if (!(preRendered ? _preRenderOk : getData(pos, srcTotalOutChans, nframes, buffer)))
 		{
 			// No data was available. Nothing to add, but zero our local buffers and the meters.
 			for (i = 0; i < srcChans; ++i)
@@ -767,7 +797,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 			}
 
 			_haveData = false;
-			_processed = true;
+			_processedCycle = _processCycle;
 			return;
 		}
 
@@ -778,7 +808,8 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		// p3.3.41
 		//fprintf(stderr, "AudioTrack::addData %s efx apply srcChans:%d nframes:%ld %e %e %e %e\n",
 		//        name().toLatin1().constData(), srcChans, nframes, buffer[0][0], buffer[0][1], buffer[0][2], buffer[0][3]);
-		_efxPipe->apply(srcChans, nframes, buffer);
+		if (!preRendered)
+			_efxPipe->apply(srcChans, nframes, buffer);
 		// p3.3.41
 		//fprintf(stderr, "AudioTrack::addData after efx: %e %e %e %e\n",
 		//        buffer[0][0], buffer[0][1], buffer[0][2], buffer[0][3]);
@@ -809,12 +840,14 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 						{
 							float* db = dst[ch % a->channels()];
 							float* sb = buffer[ch];
-							for (unsigned f = 0; f < nframes; ++f)
+							if (preaux)
+								AL::dsp->mixWithGain(db, sb, nframes, m); // dont add to mix
+							else if (!ramped)
+								AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]); // add to mix
+							else
 							{
-								if(preaux)
-									*db++ += (*sb++ * m); // dont add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
+								for (unsigned f = 0; f < nframes; ++f)
+									*db++ += (*sb++ * m * ramp[ch][f]);
 							}
 						}
 					}
@@ -824,12 +857,14 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 						{
 							float* db = dst[ch % a->channels()];
 							float* sb = buffer[0];
-							for (unsigned f = 0; f < nframes; ++f)
+							if (preaux)
+								AL::dsp->mixWithGain(db, sb, nframes, m); // dont add to mix
+							else if (!ramped)
+								AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]); // add to mix
+							else
 							{
-								if(preaux)
-									*db++ += (*sb++ * m); // dont add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
+								for (unsigned f = 0; f < nframes; ++f)
+									*db++ += (*sb++ * m * ramp[ch][f]);
 							}
 						}
 					}
@@ -845,17 +880,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		{
 			for (i = 0; i < srcChans; ++i)
 			{
-				float* p = buffer[i];
-				meter[i] = 0.0;
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					double f = fabs(*p);
-					if (f > meter[i])
-						meter[i] = f;
-					++p;
-				}
-				//_meter[i] = lrint(meter[i] * 32767.0);
-				_meter[i] = meter[i];
+				_meter[i] = AL::dsp->peak(buffer[i], nframes, 0.0);
 				if (_meter[i] > _peak[i])
 					_peak[i] = _meter[i];
 			}
@@ -864,7 +889,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		if (isMute())
 		{
 			_haveData = false;
-			_processed = true;
+			_processedCycle = _processCycle;
 			return;
 		}
 
@@ -872,7 +897,10 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		if (!usedirectbuf)
 		{
 			for (i = 0; i < srcTotalOutChans; ++i)
-				AL::dsp->cpy(outBuffers[i], buffer[i], nframes);
+			{
+				if (buffer[i] != outBuffers[i])
+					AL::dsp->cpy(outBuffers[i], buffer[i], nframes);
+			}
 		}
 
 		// We have some data! Set to true.
@@ -882,18 +910,14 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	// Sanity check. Is source starting channel out of range? Just zero and return.
 	if (srcStartChan >= srcTotalOutChans)
 	{
-		unsigned int q;
 		for (i = 0; i < dstChannels; ++i)
 		{
 			if (config.useDenormalBias)
-			{
-				for (q = 0; q < nframes; q++)
-					dstBuffer[i][q] = denormalBias;
-			}
+				AL::dsp->fill(dstBuffer[i], denormalBias, nframes);
 			else
 				memset(dstBuffer[i], 0, sizeof (float) * nframes);
 		}
-		_processed = true;
+		_processedCycle = _processCycle;
 		return;
 	}
 	// Force a source range to fit actual available total out channels.
@@ -905,36 +929,17 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	//    postfader metering
 	//---------------------------------------------------
 
-	if (srcChans == dstChannels)
+	if (ramped)
+		applyGainRamp(buffer + srcStartChan, srcChans, dstBuffer, dstChannels, ramp, rampData + 2 * nframes, nframes, true);
+	else if (srcChans == dstChannels)
 	{
-		if (_prefader)
+		for (int c = 0; c < dstChannels; ++c)
 		{
-			for (int c = 0; c < dstChannels; ++c)
+			float* sp = buffer[c + srcStartChan];
+			AL::dsp->mixWithGain(dstBuffer[c], sp, nframes, vol[c]);
+			if (!_prefader)
 			{
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ += (*sp++ * vol[c]);
-			}
-		}
-		else
-		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				meter[c] = 0.0;
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					float val = *sp++ * vol[c];
-					*dp++ += val;
-					double f = fabs(val);
-					if (f > meter[c])
-						meter[c] = f;
-				}
-				_meter[c] = meter[c];
+				_meter[c] = AL::dsp->peak(sp, nframes, 0.0) * fabsf(vol[c]);
 				if (_meter[c] > _peak[c])
 					_peak[c] = _meter[c];
 			}
@@ -944,28 +949,10 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	{
 		float* sp = buffer[srcStartChan];
 
-		if (_prefader)
-		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ += (*sp++ * vol[c]);
-			}
-		}
-		else
+		AL::dsp->panMix(dstBuffer[0], dstBuffer[1], sp, nframes, vol[0], vol[1]);
+		if (!_prefader)
 		{
-			meter[0] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val = *sp++;
-				double f = fabs(val) * _volume;
-				if (f > meter[0])
-					meter[0] = f;
-				*(dstBuffer[0] + k) += val * vol[0];
-				*(dstBuffer[1] + k) += val * vol[1];
-			}
-			_meter[0] = meter[0];
+			_meter[0] = AL::dsp->peak(sp, nframes, 0.0) * _volume;
 			if (_meter[0] > _peak[0])
 				_peak[0] = _meter[0];
 		}
@@ -975,39 +962,20 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		float* sp1 = buffer[srcStartChan];
 		float* sp2 = buffer[srcStartChan + 1];
 
-		if (_prefader)
-		{
-			float* dp = dstBuffer[0];
-			for (unsigned k = 0; k < nframes; ++k)
-				*dp++ += (*sp1++ * vol[0] + *sp2++ * vol[1]);
-		}
-		else
+		AL::dsp->mixWithGain(dstBuffer[0], sp1, nframes, vol[0]);
+		AL::dsp->mixWithGain(dstBuffer[0], sp2, nframes, vol[1]);
+		if (!_prefader)
 		{
-			float* dp = dstBuffer[0];
-			meter[0] = 0.0;
-			meter[1] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
+			for (int c = 0; c < 2; ++c)
 			{
-				float val1 = *sp1++ * vol[0];
-				float val2 = *sp2++ * vol[1];
-				double f1 = fabs(val1);
-				if (f1 > meter[0])
-					meter[0] = f1;
-				double f2 = fabs(val2);
-				if (f2 > meter[1])
-					meter[1] = f2;
-				*dp++ += (val1 + val2);
+				_meter[c] = AL::dsp->peak(buffer[srcStartChan + c], nframes, 0.0) * fabsf(vol[c]);
+				if (_meter[c] > _peak[c])
+					_peak[c] = _meter[c];
 			}
-			_meter[0] = meter[0];
-			if (_meter[0] > _peak[0])
-				_peak[0] = _meter[0];
-			_meter[1] = meter[1];
-			if (_meter[1] > _peak[1])
-				_peak[1] = _meter[1];
 		}
 	}
 
-	_processed = true;
+	_processedCycle = _processCycle;
 }
 
 //---------------------------------------------------------
@@ -1160,8 +1128,7 @@ bool AudioInput::getData(unsigned, int channels, unsigned nframes, float** buffe
 
 			if (config.useDenormalBias)
 			{
-				for (unsigned int i = 0; i < nframes; i++)
-					buffer[ch][i] += denormalBias;
+				AL::dsp->addConstant(buffer[ch], denormalBias, nframes);
 
 				//fprintf(stderr, "AudioInput::getData %s Jack port %p efx apply channels:%d nframes:%ld %e %e %e %e\n",
 				//        name().toLatin1().constData(), jackPort, channels, nframes, buffer[0][0], buffer[0][1], buffer[0][2], buffer[0][3]);
@@ -1170,10 +1137,7 @@ bool AudioInput::getData(unsigned, int channels, unsigned nframes, float** buffe
 		else
 		{
 			if (config.useDenormalBias)
-			{
-				for (unsigned int i = 0; i < nframes; i++)
-					buffer[ch][i] = denormalBias;
-			}
+				AL::dsp->fill(buffer[ch], denormalBias, nframes);
 			else
 			{
 				memset(buffer[ch], 0, nframes * sizeof (float));
@@ -1396,10 +1360,7 @@ void AudioOutput::processInit(unsigned nframes)
 		{
 			buffer[i] = audioDevice->getBuffer(jackPorts[i], nframes);
 			if (config.useDenormalBias)
-			{
-				for (unsigned int j = 0; j < nframes; j++)
-					buffer[i][j] += denormalBias;
-			}
+				AL::dsp->addConstant(buffer[i], denormalBias, nframes);
 		}
 		else
 			printf("PANIC: processInit: no buffer from audio driver\n");
@@ -1435,10 +1396,7 @@ void AudioOutput::silence(unsigned n)
 	processInit(n);
 	for (int i = 0; i < channels(); ++i)
 		if (config.useDenormalBias)
-		{
-			for (unsigned int j = 0; j < n; j++)
-				buffer[i][j] = denormalBias;
-		}
+			AL::dsp->fill(buffer[i], denormalBias, n);
 		else
 		{
 			memset(buffer[i], 0, n * sizeof (float));
@@ -1509,18 +1467,16 @@ void AudioOutput::setName(const QString& s)
 
 Fifo::Fifo()
 {
-	oom_atomic_init(&count);
 	//nbuffer = FIFO_BUFFER;
-	nbuffer = fifoLength;
-	buffer = new FifoBuffer*[nbuffer];
-	for (int i = 0; i < nbuffer; ++i)
+	ring.setCapacity(fifoLength);
+	buffer = new FifoBuffer*[ring.slots()];
+	for (unsigned i = 0; i < ring.slots(); ++i)
 		buffer[i] = new FifoBuffer;
-	clear();
 }
 
 Fifo::~Fifo()
 {
-	for (int i = 0; i < nbuffer; ++i)
+	for (unsigned i = 0; i < ring.slots(); ++i)
 	{
 		// p3.3.45
 		if (buffer[i]->buffer)
@@ -1533,7 +1489,6 @@ Fifo::~Fifo()
 	}
 
 	delete[] buffer;
-	oom_atomic_destroy(&count);
 }
 
 //---------------------------------------------------------
@@ -1547,13 +1502,13 @@ bool Fifo::put(int segs, unsigned long samples, float** src, unsigned pos)
 	printf("FIFO::put segs:%d samples:%lu pos:%u\n", segs, samples, pos);
 #endif
 
-	if (oom_atomic_read(&count) == nbuffer)
+	if (ring.full())
 	{
 		if(debugMsg)
-			printf("FIFO %p overrun... %d\n", this, count.counter);
+			printf("FIFO %p overrun... %d\n", this, ring.size());
 		return true;
 	}
-	FifoBuffer* b = buffer[widx];
+	FifoBuffer* b = buffer[ring.writeIndex()];
 	int n = segs * samples;
 	if (b->maxSize < n)
 	{
@@ -1600,13 +1555,13 @@ bool Fifo::get(int segs, unsigned long samples, float** dst, unsigned* pos)
 	printf("FIFO::get segs:%d samples:%lu\n", segs, samples);
 #endif
 
-	if (oom_atomic_read(&count) == 0)
+	if (ring.empty())
 	{
 		if(debugMsg)
-			printf("FIFO %p underrun... %d\n", this, count.counter);
+			printf("FIFO %p underrun... %d\n", this, ring.size());
 		return true;
 	}
-	FifoBuffer* b = buffer[ridx];
+	FifoBuffer* b = buffer[ring.readIndex()];
 	if (!b->buffer)
 	{
 		if(debugMsg)
@@ -1625,7 +1580,7 @@ bool Fifo::get(int segs, unsigned long samples, float** dst, unsigned* pos)
 
 int Fifo::getCount()
 {
-	return oom_atomic_read(&count);
+	return ring.size();
 }
 //---------------------------------------------------------
 //   remove
@@ -1633,8 +1588,7 @@ int Fifo::getCount()
 
 void Fifo::remove()
 {
-	ridx = (ridx + 1) % nbuffer;
-	oom_atomic_dec(&count);
+	ring.pop();
 }
 
 //---------------------------------------------------------
@@ -1647,9 +1601,9 @@ bool Fifo::getWriteBuffer(int segs, unsigned long samples, float** buf, unsigned
 	printf("Fifo::getWriteBuffer segs:%d samples:%lu pos:%u\n", segs, samples, pos);
 #endif
 
-	if (oom_atomic_read(&count) == nbuffer)
+	if (ring.full())
 		return true;
-	FifoBuffer* b = buffer[widx];
+	FifoBuffer* b = buffer[ring.writeIndex()];
 	int n = segs * samples;
 	if (b->maxSize < n)
 	{
@@ -1691,8 +1645,7 @@ bool Fifo::getWriteBuffer(int segs, unsigned long samples, float** buf, unsigned
 
 void Fifo::add()
 {
-	widx = (widx + 1) % nbuffer;
-	oom_atomic_inc(&count);
+	ring.push();
 }
 
 //---------------------------------------------------------
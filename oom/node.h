@@ -11,88 +11,7 @@
 
 #include <list>
 
-#ifndef i386
-#include <pthread.h>
-
-typedef struct {
-    pthread_mutex_t lock;
-    int counter;
-} oom_atomic_t;
-#else
-
-typedef struct {
-    int counter;
-} oom_atomic_t;
-#endif
-
-static inline int oom_atomic_read(oom_atomic_t *v) {
-#ifndef i386
-    int ret;
-    pthread_mutex_lock(&v->lock);
-    ret = v->counter;
-    pthread_mutex_unlock(&v->lock);
-    return ret;
-#else
-    return v->counter;
-#endif
-}
-
-static inline void oom_atomic_set(oom_atomic_t *v, int i) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter = i;
-    pthread_mutex_unlock(&v->lock);
-#else
-    v->counter = i;
-#endif
-}
-
-static inline void oom_atomic_inc(oom_atomic_t *v) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter++;
-    pthread_mutex_unlock(&v->lock);
-#else
-    __asm__ __volatile__(
-            "lock ; " "incl %0"
-            : "=m" (v->counter)
-            : "m" (v->counter));
-#endif
-}
-
-static inline void oom_atomic_dec(oom_atomic_t *v) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter--;
-    pthread_mutex_unlock(&v->lock);
-#else
-    __asm__ __volatile__(
-            "lock ; " "decl %0"
-            : "=m" (v->counter)
-            : "m" (v->counter));
-#endif
-}
-#ifndef i386
-
-static inline void oom_atomic_init(oom_atomic_t *v) {
-    pthread_mutex_init(&v->lock, NULL);
-}
-#else
-
-static inline void oom_atomic_init(oom_atomic_t*) {
-}
-#endif
-
-#ifndef i386
-
-static inline void oom_atomic_destroy(oom_atomic_t *v) {
-    pthread_mutex_destroy(&v->lock);
-}
-#else
-
-static inline void oom_atomic_destroy(oom_atomic_t*) {
-}
-#endif
+#include "spscring.h"
 
 class Xml;
 class Pipeline;
@@ -120,10 +39,7 @@ struct FifoBuffer {
 };
 
 class Fifo {
-    int nbuffer;
-    int ridx; // read index; only touched by reader
-    int widx; // write index; only touched by writer
-    oom_atomic_t count; // buffer count; writer increments, reader decrements
+    SPSCRing ring; // lock free, one writer and one reader thread
     FifoBuffer** buffer;
 
 public:
@@ -131,9 +47,7 @@ public:
     ~Fifo();
 
     void clear() {
-        ridx = 0;
-        widx = 0;
-        oom_atomic_set(&count, 0);
+        ring.clear();
     }
     bool put(int, unsigned long, float** buffer, unsigned pos);
     bool getWriteBuffer(int, unsigned long, float** buffer, unsigned pos);
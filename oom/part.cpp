@@ -1009,6 +1009,8 @@ void Song::addPart(Part* part)
 	if (epos > len())
 		_len = epos;
 	part->track()->addPart(part);
+	if (part->track()->type() == Track::WAVE)
+		((WaveTrack*) part->track())->partsChanged();
 
 	//part->addPortCtrlEvents();
 	// Indicate do not do clones.
@@ -1027,6 +1029,8 @@ void Song::removePart(Part* part)
 	removePortCtrlEvents(part, false);
 	Track* track = part->track();
 	track->parts()->remove(part);
+	if (track->type() == Track::WAVE)
+		((WaveTrack*) track)->partsChanged();
 }
 
 //---------------------------------------------------------
@@ -0,0 +1,216 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <algorithm>
+#include <QTimer>
+
+#include "playbacksnapshot.h"
+#include "audio.h"
+#include "song.h"
+#include "track.h"
+#include "part.h"
+#include "tempo.h"
+#include "globals.h"
+#include "gconfig.h"
+#include "mpevent.h"
+#include "midi.h"
+
+// Changes which can make a snapshot out of date.
+#define SC_PLAYBACK (SC_TRACK_INSERTED | SC_TRACK_MODIFIED | SC_PART_INSERTED | SC_PART_REMOVED \
+	| SC_PART_MODIFIED | SC_EVENT_INSERTED | SC_EVENT_REMOVED | SC_EVENT_MODIFIED | SC_TEMPO \
+	| SC_CONFIG | SC_MIDI_TRACK_PROP)
+
+static bool tickLess(const CompiledMidiEvent& a, const CompiledMidiEvent& b)
+{
+	return a.tick < b.tick;
+}
+
+//---------------------------------------------------------
+//   compile
+//    Does the same to the events as Audio::collectEvent()
+//    does for a midi (not drum) track.
+//---------------------------------------------------------
+
+MidiPlaySnapshot* MidiPlaySnapshot::compile(MidiTrack* track, unsigned editSerial)
+{
+	MidiPlaySnapshot* s = new MidiPlaySnapshot;
+	s->_editSerial = editSerial;
+	s->_trackEditSerial = __atomic_load_n(&track->editSerial, __ATOMIC_ACQUIRE);
+	s->_tempoSN = tempomap.tempoSN();
+	s->_sampleRate = sampleRate;
+	s->_division = config.division;
+	s->_port = track->outPort();
+	s->_channel = track->outChannel();
+	s->_delay = track->delay;
+	s->_velocity = track->velocity;
+	s->_compression = track->compression;
+	s->_len = track->len;
+	s->_pitchShift = song->globalPitchShift();
+
+	PartList* pl = track->parts();
+	size_t n = 0;
+	for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
+		n += ip->second->events()->size();
+	s->events.reserve(n);
+
+	for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
+	{
+		Part* part = ip->second;
+		unsigned offset = s->_delay + part->tick();
+		unsigned partLen = part->lenTick();
+		EventList* el = part->events();
+		// Events past the end of the part are not played.
+		for (iEvent ie = el->begin(); ie != el->end() && ie->first < partLen; ++ie)
+		{
+			const Event& ev = ie->second;
+			CompiledMidiEvent ce;
+			ce.tick = ev.tick() + offset;
+			ce.frame = tempomap.tick2frame(ce.tick);
+			ce.part = part;
+			ce.offTick = 0;
+			ce.offType = 0;
+			ce.veloOff = 0;
+			switch (ev.type())
+			{
+				case Meta:
+					continue;
+				case Note:
+				{
+					int pitch = ev.pitch() + s->_pitchShift;
+					if (pitch > 127)
+						pitch = 127;
+					if (pitch < 0)
+						pitch = 0;
+					int velo = ev.velo() + s->_velocity;
+					velo = (velo * s->_compression) / 100;
+					if (velo > 127)
+						velo = 127;
+					if (velo < 1) // no off event
+						velo = 1;
+					int len = (ev.lenTick() * s->_len) / 100;
+					if (len <= 0) // dont allow zero length
+						len = 1;
+					ce.type = ME_NOTEON;
+					ce.a = pitch;
+					ce.b = velo;
+					ce.veloOff = ev.veloOff();
+					ce.offTick = ce.tick + len;
+					ce.offType = ce.veloOff ? ME_NOTEOFF : ME_NOTEON;
+				}
+					break;
+				case Controller:
+					ce.type = ME_CONTROLLER;
+					ce.a = ev.dataA();
+					ce.b = ev.dataB();
+					break;
+				case PAfter:
+					ce.type = ME_POLYAFTER;
+					ce.a = ev.dataA();
+					ce.b = ev.dataB();
+					break;
+				case CAfter:
+					ce.type = ME_AFTERTOUCH;
+					ce.a = ev.dataA();
+					ce.b = 0;
+					break;
+				default:
+					ce.type = -1;
+					ce.a = s->data.size();
+					ce.b = 0;
+					s->data.push_back(ev);
+					break;
+			}
+			s->events.push_back(ce);
+		}
+	}
+	// Parts may overlap. Keep the part order for events at the same tick.
+	std::stable_sort(s->events.begin(), s->events.end(), tickLess);
+	return s;
+}
+
+//---------------------------------------------------------
+//   matches
+//    true if the snapshot is what compile() would make
+//    of the track now. The edit serials cover the parts
+//    and their events, the rest is compared here.
+//---------------------------------------------------------
+
+bool MidiPlaySnapshot::matches(const MidiTrack* track, unsigned editSerial) const
+{
+	return _editSerial == editSerial
+			&& _trackEditSerial == __atomic_load_n(&track->editSerial, __ATOMIC_ACQUIRE)
+			&& _tempoSN == tempomap.tempoSN()
+			&& _sampleRate == sampleRate
+			&& _division == config.division
+			&& _port == track->outPort()
+			&& _channel == track->outChannel()
+			&& _delay == track->delay
+			&& _velocity == track->velocity
+			&& _compression == track->compression
+			&& _len == track->len
+			&& _pitchShift == song->globalPitchShift();
+}
+
+//---------------------------------------------------------
+//   PlaybackCompiler
+//---------------------------------------------------------
+
+PlaybackCompiler::PlaybackCompiler(QObject* parent)
+: QObject(parent)
+{
+	_timer = new QTimer(this);
+	_timer->setSingleShot(true);
+	connect(_timer, SIGNAL(timeout()), SLOT(compile()));
+	connect(song, SIGNAL(songChanged(int)), SLOT(songChanged(int)));
+	connect(song, SIGNAL(idleEnded()), SLOT(idleEnded()));
+}
+
+//---------------------------------------------------------
+//   songChanged
+//    Edits often come in bursts (dragging, typing values),
+//    wait for them to settle.
+//---------------------------------------------------------
+
+void PlaybackCompiler::songChanged(int flags)
+{
+	if (config.compiledMidiPlayback && (flags & SC_PLAYBACK))
+		_timer->start(100);
+}
+
+//---------------------------------------------------------
+//   idleEnded
+//    The gui may have changed the song while the audio
+//    thread was idle, without a songChanged() to tell.
+//---------------------------------------------------------
+
+void PlaybackCompiler::idleEnded()
+{
+	if (config.compiledMidiPlayback)
+		_timer->start(100);
+}
+
+//---------------------------------------------------------
+//   compile
+//    compile the tracks whose snapshot is out of date
+//---------------------------------------------------------
+
+void PlaybackCompiler::compile()
+{
+	if (!config.compiledMidiPlayback)
+		return;
+	unsigned editSerial = audio->editSerial();
+	MidiTrackList* tl = song->midis();
+	for (iMidiTrack it = tl->begin(); it != tl->end(); ++it)
+	{
+		MidiTrack* track = *it;
+		if (track->type() != Track::MIDI)
+			continue;
+		MidiPlaySnapshot* cur = __atomic_load_n(&track->playSnapshot, __ATOMIC_ACQUIRE);
+		if (cur && cur->matches(track, editSerial))
+			continue;
+		audio->msgSetPlaySnapshot(track, MidiPlaySnapshot::compile(track, editSerial));
+	}
+}
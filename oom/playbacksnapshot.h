@@ -0,0 +1,106 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __PLAYBACKSNAPSHOT_H__
+#define __PLAYBACKSNAPSHOT_H__
+
+#include <vector>
+#include <QObject>
+#include "event.h"
+
+class QTimer;
+class Part;
+class MidiTrack;
+
+//---------------------------------------------------------
+//   CompiledMidiEvent
+//    one midi message of a MidiPlaySnapshot, with the
+//    track settings already applied
+//---------------------------------------------------------
+
+struct CompiledMidiEvent
+{
+    unsigned tick; // absolute tick, including the track delay
+    unsigned frame; // tempomap.tick2frame(tick)
+    Part* part; // muted parts are skipped at play time
+    int type; // ME_NOTEON, ME_CONTROLLER ... or -1: play data[a]
+    int a, b;
+    // note off, for ME_NOTEON only
+    unsigned offTick;
+    int offType;
+    int veloOff;
+};
+
+//---------------------------------------------------------
+//   MidiPlaySnapshot
+//    all events of a midi track in play order, compiled
+//    in the gui thread by PlaybackCompiler and played by
+//    Audio::collectSnapshotEvents() instead of walking
+//    the parts.
+//
+//    A snapshot only stays in use as long as nothing it
+//    was compiled from has changed, see matches().
+//    Otherwise the audio thread falls back to the
+//    event lists until a new one arrives.
+//---------------------------------------------------------
+
+class MidiPlaySnapshot
+{
+    // compiled from:
+    unsigned _editSerial; // Audio::editSerial()
+    unsigned _trackEditSerial; // MidiTrack::editSerial
+    int _tempoSN;
+    int _sampleRate;
+    int _division;
+    int _port;
+    int _channel;
+    int _delay;
+    int _velocity;
+    int _compression;
+    int _len;
+    int _pitchShift;
+
+public:
+    std::vector<CompiledMidiEvent> events; // sorted by tick
+    std::vector<Event> data; // events played as they are (sysex)
+
+    // play position, only used by the audio thread
+    unsigned pos; // next event to play
+    unsigned tick; // end of the last collected segment
+
+    MidiPlaySnapshot()
+    {
+        pos = 0;
+        tick = 0;
+    }
+
+    static MidiPlaySnapshot* compile(MidiTrack*, unsigned editSerial);
+    bool matches(const MidiTrack*, unsigned editSerial) const;
+};
+
+//---------------------------------------------------------
+//   PlaybackCompiler
+//    compiles a MidiPlaySnapshot for every midi track
+//    shortly after the song has changed and hands them
+//    to the audio thread
+//---------------------------------------------------------
+
+class PlaybackCompiler : public QObject
+{
+    Q_OBJECT
+
+    QTimer* _timer;
+
+private slots:
+    void songChanged(int);
+    void idleEnded();
+    void compile();
+
+public:
+    PlaybackCompiler(QObject* parent);
+};
+
+#endif
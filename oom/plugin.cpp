@@ -113,6 +113,22 @@ QString BasePlugin::getAudioOutputPortName(uint32_t index)
     return QString("");
 }
 
+//---------------------------------------------------------
+//   eventFrame
+//    offset of a play event into the current period,
+//    the same as MidiJackDevice::queueEvent() uses
+//---------------------------------------------------------
+
+uint32_t BasePlugin::eventFrame(const MidiPlayEvent& ev, uint32_t frames)
+{
+    int ft = ev.time() - audio->getFrameOffset() - audio->pos().frame();
+    if (ft < 0)
+        return 0;
+    if (ft >= (int) frames)
+        return frames - 1;
+    return ft;
+}
+
 //---------------------------------------------------------
 //   process_synth
 //---------------------------------------------------------
@@ -492,6 +492,8 @@ protected:
     void* m_lib;
     QMutex m_proc_lock;
 
+    static uint32_t eventFrame(const MidiPlayEvent& ev, uint32_t frames);
+
     // synths only
     uint32_t m_ainsCount;
     uint32_t m_aoutsCount;
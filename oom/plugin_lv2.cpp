@@ -76,7 +76,8 @@ const uint16_t OOM_URI_MAP_ID_COUNT           = 4;
 // extra plugin hints
 const unsigned int PLUGIN_HAS_EXTENSION_STATE = 0x100;
 
-static LV2_Time_Position oom_lv2_time_pos = { 0, 0, LV2_TIME_STOPPED, 0, 0, 0, 0, 0, 0, 0.0 };
+// per thread, effects may be processed by the audio worker threads
+static __thread LV2_Time_Position oom_lv2_time_pos = { 0, 0, LV2_TIME_STOPPED, 0, 0, 0, 0, 0, 0, 0.0 };
 
 struct LV2World {
     LilvWorld* world;
@@ -1855,7 +1856,7 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                                 break;
                             }
 
-                            uint8_t* midi_event = lv2_event_reserve(&ev_iters[i], 0, 0, OOM_URI_MAP_ID_EVENT_MIDI, 3);
+                            uint8_t* midi_event = lv2_event_reserve(&ev_iters[i], eventFrame(*ev, frames), 0, OOM_URI_MAP_ID_EVENT_MIDI, 3);
                             midi_event[0] = ev->type() + ev->channel();
                             midi_event[1] = ev->dataA();
                             midi_event[2] = ev->dataB();
@@ -66,7 +66,7 @@ intptr_t VstHostCallback(AEffect* effect, int32_t opcode, int32_t index, intptr_
         break;
 
     case audioMasterGetTime:
-        static VstTimeInfo_R timeInfo;
+        static __thread VstTimeInfo_R timeInfo;
         memset(&timeInfo, 0, sizeof(VstTimeInfo_R));
         timeInfo.sampleRate = sampleRate;
 
@@ -888,6 +888,7 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
 
                     midiEvent->type = kVstMidiType;
                     midiEvent->byteSize = sizeof(VstMidiEvent);
+                    midiEvent->deltaFrames = eventFrame(*ev, frames);
                     midiEvent->midiData[0] = ev->type() + ev->channel();
                     midiEvent->midiData[1] = ev->dataA();
                     midiEvent->midiData[2] = ev->dataB();
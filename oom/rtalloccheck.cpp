@@ -0,0 +1,135 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include "rtalloccheck.h"
+
+#ifdef RT_ALLOC_CHECK
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#define NO_THROW noexcept
+#else
+#define THROW_BAD_ALLOC throw (std::bad_alloc)
+#define NO_THROW throw ()
+#endif
+
+static __thread int checkDepth;
+static __thread unsigned heapOps;
+
+static inline void countHeapOp()
+{
+	if (checkDepth)
+		++heapOps;
+}
+
+static inline void* checkedAlloc(size_t n)
+{
+	countHeapOp();
+	return malloc(n ? n : 1);
+}
+
+//---------------------------------------------------------
+//   global operator new/delete
+//---------------------------------------------------------
+
+void* operator new(size_t n) THROW_BAD_ALLOC
+{
+	void* p = checkedAlloc(n);
+	if (p == 0)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t n) THROW_BAD_ALLOC
+{
+	void* p = checkedAlloc(n);
+	if (p == 0)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t n, const std::nothrow_t&) NO_THROW
+{
+	return checkedAlloc(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) NO_THROW
+{
+	return checkedAlloc(n);
+}
+
+void operator delete(void* p) NO_THROW
+{
+	if (p)
+	{
+		countHeapOp();
+		free(p);
+	}
+}
+
+void operator delete[](void* p) NO_THROW
+{
+	if (p)
+	{
+		countHeapOp();
+		free(p);
+	}
+}
+
+void operator delete(void* p, const std::nothrow_t&) NO_THROW
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) NO_THROW
+{
+	operator delete[](p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) NO_THROW
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, size_t) NO_THROW
+{
+	operator delete[](p);
+}
+#endif
+
+//---------------------------------------------------------
+//   RtAllocCheck
+//---------------------------------------------------------
+
+RtAllocCheck::RtAllocCheck(const char* where)
+{
+	_where = where;
+	_start = heapOps;
+	++checkDepth;
+}
+
+//---------------------------------------------------------
+//   ~RtAllocCheck
+//---------------------------------------------------------
+
+RtAllocCheck::~RtAllocCheck()
+{
+	--checkDepth;
+	unsigned n = heapOps - _start;
+	if (n)
+	{
+		fprintf(stderr, "RtAllocCheck: %u heap operations in %s\n", n, _where);
+		assert(n == 0);
+	}
+}
+
+#endif
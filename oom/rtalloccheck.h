@@ -0,0 +1,46 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __RTALLOCCHECK_H__
+#define __RTALLOCCHECK_H__
+
+#include "config.h"
+
+//---------------------------------------------------------
+//   RtAllocCheck
+//    debug aid for the realtime threads, enabled with
+//    cmake -DENABLE_RT_ALLOC_CHECK=ON. Counts the calls to
+//    the global operator new/delete made by the current
+//    thread while the object is alive and complains when
+//    it goes out of scope. Compiles to nothing otherwise.
+//---------------------------------------------------------
+
+#ifdef RT_ALLOC_CHECK
+
+class RtAllocCheck
+{
+    const char* _where;
+    unsigned _start;
+
+public:
+    RtAllocCheck(const char* where);
+    ~RtAllocCheck();
+};
+
+#else
+
+class RtAllocCheck
+{
+public:
+
+    RtAllocCheck(const char*)
+    {
+    }
+};
+
+#endif
+
+#endif
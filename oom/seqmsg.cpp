@@ -17,6 +17,8 @@
 ///#include "sig.h"
 #include "al/sig.h"
 #include "audio.h"
+#include "edittransaction.h"
+#include "playbacksnapshot.h"
 #include "mididev.h"
 #include "audiodev.h"
 #include "alsamidi.h"
@@ -25,8 +27,63 @@
 #include "plugin.h"
 #include "driver/jackmidi.h"
 
+//---------------------------------------------------------
+//   queueMsg
+//    append a message to the audio thread's queue.
+//    Only blocks if the queue is full.
+//---------------------------------------------------------
+
+void Audio::queueMsg(AudioMsg* m, AudioMsgCallback callback, void* data, bool sync)
+{
+	for (;;)
+	{
+		pthread_mutex_lock(&_msgQueueLock);
+		if (!_msgRing.full())
+			break;
+		// Let the other senders go on while the audio thread catches up.
+		pthread_mutex_unlock(&_msgQueueLock);
+		usleep(1000);
+	}
+	AudioMsgSlot& slot = _msgQueue[_msgRing.writeIndex()];
+	slot.msg = m;
+	slot.callback = callback;
+	slot.data = data;
+	slot.sync = sync;
+	_msgRing.push();
+	pthread_mutex_unlock(&_msgQueueLock);
+}
+
+//---------------------------------------------------------
+//   flushMsgQueue
+//    audio is not running: process whatever is still
+//    queued in the calling thread. The lock keeps senders
+//    and other flushing threads out, the rings have one
+//    reader only.
+//---------------------------------------------------------
+
+void Audio::flushMsgQueue()
+{
+	pthread_mutex_lock(&_msgQueueLock);
+	while (!_msgRing.empty())
+	{
+		AudioMsgSlot slot = _msgQueue[_msgRing.readIndex()];
+		_msgRing.pop();
+		processMsg(slot.msg);
+		if (!slot.sync)
+		{
+			_msgDoneQueue[_msgDoneRing.writeIndex()] = slot;
+			_msgDoneRing.push();
+		}
+	}
+	pthread_mutex_unlock(&_msgQueueLock);
+	processMsgCallbacks();
+}
+
 //---------------------------------------------------------
 //   sendMsg
+//    send a message to the audio thread and wait until
+//    it (and everything queued before it) is processed,
+//    or only queue it if !waitRead
 //---------------------------------------------------------
 
 void Audio::sendMsg(AudioMsg* m, bool waitRead)
@@ -35,28 +92,91 @@ void Audio::sendMsg(AudioMsg* m, bool waitRead)
 
 	if (_running && waitRead)
 	{
+		pthread_mutex_lock(&_msgSyncLock);
 		m->serialNo = sno++;
-		//DEBUG:
-		msg = m;
-		// wait for next audio "process" call to finish operation
+		queueMsg(m, 0, 0, true);
+		// wait for the audio "process" call to finish operation
         int no = -1;
 		int rv = read(fromThreadFdr, &no, sizeof (int));
 		if (rv != sizeof (int))
 			perror("Audio: read pipe failed");
-		else if (no != (sno - 1))
+		else if (no != m->serialNo)
 		{
 			fprintf(stderr, "audio: bad serial number, read %d expected %d\n",
-					no, sno - 1);
+					no, m->serialNo);
 		}
+		pthread_mutex_unlock(&_msgSyncLock);
+	}
+	else if (_running)
+	{
+		// Not waiting, but still behind the messages queued
+		//  before. The caller keeps m, queue a copy.
+		sendMsgAsync(new AudioMsg(*m));
 	}
 	else
 	{
 		// if audio is not running (during initialization)
 		// process commands immediatly
+		flushMsgQueue();
 		processMsg(m);
 	}
 }
 
+//---------------------------------------------------------
+//   sendMsgAsync
+//    queue a message for the audio thread and return
+//    immediately. m must be allocated with new; it is
+//    deleted after callback (if any) has been called from
+//    processMsgCallbacks(), normally in the gui thread.
+//    Many messages can be handled in one audio period.
+//---------------------------------------------------------
+
+void Audio::sendMsgAsync(AudioMsg* m, AudioMsgCallback callback, void* data)
+{
+	if (!_running)
+	{
+		flushMsgQueue();
+		processMsg(m);
+		if (callback)
+			callback(m, data);
+		delete m;
+		return;
+	}
+
+	// Bound the number of messages waiting for their callback, so
+	//  the audio thread always finds room in _msgDoneRing.
+	while (__sync_add_and_fetch(&_msgsPending, 1) > AUDIO_MSG_QUEUE_SIZE)
+	{
+		__sync_sub_and_fetch(&_msgsPending, 1);
+		processMsgCallbacks();
+		usleep(1000);
+	}
+	queueMsg(m, callback, data, false);
+}
+
+//---------------------------------------------------------
+//   processMsgCallbacks
+//    finish asynchronous messages processed by the audio
+//    thread. Called from Song::seqSignal().
+//---------------------------------------------------------
+
+void Audio::processMsgCallbacks()
+{
+	// Somebody else (or a callback further up the stack) is at it.
+	if (pthread_mutex_trylock(&_msgDoneLock))
+		return;
+	while (!_msgDoneRing.empty())
+	{
+		AudioMsgSlot slot = _msgDoneQueue[_msgDoneRing.readIndex()];
+		_msgDoneRing.pop();
+		if (slot.callback)
+			slot.callback(slot.msg, slot.data);
+		delete slot.msg;
+		__sync_sub_and_fetch(&_msgsPending, 1);
+	}
+	pthread_mutex_unlock(&_msgDoneLock);
+}
+
 //---------------------------------------------------------
 //   sendMessage
 //    send request from gui to sequencer
@@ -249,17 +369,29 @@ void Audio::msgSetRecord(AudioTrack* node, bool val)
 	sendMsg(&msg);
 }
 
+//---------------------------------------------------------
+//   volumeChanged
+//    callback of msgSetVolume(), gui thread
+//---------------------------------------------------------
+
+static void volumeChanged(AudioMsg*, void*)
+{
+	// Only now does the track return the new volume.
+	song->update(SC_TRACK_MODIFIED);
+}
+
 //---------------------------------------------------------
 //   msgSetVolume
 //---------------------------------------------------------
 
 void Audio::msgSetVolume(AudioTrack* src, double val)
 {
-	AudioMsg msg;
-	msg.id = AUDIO_VOL;
-	msg.snode = src;
-	msg.dval = val;
-	sendMsg(&msg);
+	// Fader moves come in quick succession, don't wait for each one.
+	AudioMsg* msg = new AudioMsg;
+	msg->id = AUDIO_VOL;
+	msg->snode = src;
+	msg->dval = val;
+	sendMsgAsync(msg, volumeChanged);
 	//oom->composer->controllerChanged(src);
 }
 
@@ -269,11 +401,11 @@ void Audio::msgSetVolume(AudioTrack* src, double val)
 
 void Audio::msgSetPan(AudioTrack* node, double val)
 {
-	AudioMsg msg;
-	msg.id = AUDIO_PAN;
-	msg.snode = node;
-	msg.dval = val;
-	sendMsg(&msg);
+	AudioMsg* msg = new AudioMsg;
+	msg->id = AUDIO_PAN;
+	msg->snode = node;
+	msg->dval = val;
+	sendMsgAsync(msg);
 	//oom->composer->controllerChanged(node);
 }
 
@@ -428,14 +560,20 @@ void Audio::msgSetChannels(AudioTrack* node, int n)
 
 void Audio::msgSetPluginCtrlVal(AudioTrack* track, int param, double val, bool waitRead)
 {
-	AudioMsg msg;
+	AudioMsg* msg = new AudioMsg;
 
-	msg.id = AUDIO_SET_PLUGIN_CTRL_VAL;
-	msg.ival = param;
-	msg.dval = val;
-	//msg.plugin = plugin;
-	msg.snode = track;
-	sendMsg(&msg, waitRead);
+	msg->id = AUDIO_SET_PLUGIN_CTRL_VAL;
+	msg->ival = param;
+	msg->dval = val;
+	//msg->plugin = plugin;
+	msg->snode = track;
+	if (waitRead)
+		sendMsgAsync(msg);
+	else
+	{
+		sendMsg(msg, false);
+		delete msg;
+	}
 	//oom->composer->controllerChanged(track);
 }
 
@@ -935,6 +1073,72 @@ void Audio::msgChangeEvent(Event& oe, Event& ne, Part* part, bool doUndoFlag, bo
     sendMessage(&msg, doUndoFlag, waitRead);
 }
 
+//---------------------------------------------------------
+//   msgEditTransaction
+//    apply all edits of t with a single message
+//---------------------------------------------------------
+
+void Audio::msgEditTransaction(EditTransaction& t, bool doUndoFlag)
+{
+	if (t.empty())
+		return;
+	AudioMsg msg;
+	msg.id = SEQM_EDIT_TRANSACTION;
+	msg.p1 = &t;
+	sendMessage(&msg, doUndoFlag);
+}
+
+//---------------------------------------------------------
+//   deletePlaySnapshot
+//    callback of msgSetPlaySnapshot(), gui thread
+//---------------------------------------------------------
+
+static void deletePlaySnapshot(AudioMsg* msg, void*)
+{
+	delete (MidiPlaySnapshot*) msg->p2;
+}
+
+//---------------------------------------------------------
+//   msgSetPlaySnapshot
+//    hand compiled events of a midi track to the audio
+//    thread, the replaced ones are deleted later
+//---------------------------------------------------------
+
+void Audio::msgSetPlaySnapshot(MidiTrack* track, MidiPlaySnapshot* snapshot)
+{
+	AudioMsg* msg = new AudioMsg;
+	msg->id = AUDIO_SET_PLAY_SNAPSHOT;
+	msg->track = track;
+	msg->p1 = snapshot;
+	msg->p2 = 0;
+	sendMsgAsync(msg, deletePlaySnapshot);
+}
+
+//---------------------------------------------------------
+//   deletePlan
+//    callback of msgSetPlan(), gui thread
+//---------------------------------------------------------
+
+static void deletePlan(AudioMsg* msg, void*)
+{
+	delete (ProcessPlan*) msg->p2;
+}
+
+//---------------------------------------------------------
+//   msgSetPlan
+//    hand a process plan to the audio thread, the replaced
+//    one is deleted later
+//---------------------------------------------------------
+
+void Audio::msgSetPlan(ProcessPlan* plan)
+{
+	AudioMsg* msg = new AudioMsg;
+	msg->id = AUDIO_SET_PLAN;
+	msg->p1 = plan;
+	msg->p2 = 0;
+	sendMsgAsync(msg, deletePlan);
+}
+
 //---------------------------------------------------------
 //   msgAddTempo
 //---------------------------------------------------------
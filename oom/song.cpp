@@ -26,6 +26,7 @@
 #include "song.h"
 #include "track.h"
 #include "undo.h"
+#include "edittransaction.h"
 #include "key.h"
 #include "globals.h"
 #include "event.h"
@@ -49,6 +50,7 @@
 #include "mpevent.h"
 #include "midimonitor.h"
 #include "plugin.h"
+#include "utils.h"
 #include "traverso_shared/OOMCommand.h"
 #include "traverso_shared/TConfig.h"
 #include "CreateTrackDialog.h"
@@ -1983,13 +1985,17 @@ void Song::setMType(MType t)
 
 void Song::beat()
 {
+	// a tempo change in the audio thread leaves the lookup table stale
+	tempomap.updateTable();
+	// as part edits do with the wave part indices
+	for (iWaveTrack i = _waves.begin(); i != _waves.end(); ++i)
+		(*i)->updatePartIndex();
+
 	// Keep the sync detectors running...
-	for (int port = 0; port < MIDI_PORTS; ++port)
-	{
-		// Must keep them running even if there's no device...
-		//if(midiPorts[port].device())
+	// Ports without a device have nothing to detect, MidiPort::clearDevice()
+	//  has cleared their detectors.
+	for (int port = nextActiveMidiPort(0); port < MIDI_PORTS; port = nextActiveMidiPort(port + 1))
 		midiPorts[port].syncInfo().setTime();
-	}
 
 
 	int tick = audio->tickPos();
@@ -2284,17 +2290,15 @@ void Song::processMsg(AudioMsg* msg)
 			updateFlags = SC_TRACK_MODIFIED;
 			break;
 		case SEQM_ADD_EVENT:
-			updateFlags = SC_EVENT_INSERTED;
-			if (addEvent(msg->ev1, (MidiPart*) msg->p2))
-			{
-				Event ev;
-				//undoOp(UndoOp::AddEvent, ev, msg->ev1, (Part*)msg->p2);
-				undoOp(UndoOp::AddEvent, ev, msg->ev1, (Part*) msg->p2, msg->a, msg->b);
-			}
-			else
-				updateFlags = 0;
-			if (msg->a)
-				addPortCtrlEvents(msg->ev1, (Part*) msg->p2, msg->b);
+		{
+			EditOp op;
+			op.type = EditOp::AddEvent;
+			op.nEvent = msg->ev1;
+			op.part = (Part*) msg->p2;
+			op.doCtrls = msg->a;
+			op.doClones = msg->b;
+			updateFlags = processEditOp(op);
+		}
 			break;
 		case SEQM_ADD_EVENT_CHECK:
 		{
@@ -2356,24 +2360,35 @@ void Song::processMsg(AudioMsg* msg)
 		break;
 		case SEQM_REMOVE_EVENT:
 		{
-			Event event = msg->ev1;
-			MidiPart* part = (MidiPart*) msg->p2;
-			if (msg->a)
-				removePortCtrlEvents(event, part, msg->b);
-			Event e;
-			undoOp(UndoOp::DeleteEvent, e, event, (Part*) part, msg->a, msg->b);
-			deleteEvent(event, part);
-			updateFlags = SC_EVENT_REMOVED;
+			EditOp op;
+			op.type = EditOp::DeleteEvent;
+			op.oEvent = msg->ev1;
+			op.part = (Part*) msg->p2;
+			op.doCtrls = msg->a;
+			op.doClones = msg->b;
+			updateFlags = processEditOp(op);
 		}
 			break;
 		case SEQM_CHANGE_EVENT:
-			if (msg->a)
-				removePortCtrlEvents(msg->ev1, (MidiPart*) msg->p3, msg->b);
-			changeEvent(msg->ev1, msg->ev2, (MidiPart*) msg->p3);
-			if (msg->a)
-				addPortCtrlEvents(msg->ev2, (Part*) msg->p3, msg->b);
-			undoOp(UndoOp::ModifyEvent, msg->ev2, msg->ev1, (Part*) msg->p3, msg->a, msg->b);
-			updateFlags = SC_EVENT_MODIFIED;
+		{
+			EditOp op;
+			op.type = EditOp::ModifyEvent;
+			op.oEvent = msg->ev1;
+			op.nEvent = msg->ev2;
+			op.part = (Part*) msg->p3;
+			op.doCtrls = msg->a;
+			op.doClones = msg->b;
+			updateFlags = processEditOp(op);
+		}
+			break;
+		case SEQM_EDIT_TRANSACTION:
+		{
+			EditTransaction* t = (EditTransaction*) msg->p1;
+			int flags = 0;
+			for (EditTransaction::iterator i = t->begin(); i != t->end(); ++i)
+				flags |= processEditOp(*i);
+			updateFlags = flags;
+		}
 			break;
 
 		case SEQM_ADD_TEMPO:
@@ -2862,6 +2877,22 @@ void Song::processMonitorMessage(const void* m)
 				emit midiLearned(mdata->port, mdata->channel, mdata->msb, mdata->lsb);
 			}
 			break;
+			case AUDIO_VOLUME:
+			{
+				AudioTrack* track = (AudioTrack*) mdata->track;
+				double vol = dbToTrackVol(midiToDb(mdata->value));
+				audio->msgSetVolume(track, vol);
+				track->startAutoRecord(AC_VOLUME, vol);
+			}
+			break;
+			case AUDIO_PAN:
+			{
+				AudioTrack* track = (AudioTrack*) mdata->track;
+				double pan = midiToTrackPan(mdata->value);
+				audio->msgSetPan(track, pan);
+				track->recordAutomation(AC_PAN, pan);
+			}
+			break;
 		}
 	}
 }
@@ -2979,6 +3010,15 @@ void Song::seqSignal(int fd)/*{{{*/
 				update(SC_RACK);
 			}
 				break;
+			case 'M': // asynchronous audio messages done
+				audio->processMsgCallbacks();
+				break;
+			case 'T': // tracks or routes changed
+				audio->updatePlan();
+				break;
+			case 'I': // audio thread no longer idle
+				emit idleEnded();
+				break;
 			default:
 				printf("unknown Seq Signal <%c>\n", buffer[i]);
 				break;
@@ -4203,6 +4243,50 @@ void Song::removeTrackRealtime(Track* track)
 	}
 }
 
+//---------------------------------------------------------
+//   processEditOp
+//    realtime part of adding, deleting or changing an
+//    event. Returns the update flags.
+//---------------------------------------------------------
+
+int Song::processEditOp(EditOp& op)
+{
+	switch (op.type)
+	{
+		case EditOp::AddEvent:
+		{
+			int flags = 0;
+			if (addEvent(op.nEvent, (MidiPart*) op.part))
+			{
+				Event ev;
+				undoOp(UndoOp::AddEvent, ev, op.nEvent, op.part, op.doCtrls, op.doClones);
+				flags = SC_EVENT_INSERTED;
+			}
+			if (op.doCtrls)
+				addPortCtrlEvents(op.nEvent, op.part, op.doClones);
+			return flags;
+		}
+		case EditOp::DeleteEvent:
+		{
+			if (op.doCtrls)
+				removePortCtrlEvents(op.oEvent, op.part, op.doClones);
+			Event e;
+			undoOp(UndoOp::DeleteEvent, e, op.oEvent, op.part, op.doCtrls, op.doClones);
+			deleteEvent(op.oEvent, (MidiPart*) op.part);
+			return SC_EVENT_REMOVED;
+		}
+		case EditOp::ModifyEvent:
+			if (op.doCtrls)
+				removePortCtrlEvents(op.oEvent, (MidiPart*) op.part, op.doClones);
+			changeEvent(op.oEvent, op.nEvent, (MidiPart*) op.part);
+			if (op.doCtrls)
+				addPortCtrlEvents(op.nEvent, op.part, op.doClones);
+			undoOp(UndoOp::ModifyEvent, op.nEvent, op.oEvent, op.part, op.doCtrls, op.doClones);
+			return SC_EVENT_MODIFIED;
+	}
+	return 0;
+}
+
 //---------------------------------------------------------
 //   executeScript
 //---------------------------------------------------------
@@ -4229,6 +4313,8 @@ void Song::executeScript(const char* scriptfile, PartList* parts, int quant, boo
 		//FILE *fp = fopen(tmp, "w");
 		FILE *fp = fdopen(fd, "w");
 		MidiPart *part = (MidiPart*) (i->second);
+		// The whole part is replaced in one go once the script is done.
+		EditTransaction edits;
 		int partStart = part->endTick() - part->lenTick();
 		int z, n;
 		AL::sigmap.timesig(0, z, n);
@@ -4249,13 +4335,13 @@ void Song::executeScript(const char* scriptfile, PartList* parts, int quant, boo
 
 				fprintf(fp, "NOTE %d %d %d %d\n", ev.tick(), ev.dataA(), ev.lenTick(), ev.dataB());
 				// Indicate no undo, and do not do port controller values and clone parts.
-				audio->msgDeleteEvent(ev, part, false, false, false);
+				edits.deleteEvent(ev, part, false, false);
 			}
 			else if (ev.type() == Controller)
 			{
 				fprintf(fp, "CONTROLLER %d %d %d %d\n", ev.tick(), ev.dataA(), ev.dataB(), ev.dataC());
 				// Indicate no undo, and do not do port controller values and clone parts.
-				audio->msgDeleteEvent(ev, part, false, false, false);
+				edits.deleteEvent(ev, part, false, false);
 			}
 		}
 		fclose(fp);
@@ -4318,7 +4404,7 @@ void Song::executeScript(const char* scriptfile, PartList* parts, int quant, boo
 							e.setVelo(velo);
 							e.setLenTick(len);
 							// Indicate no undo, and do not do port controller values and clone parts.
-							audio->msgAddEvent(e, part, false, false, false);
+							edits.addEvent(e, part, false, false);
 						}
 						if (line.startsWith("CONTROLLER"))
 						{
@@ -4334,11 +4420,12 @@ void Song::executeScript(const char* scriptfile, PartList* parts, int quant, boo
 							e.setB(b);
 							e.setB(c);
 							// Indicate no undo, and do not do port controller values and clone parts.
-							audio->msgAddEvent(e, part, false, false, false);
+							edits.addEvent(e, part, false, false);
 						}
 					}
 					file.close();
 				}
+				audio->msgEditTransaction(edits, false);
 			}
 		}
 		remove(tmp);
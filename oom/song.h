@@ -30,6 +30,7 @@ class QUndoStack;
 class SynthI;
 struct MidiMsg;
 struct AudioMsg;
+struct EditOp;
 class Event;
 class Xml;
 class Sequencer;
@@ -232,6 +233,7 @@ public:
     void putEvent(int pv);
     void endMsgCmd();
     void processMsg(AudioMsg* msg);
+    int processEditOp(EditOp& op);
     void pushToHistoryStack(OOMCommand* cmd);
     void undoFromQtUndoStack();
     void redoFromQtUndoStack();
@@ -751,6 +753,7 @@ signals:
     void recordChanged(bool);
 	void playChanged(bool);
 	void playbackStateChanged(bool);
+	void idleEnded();
     void punchinChanged(bool);
     void punchoutChanged(bool);
     void clickChanged(bool);
@@ -0,0 +1,155 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __SPSCRING_H__
+#define __SPSCRING_H__
+
+// Size of a cache line on all cpus we care about. Used to keep
+//  the producer and consumer indices from sharing a line.
+#define SPSC_CACHE_LINE 64
+
+//---------------------------------------------------------
+//   SPSCRingSize
+//    smallest power of two >= N, at compile time
+//---------------------------------------------------------
+
+template <unsigned N, unsigned P = 1, bool done = (P >= N) >
+struct SPSCRingSize
+{
+    enum { value = SPSCRingSize<N, P * 2>::value };
+};
+
+template <unsigned N, unsigned P>
+struct SPSCRingSize<N, P, true>
+{
+    enum { value = P };
+};
+
+//---------------------------------------------------------
+//   SPSCRing
+//    index bookkeeping of a lock free ring buffer with
+//    exactly one producer and one consumer thread.
+//    The storage is owned by the user and must have
+//    slots() elements, a power of two. At most capacity()
+//    elements are queued at any time.
+//
+//    The indices run freely and are masked on access.
+//    Each side only writes its own index (with release
+//    semantics) and reads the other one with acquire, so
+//    the data in a slot is visible before the index that
+//    publishes it.
+//---------------------------------------------------------
+
+class SPSCRing
+{
+    unsigned _capacity;
+    unsigned _mask;
+    char _pad0[SPSC_CACHE_LINE - 2 * sizeof (unsigned)];
+    unsigned _head; // next slot to write, only written by the producer
+    char _pad1[SPSC_CACHE_LINE - sizeof (unsigned)];
+    unsigned _tail; // next slot to read, only written by the consumer
+    char _pad2[SPSC_CACHE_LINE - sizeof (unsigned)];
+
+    unsigned loadHead() const
+    {
+        return __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    }
+
+    unsigned loadTail() const
+    {
+        return __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+public:
+
+    SPSCRing(unsigned capacity = 0)
+    {
+        setCapacity(capacity);
+    }
+
+    static unsigned roundUp(unsigned n)
+    {
+        unsigned p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    // Not thread safe, only call while neither side is active.
+    void setCapacity(unsigned capacity)
+    {
+        _capacity = capacity;
+        _mask = roundUp(capacity) - 1;
+        clear();
+    }
+
+    // Not thread safe, only call while neither side is active.
+    void clear()
+    {
+        __atomic_store_n(&_head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&_tail, 0, __ATOMIC_RELEASE);
+    }
+
+    unsigned capacity() const
+    {
+        return _capacity;
+    }
+
+    unsigned slots() const
+    {
+        return _mask + 1;
+    }
+
+    // Number of queued elements. Exact for the consumer,
+    //  a lower bound of the free space for the producer.
+    int size() const
+    {
+        unsigned tail = loadTail();
+        return loadHead() - tail;
+    }
+
+    //---------------------------------------------------
+    //   producer side
+    //---------------------------------------------------
+
+    bool full() const
+    {
+        return _head - loadTail() >= _capacity;
+    }
+
+    // Slot to fill before calling push().
+    unsigned writeIndex() const
+    {
+        return _head & _mask;
+    }
+
+    void push()
+    {
+        __atomic_store_n(&_head, _head + 1, __ATOMIC_RELEASE);
+    }
+
+    //---------------------------------------------------
+    //   consumer side
+    //---------------------------------------------------
+
+    bool empty() const
+    {
+        return loadHead() == _tail;
+    }
+
+    // Slot of the n'th queued element, n < size().
+    unsigned readIndex(unsigned n = 0) const
+    {
+        return (_tail + n) & _mask;
+    }
+
+    void pop()
+    {
+        __atomic_store_n(&_tail, _tail + 1, __ATOMIC_RELEASE);
+    }
+};
+
+#endif
@@ -232,6 +232,35 @@ void MidiSyncInfo::setTime()
 	}
 }
 
+//---------------------------------------------------------
+//  clearDetect
+//    drop all detect indicators at once, when the port
+//    loses its device
+//---------------------------------------------------------
+
+void MidiSyncInfo::clearDetect()
+{
+	_clockTrig = false;
+	_tickTrig = false;
+	_MRTTrig = false;
+	_MMCTrig = false;
+	_MTCTrig = false;
+	_clockDetect = false;
+	_tickDetect = false;
+	_MRTDetect = false;
+	_MMCDetect = false;
+	_MTCDetect = false;
+	for (int i = 0; i < MIDI_CHANNELS; i++)
+	{
+		_actTrig[i] = false;
+		_actDetect[i] = false;
+	}
+	_actDetectBits = 0;
+	// Give up the current midi sync in port number if we took it...
+	if (_port != -1 && curMidiSyncInPort == _port)
+		curMidiSyncInPort = -1;
+}
+
 //---------------------------------------------------------
 //  setMCIn
 //---------------------------------------------------------
@@ -733,7 +762,7 @@ void MidiSeq::setSongPosition(int port, int midiBeat)
 		return;
 
 	// Re-transmit song position to other devices if clock out turned on.
-	for (int p = 0; p < MIDI_PORTS; ++p)
+	for (int p = nextActiveMidiPort(0); p < MIDI_PORTS; p = nextActiveMidiPort(p + 1))
 		if (p != port && midiPorts[p].syncInfo().MRTOut())
 			midiPorts[p].sendSongpos(midiBeat);
 
@@ -841,7 +870,7 @@ void MidiSeq::realtimeSystemInput(int port, int c)
 			// Would re-transmit mixture of multiple clocks - confusing receivers.
 			// Solution: Added curMidiSyncInPort.
 			// Maybe in MidiSeq::processTimerTick(), call sendClock for the other devices, instead of here.
-			for (int p = 0; p < MIDI_PORTS; ++p)
+			for (int p = nextActiveMidiPort(0); p < MIDI_PORTS; p = nextActiveMidiPort(p + 1))
 				if (p != port && midiPorts[p].syncInfo().MCOut())
 					midiPorts[p].sendClock();
 
@@ -877,7 +906,7 @@ void MidiSeq::realtimeSystemInput(int port, int c)
 			break;
 		case ME_START: // start
 			// Re-transmit start to other devices if clock out turned on.
-			for (int p = 0; p < MIDI_PORTS; ++p)
+			for (int p = nextActiveMidiPort(0); p < MIDI_PORTS; p = nextActiveMidiPort(p + 1))
 			{
 				if (p != port && midiPorts[p].syncInfo().MRTOut())
 				{
@@ -919,7 +948,7 @@ void MidiSeq::realtimeSystemInput(int port, int c)
 			break;
 		case ME_CONTINUE: // continue
 			// Re-transmit continue to other devices if clock out turned on.
-			for (int p = 0; p < MIDI_PORTS; ++p)
+			for (int p = nextActiveMidiPort(0); p < MIDI_PORTS; p = nextActiveMidiPort(p + 1))
 				if (p != port && midiPorts[p].syncInfo().MRTOut())
 					midiPorts[p].sendContinue();
 
@@ -942,7 +971,7 @@ void MidiSeq::realtimeSystemInput(int port, int c)
 			playPendingFirstClock = false;
 
 			// Re-transmit stop to other devices if clock out turned on.
-			for (int p = 0; p < MIDI_PORTS; ++p)
+			for (int p = nextActiveMidiPort(0); p < MIDI_PORTS; p = nextActiveMidiPort(p + 1))
 				if (p != port && midiPorts[p].syncInfo().MRTOut())
 					midiPorts[p].sendStop();
 
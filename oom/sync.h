@@ -148,6 +148,7 @@ public:
     void setMTCIn(const bool v);
 
     void setTime();
+    void clearDetect();
 
     bool recRewOnStart() const {
         return _recRewOnStart;
@@ -909,8 +909,17 @@ void MessSynthIF::populatePatchModel(QStandardItemModel* model, int ch, MType, b
 void SynthI::preProcessAlways()
 {
 	if (_sif)
+	{
 		_sif->preProcessAlways();
-	_processed = false;
+		// Events the synth sends to the host (controllers moved in
+		//  its gui, sysex) come in like the input of a midi device.
+		while (_sif->eventsPending())
+		{
+			MidiRecordEvent ev(_sif->receiveEvent());
+			if (!off())
+				recordEvent(ev);
+		}
+	}
 	if(off())
 	{
 	    // Clear any accumulated play events.
@@ -949,66 +958,42 @@ bool SynthI::getData(unsigned pos, int ports, unsigned n, float** buffer)
 	return true;
 }
 
+//---------------------------------------------------------
+//   getData
+//    Renders the period in sub-blocks which end at the
+//    frame of the next event, so every event takes effect
+//    at its own frame. Events of later periods and events
+//    the synth is too busy for stay in the list.
+//---------------------------------------------------------
+
 iMPEvent MessSynthIF::getData(MidiPort* mp, MPEventList* el, iMPEvent i, unsigned pos, int /*ports*/, unsigned n, float** buffer)
 {
-	//prevent compiler warning: comparison of signed/unsigned
-	unsigned int curPos = pos;
-	unsigned int endPos = pos + n;
-	int off = pos;
+	if (!_mess)
+	{
+		printf("should not happen - no _mess\n");
+		return i;
+	}
+	unsigned curPos = 0; // offset into the period
 	int frameOffset = audio->getFrameOffset();
 
 	for (; i != el->end(); ++i)
 	{
-		int evTime = i->time();
-		if (evTime == 0)
-		{
-			//      printf("MessSynthIF::getData - time is 0!\n");
-			//      continue;
-			evTime = frameOffset; // will cause frame to be zero, problem?
-		}
-		unsigned int frame = evTime - frameOffset;
-
-		//TODO           if (frame > 0) // robert: ugly fix, don't really know what is going on here
-		//                          // makes PPC work much better.
-
-		if (frame >= endPos)
-		{
-			printf("frame > endPos!! frame = %d >= endPos %d, i->time() %d, frameOffset %d curPos=%d\n", frame, endPos, i->time(), frameOffset, curPos);
-			continue;
-		}
-
-		if (frame > curPos)
+		// frame within the period, late events play at once
+		int frame = int(i->time()) - frameOffset - int(pos);
+		if (frame < 0)
+			frame = 0;
+		if (unsigned(frame) >= n)
+			break;
+		if (unsigned(frame) > curPos)
 		{
-			if (frame < pos)
-				printf("should not happen: missed event %d\n", pos - frame);
-			else
-			{
-				if (!_mess)
-					printf("should not happen - no _mess\n");
-				else
-				{
-					_mess->process(buffer, curPos - pos, frame - curPos);
-				}
-			}
+			_mess->process(buffer, curPos, frame - curPos);
 			curPos = frame;
 		}
-		if (mp)
-			mp->sendEvent(*i);
-		else
-		{
-			if (putEvent(*i))
-				break;
-		}
-	}
-	if (endPos - curPos)
-	{
-		if (!_mess)
-			printf("should not happen - no _mess\n");
-		else
-		{
-			_mess->process(buffer, curPos - off, endPos - curPos);
-		}
+		if (mp ? mp->sendEvent(*i) : putEvent(*i))
+			break;
 	}
+	if (curPos < n)
+		_mess->process(buffer, curPos, n - curPos);
 	return i;
 }
 
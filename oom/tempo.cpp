@@ -17,6 +17,116 @@
 
 TempoList tempomap;
 
+//---------------------------------------------------------
+//   findTick
+//    index of the segment containing tick, -1 if none
+//---------------------------------------------------------
+
+static int findTick(const TempoTable* t, unsigned tick, TempoCursor* c)
+{
+	const TempoSegment* s = &t->segments[0];
+	int n = t->segments.size();
+	if (c)
+	{
+		int i = c->segment;
+		if (i < n && tick >= s[i].tick && tick < s[i].endTick)
+			return i;
+		++i;
+		if (i < n && tick >= s[i].tick && tick < s[i].endTick)
+		{
+			c->segment = i;
+			return i;
+		}
+	}
+	// first segment ending after tick
+	int lo = 0;
+	int hi = n;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (s[mid].endTick > tick)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	if (lo == n)
+		return -1;
+	if (c)
+		c->segment = lo;
+	return lo;
+}
+
+//---------------------------------------------------------
+//   findFrame
+//    index of the last segment starting at or before frame
+//---------------------------------------------------------
+
+static int findFrame(const TempoTable* t, unsigned frame, TempoCursor* c)
+{
+	const TempoSegment* s = &t->segments[0];
+	int n = t->segments.size();
+	if (c)
+	{
+		int i = c->segment;
+		if (i < n && frame >= s[i].frame && (i + 1 == n || frame < s[i + 1].frame))
+			return i;
+		++i;
+		if (i < n && frame >= s[i].frame && (i + 1 == n || frame < s[i + 1].frame))
+		{
+			c->segment = i;
+			return i;
+		}
+	}
+	// first segment starting after frame
+	int lo = 0;
+	int hi = n;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (s[mid].frame > frame)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	int i = lo ? lo - 1 : 0;
+	if (c)
+		c->segment = i;
+	return i;
+}
+
+//---------------------------------------------------------
+//   tableTick2frame
+//---------------------------------------------------------
+
+static unsigned tableTick2frame(const TempoTable* t, unsigned tick, TempoCursor* c)
+{
+	int i = findTick(t, tick, c);
+	if (i < 0)
+	{
+		if(debugMsg)
+			printf("tick2frame(%d,0x%x): not found\n", tick, tick);
+		return 0;
+	}
+	// same arithmetic as TempoList::tick2frame(), so both give the same result
+	const TempoSegment& s = t->segments[i];
+	unsigned dtick = tick - s.tick;
+	double dtime = double(dtick) / s.ticksPerSec;
+	unsigned dframe = lrint(dtime * t->sampleRate);
+	return s.frame + dframe;
+}
+
+//---------------------------------------------------------
+//   tableFrame2tick
+//---------------------------------------------------------
+
+static unsigned tableFrame2tick(const TempoTable* t, unsigned frame, TempoCursor* c)
+{
+	const TempoSegment& s = t->segments[findFrame(t, frame, c)];
+	int dframe = frame - s.frame;
+	double dtime = double(dframe) / double(t->sampleRate);
+	return s.tick + lrint(dtime * t->globalTempo * t->division * 10000.0 / s.tempo);
+}
+
 //---------------------------------------------------------
 //   TempoList
 //---------------------------------------------------------
@@ -28,6 +138,9 @@ TempoList::TempoList()
 	_tempoSN = 1;
 	_globalTempo = 100;
 	useList = true;
+	_tableSN = 0;
+	_table = 0;
+	_tableReaders = 0;
 }
 
 //---------------------------------------------------------
@@ -67,8 +180,84 @@ void TempoList::normalize()
 		double dtime = double(dtick) / (config.division * _globalTempo * 10000.0 / e->second->tempo);
 		frame += lrint(dtime * sampleRate);
 	}
+	__atomic_add_fetch(&_tableSN, 1, __ATOMIC_RELEASE);
 }
 
+//---------------------------------------------------------
+//   TempoList::updateTable
+//    Build a new lookup table if the list has changed since
+//    the last one. Called from the gui thread, which is the
+//    only one that changes _table, while the audio thread
+//    does not change the list (it does so only in a message
+//    the gui thread waits for).
+//---------------------------------------------------------
+
+void TempoList::updateTable()
+{
+	int sn = __atomic_load_n(&_tableSN, __ATOMIC_ACQUIRE);
+	TempoTable* cur = _table;
+	if (cur == 0 || cur->serial != sn || cur->sampleRate != sampleRate || cur->division != config.division || cur->globalTempo != _globalTempo)
+	{
+		TempoTable* t = new TempoTable;
+		t->serial = sn;
+		t->sampleRate = sampleRate;
+		t->division = config.division;
+		t->globalTempo = _globalTempo;
+		t->segments.resize(size());
+		int n = 0;
+		for (ciTEvent e = begin(); e != end(); ++e, ++n)
+		{
+			TempoSegment& s = t->segments[n];
+			s.tick = e->second->tick;
+			s.endTick = e->first;
+			s.frame = e->second->frame;
+			s.tempo = e->second->tempo;
+			s.ticksPerSec = config.division * _globalTempo * 10000.0 / e->second->tempo;
+		}
+		cur = __atomic_exchange_n(&_table, t, __ATOMIC_SEQ_CST);
+		if (cur)
+			_retiredTables.push_back(cur);
+	}
+	// A reader which comes after the swap gets the new table, so
+	//  once the count is seen at zero the old ones are unused.
+	if (!_retiredTables.empty() && __atomic_load_n(&_tableReaders, __ATOMIC_SEQ_CST) == 0)
+	{
+		for (std::vector<TempoTable*>::iterator i = _retiredTables.begin(); i != _retiredTables.end(); ++i)
+			delete *i;
+		_retiredTables.clear();
+	}
+}
+
+//---------------------------------------------------------
+//   TempoList::TableRef
+//    holds the lookup table while in scope, table is 0
+//    if it is stale or not built yet
+//---------------------------------------------------------
+
+class TempoList::TableRef
+{
+	const TempoList* _list;
+
+public:
+	const TempoTable* table;
+
+	TableRef(const TempoList* list)
+	{
+		_list = list;
+		__atomic_add_fetch(&_list->_tableReaders, 1, __ATOMIC_SEQ_CST);
+		const TempoTable* t = __atomic_load_n(&_list->_table, __ATOMIC_SEQ_CST);
+		if (!_list->useList || t == 0 || t->serial != __atomic_load_n(&_list->_tableSN, __ATOMIC_ACQUIRE)
+				|| t->sampleRate != sampleRate || t->division != config.division || t->globalTempo != _list->_globalTempo)
+			t = 0;
+		table = t;
+	}
+
+	~TableRef()
+	{
+		__atomic_sub_fetch(&_list->_tableReaders, 1, __ATOMIC_RELEASE);
+	}
+};
+
 //---------------------------------------------------------
 //   TempoList::dump
 //---------------------------------------------------------
@@ -94,6 +283,7 @@ void TempoList::clear()
 		delete i->second;
 	TEMPOLIST::clear();
 	insert(std::pair<const unsigned, TEvent*> (MAX_TICK + 1, new TEvent(500000, 0)));
+	normalize();
 	++_tempoSN;
 }
 
@@ -102,9 +292,23 @@ void TempoList::clear()
 //---------------------------------------------------------
 
 int TempoList::tempo(unsigned tick) const
+{
+	TempoCursor c;
+	return tempo(tick, c);
+}
+
+int TempoList::tempo(unsigned tick, TempoCursor& c) const
 {
 	if (useList)
 	{
+		TableRef ref(this);
+		const TempoTable* t = ref.table;
+		if (t)
+		{
+			int i = findTick(t, tick, &c);
+			if (i >= 0)
+				return t->segments[i].tempo;
+		}
 		ciTEvent i = upper_bound(tick);
 		if (i == end())
 		{
@@ -272,7 +476,11 @@ unsigned TempoList::tick2frame(unsigned tick, unsigned frame, int* sn) const
 unsigned TempoList::tick2frame(unsigned tick, int* sn) const
 {
 	int f;
-	if (useList)
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t)
+		f = tableTick2frame(t, tick, 0);
+	else if (useList)
 	{
 		ciTEvent i = upper_bound(tick);
 		if (i == end())
@@ -314,7 +522,11 @@ unsigned TempoList::frame2tick(unsigned frame, unsigned t, int* sn) const
 unsigned TempoList::frame2tick(unsigned frame, int* sn) const
 {
 	unsigned tick;
-	if (useList)
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t)
+		tick = tableFrame2tick(t, frame, 0);
+	else if (useList)
 	{
 		ciTEvent e;
 		for (e = begin(); e != end();)
@@ -346,7 +558,14 @@ unsigned TempoList::frame2tick(unsigned frame, int* sn) const
 unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) const
 {
 	int f1, f2;
-	if (useList)
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t)
+	{
+		f1 = tableTick2frame(t, tick1, 0);
+		f2 = tableTick2frame(t, tick2, 0);
+	}
+	else if (useList)
 	{
 		ciTEvent i = upper_bound(tick1);
 		if (i == end())
@@ -394,7 +613,14 @@ unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) con
 unsigned TempoList::deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn) const
 {
 	unsigned tick1, tick2;
-	if (useList)
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t)
+	{
+		tick1 = tableFrame2tick(t, frame1, 0);
+		tick2 = tableFrame2tick(t, frame2, 0);
+	}
+	else if (useList)
 	{
 		ciTEvent e;
 		for (e = begin(); e != end();)
@@ -439,6 +665,69 @@ unsigned TempoList::deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn) c
 	return tick2 - tick1;
 }
 
+//---------------------------------------------------------
+//   tick2frame
+//    cursor version, for the play loop
+//---------------------------------------------------------
+
+unsigned TempoList::tick2frame(unsigned tick, TempoCursor& c) const
+{
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t == 0)
+		return tick2frame(tick);
+	return tableTick2frame(t, tick, &c);
+}
+
+//---------------------------------------------------------
+//   frame2tick
+//    cursor version
+//---------------------------------------------------------
+
+unsigned TempoList::frame2tick(unsigned frame, TempoCursor& c) const
+{
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t == 0)
+		return frame2tick(frame);
+	return tableFrame2tick(t, frame, &c);
+}
+
+//---------------------------------------------------------
+//   deltaTick2frame
+//    cursor version, for drawing
+//---------------------------------------------------------
+
+unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, TempoCursor& c) const
+{
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t == 0)
+		return deltaTick2frame(tick1, tick2);
+	unsigned f1 = tableTick2frame(t, tick1, &c);
+	unsigned f2 = tableTick2frame(t, tick2, &c);
+	return f2 - f1;
+}
+
+//---------------------------------------------------------
+//   ticks2frames
+//---------------------------------------------------------
+
+void TempoList::ticks2frames(const unsigned* ticks, unsigned* frames, int n) const
+{
+	TableRef ref(this);
+	const TempoTable* t = ref.table;
+	if (t == 0)
+	{
+		for (int i = 0; i < n; ++i)
+			frames[i] = tick2frame(ticks[i]);
+		return;
+	}
+	TempoCursor c;
+	for (int i = 0; i < n; ++i)
+		frames[i] = tableTick2frame(t, ticks[i], &c);
+}
+
 //---------------------------------------------------------
 //   TempoList::write
 //---------------------------------------------------------
@@ -491,6 +780,7 @@ void TempoList::read(Xml& xml)
 				if (tag == "tempolist")
 				{
 					normalize();
+					updateTable();
 					++_tempoSN;
 					return;
 				}
@@ -10,6 +10,7 @@
 #define __TEMPO_H__
 
 #include <map>
+#include <vector>
 
 #ifndef MAX_TICK
 #define MAX_TICK (0x7fffffff/100)
@@ -42,6 +43,52 @@ struct TEvent
     }
 };
 
+//---------------------------------------------------------
+//   TempoSegment
+//    one entry of the TempoList
+//---------------------------------------------------------
+
+struct TempoSegment
+{
+    unsigned tick; // first tick
+    unsigned endTick; // first tick of the next segment
+    unsigned frame; // frame at tick
+    int tempo;
+    double ticksPerSec;
+};
+
+//---------------------------------------------------------
+//   TempoTable
+//    the TempoList as a sorted array, built by
+//    TempoList::updateTable() and not changed after
+//---------------------------------------------------------
+
+struct TempoTable
+{
+    std::vector<TempoSegment> segments;
+    int serial; // values the table was built with
+    int sampleRate;
+    int division;
+    int globalTempo;
+};
+
+//---------------------------------------------------------
+//   TempoCursor
+//    remembers the segment of the last lookup, so that
+//    a series of nearby or increasing lookups does not
+//    have to search the table each time
+//---------------------------------------------------------
+
+struct TempoCursor
+{
+    int segment;
+
+    TempoCursor()
+    {
+        segment = 0;
+    }
+};
+
 //---------------------------------------------------------
 //   TempoList
 //---------------------------------------------------------
@@ -59,6 +106,17 @@ class TempoList : public TEMPOLIST
     int _tempo; // tempo if not using tempo list
     int _globalTempo; // %percent 50-200%
 
+    // Lookup table for the conversions. normalize() only marks it
+    //  stale (the list may be changed in the audio thread), the gui
+    //  thread builds a new one and swaps it in. A replaced table is
+    //  freed once no reader holds it.
+    class TableRef;
+    friend class TableRef;
+    int _tableSN; // bumped by normalize()
+    TempoTable* _table; // 0 until the first updateTable()
+    mutable int _tableReaders;
+    std::vector<TempoTable*> _retiredTables;
+
     void normalize();
     void add(unsigned tick, int tempo);
     void change(unsigned tick, int newTempo);
@@ -81,6 +139,17 @@ public:
     unsigned deltaTick2frame(unsigned tick1, unsigned tick2, int* sn = 0) const;
     unsigned deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn = 0) const;
 
+    // same as above, starting the search at the cursor's segment
+    int tempo(unsigned tick, TempoCursor&) const;
+    unsigned tick2frame(unsigned tick, TempoCursor&) const;
+    unsigned frame2tick(unsigned frame, TempoCursor&) const;
+    unsigned deltaTick2frame(unsigned tick1, unsigned tick2, TempoCursor&) const;
+    // converts n ticks, fastest if they are sorted
+    void ticks2frames(const unsigned* ticks, unsigned* frames, int n) const;
+
+    // called from the gui thread
+    void updateTable();
+
     int tempoSN() const
     {
         return _tempoSN;
@@ -23,6 +23,7 @@
 #include "route.h"
 #include "midimonitor.h"
 #include "ccinfo.h"
+#include "playbacksnapshot.h"
 
 unsigned int Track::_soloRefCnt = 0;
 Track* Track::_tmpSoloChainTrack = 0;
@@ -604,6 +605,8 @@ MidiTrack::MidiTrack()
 	init();
 	_events = new EventList;
 	_mpevents = new MPEventList;
+	playSnapshot = 0;
+	editSerial = 0;
 }
 
 //MidiTrack::MidiTrack(const MidiTrack& mt)
@@ -626,12 +629,15 @@ MidiTrack::MidiTrack(const MidiTrack& mt, bool cloneParts)
 	len = mt.len;
 	compression = mt.compression;
 	_recEcho = mt.recEcho();
+	playSnapshot = 0;
+	editSerial = 0;
 }
 
 MidiTrack::~MidiTrack()
 {
 	delete _events;
 	delete _mpevents;
+	delete playSnapshot;
 	if(_wantsAutomation)
 	{
     	if (_outPort >= 0 && _outPort < MIDI_PORTS)
@@ -658,6 +664,7 @@ void MidiTrack::init()
 {
 	_outPort = 0;
 	_outChannel = 0;
+	midiPorts[0].addManagedControllers();
 
 	transposition = 0;
 	velocity = 0;
@@ -708,6 +715,7 @@ void MidiTrack::setOutPort(int i)
 		_outPortId = mp->id();
     if (i >= 0 && i < MIDI_PORTS)
     {
+        midiPorts[i].addManagedControllers();
         _wantsAutomation = (midiPorts[i].device() && midiPorts[i].device()->isSynthPlugin());
         if (_wantsAutomation)
             ((SynthPluginDevice*)midiPorts[i].device())->setTrackId(m_id);
@@ -722,6 +730,7 @@ void MidiTrack::setOutPortId(qint64 i)
 	{
 		MidiPort* mp = oomMidiPorts.value(i);
 		_outPort = mp->portno();
+		mp->addManagedControllers();
 		_wantsAutomation = (mp->device() && mp->device()->isSynthPlugin());
         if (_wantsAutomation)
             ((SynthPluginDevice*)mp->device())->setTrackId(m_id);
@@ -750,6 +759,7 @@ void MidiTrack::setOutPortAndUpdate(int i)/*{{{*/
 {
     if (i >= 0 && i < MIDI_PORTS)
     {
+        midiPorts[i].addManagedControllers();
         _wantsAutomation = (midiPorts[i].device() && midiPorts[i].device()->isSynthPlugin());
         if (_wantsAutomation)
             ((SynthPluginDevice*)midiPorts[i].device())->setTrackId(m_id);
@@ -772,6 +782,7 @@ void MidiTrack::setOutPortIdAndUpdate(qint64 i)/*{{{*/
 	{
 		MidiPort* mp = oomMidiPorts.value(i);
 		_outPort = mp->portno();
+		mp->addManagedControllers();
 		_wantsAutomation = (mp->device() && mp->device()->isSynthPlugin());
 	}
 
@@ -9,6 +9,7 @@
 #ifndef __TRACK_H__
 #define __TRACK_H__
 
+#include <pthread.h>
 #include <QString>
 #include <QHash>
 #include <QPair>
@@ -490,11 +491,45 @@ public:
     }
 };
 
+// Overlapping parts a MidiPlayCursor can follow at once
+#define PLAY_CURSOR_PARTS 32
+
+//---------------------------------------------------------
+//   MidiPlayCursor
+//    playback position of a midi track, kept by
+//    Audio::collectEvents() from one cycle to the next.
+//    Only used in the audio thread.
+//---------------------------------------------------------
+
+struct MidiPlayCursor
+{
+    struct Active
+    {
+        Part* part;
+        iEvent event; // next event to play
+    };
+
+    bool valid;
+    unsigned tick; // end of the last collected segment
+    unsigned serial; // Audio::_playCursorSerial when started
+    int delay; // track delay when started
+    iPart nextPart; // first part not started yet
+    Active active[PLAY_CURSOR_PARTS];
+    int nactive;
+
+    MidiPlayCursor()
+    {
+        valid = false;
+        nactive = 0;
+    }
+};
+
 //---------------------------------------------------------
 //   MidiTrack
 //---------------------------------------------------------
 
 class AudioTrack;
+class MidiPlaySnapshot;
 
 class MidiTrack : public Track
 {
@@ -523,6 +558,13 @@ public:
     int delay;
     int len;
     int compression;
+    MidiPlayCursor playCursor;
+    // Compiled events, see playbacksnapshot.h. Set by the audio
+    //  thread, the gui thread only reads it.
+    MidiPlaySnapshot* playSnapshot;
+    // Bumped by the audio thread when parts or events of the track
+    //  change, see Audio::markEdited().
+    unsigned editSerial;
 
 	int getTransposition();
 	QList<MonitorLog> getMonitorBuffer(int ctrl)
@@ -656,6 +698,8 @@ class AudioTrack : public Track
 
 	QHash<int, qint64> m_auxControlList;
     void readAuxSend(Xml& xml);
+    bool gainRamp(unsigned pos, unsigned n, float* g0, float* g1, float* vol);
+    void applyGainRamp(float** src, int srcChans, float** dst, int dstChannels, float** ramp, float* vol, unsigned n, bool add);
 
 protected:
     float** outBuffers;
@@ -666,7 +710,17 @@ protected:
     virtual bool getData(unsigned, int, unsigned, float**);
     SndFile* _recFile;
     Fifo fifo; // fifo -> _recFile
-    bool _processed;
+
+    // A track is processed if _processedCycle matches the current cycle,
+    //  so nothing needs to be reset at the start of each cycle.
+    static unsigned _processCycle;
+    unsigned _processedCycle;
+    bool _directBuffer; // see Audio::updateTopology()
+
+    // post-effect data rendered ahead by preRender(), consumed by copyData/addData
+    unsigned _preRenderCycle;
+    bool _preRenderOk;
+    float* _preBuffer[MAX_CHANNELS];
 
 public:
     AudioTrack(TrackType t);
@@ -680,7 +734,17 @@ public:
 
     bool processed()
     {
-        return _processed;
+        return _processedCycle == _processCycle;
+    }
+
+    static void nextProcessCycle()
+    {
+        ++_processCycle;
+    }
+
+    void setDirectBuffer(bool v)
+    {
+        _directBuffer = v;
     }
 
 	QHash<int, qint64>* auxControlList()
@@ -793,8 +857,16 @@ public:
 
     virtual void preProcessAlways()
     {
-        _processed = false;
     }
+    virtual bool preRenderable()
+    {
+        return false;
+    }
+    virtual bool canPreRender()
+    {
+        return false;
+    }
+    void preRender(unsigned /*samplePos*/, unsigned /*frames*/);
     virtual void addData(unsigned /*samplePos*/, int /*channels*/, int /*srcStartChan*/, int /*srcChannels*/, unsigned /*frames*/, float** /*buffer*/);
     virtual void copyData(unsigned /*samplePos*/, int /*channels*/, int /*srcStartChan*/, int /*srcChannels*/, unsigned /*frames*/, float** /*buffer*/);
 
@@ -1074,23 +1146,65 @@ public:
 //   WaveTrack
 //---------------------------------------------------------
 
+class WavePartIndex;
+struct WavePartSpan;
+
 class WaveTrack : public AudioTrack
 {
     Fifo _prefetchFifo; // prefetch Fifo
 	AudioInput* _input;
 	AudioOutput* _output;
 
+    // prefetch state, only used by AudioPrefetch
+    unsigned _prefetchPos; // next frame to read, ~0 = not positioned
+    bool _prefetchSeek; // seek before the next read
+    bool _prefetchQueued; // a refill is queued or running
+    // Held around fetchData(), by a prefetch reader or, in freewheel
+    //  mode, by the audio thread. They must not read the same
+    //  files at the same time.
+    pthread_mutex_t _fetchLock;
+
+    // the parts by position and z order, see updatePartIndex()
+    WavePartIndex* _partIndex;
+    unsigned _partSerial; // bumped by partsChanged()
+    int _partIndexReaders; // fetchData() calls using _partIndex
+    std::vector<WavePartIndex*> _retiredPartIndex; // gui thread only
+    // fetchData() scratch, under _fetchLock. Grown by the gui thread.
+    std::vector<const WavePartSpan*> _fetchSpans;
+    std::vector<WavePart*> _fetchParts;
+    unsigned _fetchCapacity;
+
 public:
     static bool firstWaveTrack;
 
     WaveTrack() : AudioTrack(Track::WAVE)
     {
+        _prefetchPos = ~0;
+        _prefetchSeek = false;
+        _prefetchQueued = false;
+        pthread_mutex_init(&_fetchLock, 0);
+        _partIndex = 0;
+        _partSerial = 0;
+        _partIndexReaders = 0;
+        _fetchCapacity = 0;
     }
 
     WaveTrack(const WaveTrack& wt, bool cloneParts) : AudioTrack(wt, cloneParts)
     {
+        _prefetchPos = ~0;
+        _prefetchSeek = false;
+        _prefetchQueued = false;
+        pthread_mutex_init(&_fetchLock, 0);
+        _partIndex = 0;
+        _partSerial = 0;
+        _partIndexReaders = 0;
+        _fetchCapacity = 0;
+        updatePartIndex();
     }
 
+    virtual ~WaveTrack();
+    virtual WaveTrack& operator=(const Track& t);
+
     virtual WaveTrack* clone(bool cloneParts) const
     {
         return new WaveTrack(*this, cloneParts);
@@ -1107,7 +1221,19 @@ public:
 
     virtual void fetchData(unsigned pos, unsigned frames, float** bp, bool doSeek);
 
+    void lockFetch()
+    {
+        pthread_mutex_lock(&_fetchLock);
+    }
+
+    void unlockFetch()
+    {
+        pthread_mutex_unlock(&_fetchLock);
+    }
+
     virtual bool getData(unsigned, int ch, unsigned, float** bp);
+    virtual bool preRenderable();
+    virtual bool canPreRender();
 
     void clearPrefetchFifo()
     {
@@ -1118,6 +1244,32 @@ public:
     {
         return &_prefetchFifo;
     }
+
+    unsigned prefetchPos() const
+    {
+        return _prefetchPos;
+    }
+
+    void setPrefetchPos(unsigned pos, bool seek = false)
+    {
+        _prefetchPos = pos;
+        _prefetchSeek = seek;
+    }
+
+    bool prefetchSeek() const
+    {
+        return _prefetchSeek;
+    }
+
+    bool prefetchQueued() const
+    {
+        return _prefetchQueued;
+    }
+
+    void setPrefetchQueued(bool f)
+    {
+        _prefetchQueued = f;
+    }
     virtual void setChannels(int n);
 
     virtual bool hasAuxSend() const
@@ -1148,13 +1300,15 @@ public:
 		return _input;
 	}
 
+	void partsChanged();
+	void updatePartIndex();
 	void calculateCrossFades();
 
 	bool leftEdgeOnTopOfPartBelow(WavePart* topPart, WavePart* bottomPart);
 	bool rightEdgeOnTopOfPartBelow(WavePart* topPart, WavePart* bottomPart);
 	bool leftAndRightEdgeOnTopOfPartBelow(WavePart* topPart, WavePart* bottomPart);
-	QList<WavePart*> partsBelowLeftEdge(WavePart* part);
-	QList<WavePart*> partsBelowRightEdge(WavePart* part);
+	QList<WavePart*> partsBelowLeftEdge(const WavePartIndex&, WavePart* part);
+	QList<WavePart*> partsBelowRightEdge(const WavePartIndex&, WavePart* part);
 };
 
 //---------------------------------------------------------
@@ -9,6 +9,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cmath>
 
 #include <QDateTime>
@@ -27,7 +31,9 @@
 #include "event.h"
 #include "audio.h"
 ///#include "sig.h"
+#include "al/dsp.h"
 #include "al/sig.h"
+#include "clipcache.h"
 
 //#define WAVE_DEBUG
 //#define WAVE_DEBUG_PRC
@@ -59,6 +65,16 @@ SndFile::SndFile(const QString& name)
 	csize = 0;
 	cache = 0;
 	openFlag = false;
+	for (int i = 0; i < SNDFILE_CURSORS; ++i)
+	{
+		cursors[i].sf = 0;
+		cursors[i].pos = -1;
+		cursors[i].busy = 0;
+	}
+	mapBase = 0;
+	mapSize = 0;
+	mapData = 0;
+	cachePinned = false;
 	sndFiles.push_back(this);
 	refCount = 0;
 }
@@ -106,6 +122,7 @@ bool SndFile::openRead()
 
 	writeFlag = false;
 	openFlag = true;
+	mapFile();
 	QString cacheName = finfo->absolutePath() + QString("/") + finfo->completeBaseName() + QString(".wca");
 	readCache(cacheName, true);
 	return false;
@@ -401,12 +418,282 @@ void SndFile::close()
 		printf("SndFile:: alread closed\n");
 		return;
 	}
+	clipCache.remove(this);
+	closeCursors();
+	unmapFile();
 	sf_close(sf);
 	if (sfUI)
 		sf_close(sfUI);
 	openFlag = false;
 }
 
+//---------------------------------------------------------
+//   closeCursors
+//    only while no one reads
+//---------------------------------------------------------
+
+void SndFile::closeCursors()
+{
+	for (int i = 0; i < SNDFILE_CURSORS; ++i)
+	{
+		if (cursors[i].sf)
+			sf_close(cursors[i].sf);
+		cursors[i].sf = 0;
+		cursors[i].pos = -1;
+	}
+}
+
+// Read ahead window of the memory mapped files.
+#define MAP_AHEAD_SHIFT 18
+
+static inline unsigned le32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (unsigned(p[3]) << 24);
+}
+
+static inline unsigned be32(const unsigned char* p)
+{
+	return (unsigned(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline uint64_t le64(const unsigned char* p)
+{
+	return le32(p) | (uint64_t(le32(p + 4)) << 32);
+}
+
+//---------------------------------------------------------
+//   findPcmData
+//    offset of the sample data in a wav, w64 or aiff
+//    file, -1 if not found or not plain pcm
+//---------------------------------------------------------
+
+static int64_t findPcmData(const unsigned char* p, uint64_t size, int major, bool* bigEndian)
+{
+	*bigEndian = false;
+	switch (major)
+	{
+		case SF_FORMAT_WAV:
+		case SF_FORMAT_WAVEX:
+			if (size < 12 || memcmp(p, "RIFF", 4) || memcmp(p + 8, "WAVE", 4))
+				return -1;
+			for (uint64_t pos = 12; pos + 8 <= size;)
+			{
+				uint64_t len = le32(p + pos + 4);
+				if (!memcmp(p + pos, "data", 4))
+					return pos + 8;
+				pos += 8 + len + (len & 1);
+			}
+			break;
+		case SF_FORMAT_W64:
+		{
+			static const unsigned char dataGuid[16] = {
+				'd', 'a', 't', 'a', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+			};
+			if (size < 40 || memcmp(p, "riff", 4))
+				return -1;
+			for (uint64_t pos = 40; pos + 24 <= size;)
+			{
+				// the chunk size includes the guid and the size
+				uint64_t len = le64(p + pos + 16);
+				if (!memcmp(p + pos, dataGuid, 16))
+					return pos + 24;
+				if (len < 24)
+					return -1;
+				pos += (len + 7) & ~uint64_t(7);
+			}
+			break;
+		}
+		case SF_FORMAT_AIFF:
+		{
+			if (size < 12 || memcmp(p, "FORM", 4))
+				return -1;
+			bool aifc = !memcmp(p + 8, "AIFC", 4);
+			if (!aifc && memcmp(p + 8, "AIFF", 4))
+				return -1;
+			*bigEndian = true;
+			int64_t data = -1;
+			for (uint64_t pos = 12; pos + 8 <= size;)
+			{
+				uint64_t len = be32(p + pos + 4);
+				if (!memcmp(p + pos, "SSND", 4) && pos + 16 <= size)
+					data = pos + 16 + be32(p + pos + 8);
+				else if (aifc && !memcmp(p + pos, "COMM", 4) && pos + 30 <= size)
+				{
+					const unsigned char* type = p + pos + 26;
+					if (!memcmp(type, "sowt", 4))
+						*bigEndian = false;
+					else if (memcmp(type, "NONE", 4) && memcmp(type, "fl32", 4) && memcmp(type, "FL32", 4))
+						return -1;
+				}
+				pos += 8 + len + (len & 1);
+			}
+			return data;
+		}
+	}
+	return -1;
+}
+
+//---------------------------------------------------------
+//   mapFile
+//    Map plain pcm and float files into memory, readAt()
+//    then converts the samples right from the mapped
+//    pages. Everything else is read by libsndfile.
+//---------------------------------------------------------
+
+void SndFile::mapFile()
+{
+	int major = sfinfo.format & SF_FORMAT_TYPEMASK;
+	if (major != SF_FORMAT_WAV && major != SF_FORMAT_WAVEX && major != SF_FORMAT_W64 && major != SF_FORMAT_AIFF)
+		return;
+	int bytes;
+	bool isFloat = false;
+	switch (sfinfo.format & SF_FORMAT_SUBMASK)
+	{
+		case SF_FORMAT_PCM_16:
+			bytes = 2;
+			break;
+		case SF_FORMAT_PCM_24:
+			bytes = 3;
+			break;
+		case SF_FORMAT_PCM_32:
+			bytes = 4;
+			break;
+		case SF_FORMAT_FLOAT:
+			bytes = 4;
+			isFloat = true;
+			break;
+		default:
+			return;
+	}
+
+	int fd = ::open(path().toLatin1().constData(), O_RDONLY);
+	if (fd == -1)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size <= 0 || uint64_t(st.st_size) > uint64_t(~size_t(0)))
+	{
+		::close(fd);
+		return;
+	}
+	size_t size = st.st_size;
+	void* p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return;
+
+	bool bigEndian;
+	int64_t offset = findPcmData((const unsigned char*) p, size, major, &bigEndian);
+	if (offset < 0 || uint64_t(offset) + uint64_t(sfinfo.frames) * bytes * sfinfo.channels > size)
+	{
+		if (debugMsg)
+			printf("SndFile::mapFile: no pcm data found in %s\n", path().toLatin1().constData());
+		munmap(p, size);
+		return;
+	}
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	mapBase = p;
+	mapSize = size;
+	mapData = (const unsigned char*) p + offset;
+	mapSampleBytes = bytes;
+	mapFloat = isFloat;
+	mapBigEndian = bigEndian;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	mapNative = !bigEndian && (bytes == 3 || (uintptr_t(mapData) % bytes) == 0);
+#else
+	mapNative = false;
+#endif
+}
+
+//---------------------------------------------------------
+//   unmapFile
+//---------------------------------------------------------
+
+void SndFile::unmapFile()
+{
+	if (!mapBase)
+		return;
+	munmap(mapBase, mapSize);
+	mapBase = 0;
+	mapSize = 0;
+	mapData = 0;
+}
+
+//---------------------------------------------------------
+//   convertPcm
+//    samples of any byte order to float, for what
+//    AL::dsp does not cover
+//---------------------------------------------------------
+
+static void convertPcm(float* dst, const unsigned char* src, unsigned n, int bytes, bool isFloat, bool bigEndian)
+{
+	for (unsigned i = 0; i < n; ++i, src += bytes)
+	{
+		// left aligned in 32 bits
+		unsigned v;
+		switch (bytes)
+		{
+			case 2:
+				v = bigEndian ? (unsigned(src[0]) << 24) | (src[1] << 16) : (unsigned(src[1]) << 24) | (src[0] << 16);
+				break;
+			case 3:
+				v = bigEndian ? (unsigned(src[0]) << 24) | (src[1] << 16) | (src[2] << 8)
+						: (unsigned(src[2]) << 24) | (src[1] << 16) | (src[0] << 8);
+				break;
+			default:
+				v = bigEndian ? be32(src) : le32(src);
+				break;
+		}
+		if (isFloat)
+			memcpy(&dst[i], &v, sizeof (float));
+		else
+			dst[i] = float(int(v)) * (1.0f / 2147483648.0f);
+	}
+}
+
+//---------------------------------------------------------
+//   readMapped
+//    n interleaved frames from the mapped file
+//---------------------------------------------------------
+
+size_t SndFile::readMapped(sf_count_t frame, float* buffer, size_t n)
+{
+	if (frame < 0 || frame >= sfinfo.frames)
+		return 0;
+	if (sf_count_t(n) > sfinfo.frames - frame)
+		n = sfinfo.frames - frame;
+	size_t frameBytes = mapSampleBytes * sfinfo.channels;
+	const unsigned char* src = mapData + frame * frameBytes;
+	unsigned samples = n * sfinfo.channels;
+
+	if (!mapNative)
+		convertPcm(buffer, src, samples, mapSampleBytes, mapFloat, mapBigEndian);
+	else if (mapFloat)
+		memcpy(buffer, src, samples * sizeof (float));
+	else if (mapSampleBytes == 2)
+		AL::dsp->s16ToFloat(buffer, (const short*) src, samples);
+	else if (mapSampleBytes == 3)
+		AL::dsp->s24ToFloat(buffer, src, samples);
+	else
+		AL::dsp->s32ToFloat(buffer, (const int*) src, samples);
+
+	// Have the kernel read the next window when we enter one.
+	size_t start = src - (const unsigned char*) mapBase;
+	size_t end = start + n * frameBytes;
+	if ((start >> MAP_AHEAD_SHIFT) != (end >> MAP_AHEAD_SHIFT))
+	{
+		size_t ahead = (end >> MAP_AHEAD_SHIFT) << MAP_AHEAD_SHIFT;
+		if (ahead < mapSize)
+		{
+			size_t len = 1 << MAP_AHEAD_SHIFT;
+			if (len > mapSize - ahead)
+				len = mapSize - ahead;
+			madvise((char*) mapBase + ahead, len, MADV_WILLNEED);
+		}
+	}
+	return n;
+}
+
 //---------------------------------------------------------
 //   remove
 //---------------------------------------------------------
@@ -488,7 +775,7 @@ void SndFile::setFormat(int fmt, int ch, int rate)
 size_t SndFile::readWithHeap(int srcChannels, float** dst, size_t n, bool overwrite)
 {
 	float *buffer = new float[n * sfinfo.channels];
-	int rn = readInternal(srcChannels, dst, n, overwrite, buffer, 0, 0);
+	int rn = readInternal(sf, srcChannels, dst, n, overwrite, buffer, 0, 0);
 	delete buffer;
 	return rn;
 }
@@ -500,14 +787,167 @@ size_t SndFile::readWithHeap(int srcChannels, float** dst, size_t n, bool overwr
 size_t SndFile::read(int srcChannels, float** dst, size_t n, unsigned offset, bool overwrite, WavePart *part)
 {
 	float buffer[n * sfinfo.channels];
-	int rn = readInternal(srcChannels, dst, n, overwrite, buffer, offset, part);
+	int rn = readInternal(sf, srcChannels, dst, n, overwrite, buffer, offset, part);
+	return rn;
+}
+
+//---------------------------------------------------------
+//   claimCursor
+//    Take a cursor which is at frame if there is one,
+//    else any open one, else open a new one. A file which
+//    is being written is read through sf only.
+//---------------------------------------------------------
+
+SndFileCursor* SndFile::claimCursor(sf_count_t frame)
+{
+	int n = writeFlag ? 1 : SNDFILE_CURSORS;
+	for (;;)
+	{
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			for (int i = 0; i < n; ++i)
+			{
+				SndFileCursor* c = &cursors[i];
+				if (__atomic_load_n(&c->busy, __ATOMIC_RELAXED))
+					continue;
+				SNDFILE* f = __atomic_load_n(&c->sf, __ATOMIC_RELAXED);
+				if (pass == 0 && (!f || __atomic_load_n(&c->pos, __ATOMIC_RELAXED) != frame))
+					continue;
+				if (pass == 1 && !f)
+					continue;
+				if (__sync_bool_compare_and_swap(&c->busy, 0, 1))
+					return c;
+			}
+		}
+		// more readers than cursors
+		sched_yield();
+	}
+}
+
+//---------------------------------------------------------
+//   readCursor
+//    n interleaved frames through a cursor
+//---------------------------------------------------------
+
+size_t SndFile::readCursor(sf_count_t frame, float* buffer, size_t n)
+{
+	SndFileCursor* c = claimCursor(frame);
+	SNDFILE* f = c->sf;
+	if (writeFlag)
+	{
+		f = sf;
+		c->pos = -1;
+	}
+	else if (!f)
+	{
+		SF_INFO info;
+		info.format = 0;
+		f = sf_open(path().toLatin1().constData(), SFM_READ, &info);
+		if (!f)
+		{
+			printf("SndFile::readAt: cannot open %s: %s\n", path().toLatin1().constData(), sf_strerror(0));
+			__atomic_store_n(&c->busy, 0, __ATOMIC_RELEASE);
+			return 0;
+		}
+		__atomic_store_n(&c->sf, f, __ATOMIC_RELAXED);
+		c->pos = -1;
+	}
+	if (c->pos != frame)
+		sf_seek(f, frame, SEEK_SET);
+
+	size_t rn = sf_readf_float(f, buffer, n);
+	if (!writeFlag)
+		__atomic_store_n(&c->pos, sf_count_t(frame + rn), __ATOMIC_RELAXED);
+	__atomic_store_n(&c->busy, 0, __ATOMIC_RELEASE);
 	return rn;
 }
 
-size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part)
+//---------------------------------------------------------
+//   decodeClip
+//    The whole file into data (new[]) for the clip cache,
+//    called by ClipCache::loadPending().
+//---------------------------------------------------------
+
+bool SndFile::decodeClip(float** data, size_t* frames, int* channels, bool* pinned)
+{
+	size_t n = sfinfo.frames;
+	if (!n)
+		return false;
+	float* buffer = new float[n * sfinfo.channels];
+	size_t rn = mapBase ? readMapped(0, buffer, n) : readCursor(0, buffer, n);
+	if (rn != n)
+	{
+		printf("SndFile::decodeClip: %s: read %zu of %zu frames\n", path().toLatin1().constData(), rn, n);
+		delete[] buffer;
+		return false;
+	}
+	*data = buffer;
+	*frames = n;
+	*channels = sfinfo.channels;
+	*pinned = cachePinned;
+	return true;
+}
+
+//---------------------------------------------------------
+//   setCachePinned
+//    keep the file in the clip cache regardless of its
+//    size and use
+//---------------------------------------------------------
+
+void SndFile::setCachePinned(bool pinned)
+{
+	cachePinned = pinned;
+	clipCache.setPinned(this, pinned);
+}
+
+//---------------------------------------------------------
+//   readAt
+//    Read n frames starting at frame. Safe to call from
+//    several threads at once: cached clips are shared
+//    (a miss only counts towards admitting the file),
+//    mapped files are read from memory, else every reader
+//    works on a cursor of its own, and as a cursor stays
+//    where the last read ended, interleaved streams of the
+//    same file (clones, loops) do not seek on every read.
+//---------------------------------------------------------
+
+size_t SndFile::readAt(off_t frame, int srcChannels, float** dst, size_t n, unsigned offset, bool overwrite, WavePart* part)
+{
+	ClipCacheEntry* e = writeFlag ? 0 : clipCache.get(this);
+	if (e)
+	{
+		size_t rn = 0;
+		if (frame >= 0 && size_t(frame) < e->frames)
+		{
+			rn = e->frames - frame;
+			if (rn > n)
+				rn = n;
+			rn = copyFrames(srcChannels, dst, rn, overwrite, e->data + frame * e->channels, offset, part);
+		}
+		clipCache.release(e);
+		return rn;
+	}
+	if (!writeFlag)
+		clipCache.noteMiss(this, frame, n, size_t(sfinfo.frames) * sfinfo.channels * sizeof (float), cachePinned);
+	float buffer[n * sfinfo.channels];
+	size_t rn = mapBase ? readMapped(frame, buffer, n) : readCursor(frame, buffer, n);
+	return copyFrames(srcChannels, dst, rn, overwrite, buffer, offset, part);
+}
+
+size_t SndFile::readInternal(SNDFILE* f, int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part)
 {
 //	if (part->getZIndex() > 0) return 0;
-	size_t rn = sf_readf_float(sf, buffer, n);
+	size_t rn = sf_readf_float(f, buffer, n);
+	return copyFrames(srcChannels, dst, rn, overwrite, buffer, offset, part);
+}
+
+//---------------------------------------------------------
+//   copyFrames
+//    n interleaved frames of the file from buffer to dst
+//---------------------------------------------------------
+
+size_t SndFile::copyFrames(int srcChannels, float** dst, size_t rn, bool overwrite, float *buffer, unsigned offset, WavePart* part)
+{
 	//TODO: Apply fadein/fadeout curve to signal comming from file
 	bool procFade = false;
 	unsigned startPos = offset;
@@ -519,7 +959,12 @@ size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwr
 	}
 	float* src = buffer;
 	int dstChannels = sfinfo.channels;
-	if (srcChannels == dstChannels)
+	if (srcChannels == dstChannels && !part && overwrite)
+	{
+		// plain copy, no fades or crossfades to apply
+		AL::dsp->deinterleave(dst, src, srcChannels, rn);
+	}
+	else if (srcChannels == dstChannels)
 	{
 		for (size_t i = 0; i < rn; ++i, ++startPos)
 		{
@@ -645,14 +1090,14 @@ size_t SndFile::write(int srcChannels, float** src, size_t n)
 
 	if (srcChannels == dstChannels)
 	{
-		for (size_t i = 0; i < n; ++i)
+		AL::dsp->interleave(buffer, src, dstChannels, n);
+		size_t samples = n * dstChannels;
+		for (size_t i = 0; i < samples; ++i)
 		{
-			for (int ch = 0; ch < dstChannels; ++ch)
-				//*dst++ = *(src[ch]+i); // < limitValue ? *(src[ch]+i) : limitValue;
-				if (*(src[ch] + i) > 0)
-					*dst++ = *(src[ch] + i) < limitValue ? *(src[ch] + i) : limitValue;
-				else
-					*dst++ = *(src[ch] + i) > -limitValue ? *(src[ch] + i) : -limitValue;
+			if (dst[i] > 0)
+				dst[i] = dst[i] < limitValue ? dst[i] : limitValue;
+			else
+				dst[i] = dst[i] > -limitValue ? dst[i] : -limitValue;
 		}
 	}
 	else if ((srcChannels == 1) && (dstChannels == 2))
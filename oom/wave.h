@@ -34,6 +34,7 @@ struct SampleV
 //---------------------------------------------------------
 
 class SndFile;
+struct ClipCacheEntry;
 
 class SndFileList : public std::list<SndFile*>
 {
@@ -44,6 +45,21 @@ public:
 typedef SndFileList::iterator iSndFile;
 typedef SndFileList::const_iterator ciSndFile;
 
+//---------------------------------------------------------
+//   SndFileCursor
+//    a read handle of its own with the position it is
+//    at, used by SndFile::readAt()
+//---------------------------------------------------------
+
+#define SNDFILE_CURSORS 8
+
+struct SndFileCursor
+{
+    SNDFILE* sf; // opened on first use
+    sf_count_t pos; // frame the next read starts at, -1 = unknown
+    int busy; // claimed by a reader
+};
+
 //---------------------------------------------------------
 //   SndFile
 //---------------------------------------------------------
@@ -62,7 +78,26 @@ class SndFile
 
     bool openFlag;
     bool writeFlag;
-    size_t readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part = 0);
+    SndFileCursor cursors[SNDFILE_CURSORS];
+
+    // uncompressed files opened for reading are memory mapped, see mapFile()
+    void* mapBase; // 0 if not mapped
+    size_t mapSize;
+    const unsigned char* mapData; // first frame
+    int mapSampleBytes;
+    bool mapFloat;
+    bool mapBigEndian;
+    bool mapNative; // samples can be converted by AL::dsp
+    bool cachePinned; // see setCachePinned()
+
+    size_t readInternal(SNDFILE* f, int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part = 0);
+    size_t copyFrames(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part);
+    SndFileCursor* claimCursor(sf_count_t frame);
+    void closeCursors();
+    void mapFile();
+    void unmapFile();
+    size_t readMapped(sf_count_t frame, float* buffer, size_t n);
+    size_t readCursor(sf_count_t frame, float* buffer, size_t n);
     bool useOverwrite(unsigned pos, WavePart* part, bool overwrite);
 
 protected:
@@ -112,6 +147,15 @@ public:
 
     size_t read(int channel, float**, size_t, unsigned offset, bool overwrite = true, WavePart* part = 0);
     size_t readWithHeap(int channel, float**, size_t, bool overwrite = true);
+    size_t readAt(off_t frame, int channel, float**, size_t, unsigned offset, bool overwrite = true, WavePart* part = 0);
+
+    bool isCachePinned() const
+    {
+        return cachePinned;
+    }
+    void setCachePinned(bool);
+    // for the clip cache
+    bool decodeClip(float** data, size_t* frames, int* channels, bool* pinned);
 
     size_t readDirect(float* buf, size_t n)
     {
@@ -262,6 +306,21 @@ public:
         return sf->read(channel, f, n, offset, overwrite, part);
     }
 
+    size_t readAt(off_t frame, int channel, float** f, size_t n, unsigned offset, bool overwrite = true, WavePart* part = 0)
+    {
+        return sf->readAt(frame, channel, f, n, offset, overwrite, part);
+    }
+
+    bool isCachePinned() const
+    {
+        return sf->isCachePinned();
+    }
+
+    void setCachePinned(bool pinned)
+    {
+        sf->setCachePinned(pinned);
+    }
+
     size_t readDirect(float* f, size_t n)
     {
         return sf->readDirect(f, n);
@@ -182,8 +182,7 @@ void WaveEventBase::readAudio(WavePart* part, unsigned offset, float** buffer, i
 	if (f.isNull())
 		return;
 
-	f.seek(offset + _spos, 0);
-	f.read(channel, buffer, n, offset, overwrite, part);
+	f.readAt(offset + _spos, channel, buffer, n, offset, overwrite, part);
 
 	return;
 #endif
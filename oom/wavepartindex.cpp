@@ -0,0 +1,99 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#include <algorithm>
+#include <utility>
+
+#include "wavepartindex.h"
+#include "part.h"
+
+static bool startLess(const WavePartSpan& a, const WavePartSpan& b)
+{
+	return a.start < b.start;
+}
+
+//---------------------------------------------------------
+//   WavePartIndex
+//---------------------------------------------------------
+
+WavePartIndex::WavePartIndex(PartList* pl, unsigned serial)
+{
+	_serial = serial;
+	_spans.reserve(pl->size());
+	for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
+	{
+		WavePart* part = (WavePart*) ip->second;
+		WavePartSpan s;
+		s.start = part->frame();
+		s.end = part->endFrame();
+		s.rank = 0;
+		s.part = part;
+		_spans.push_back(s);
+	}
+	// The list is sorted by frame already, unless a part was
+	//  moved without being re-added.
+	std::stable_sort(_spans.begin(), _spans.end(), startLess);
+
+	// z order, parts with the same z index by start
+	int n = _spans.size();
+	std::vector<std::pair<int, int> > z(n);
+	for (int i = 0; i < n; ++i)
+		z[i] = std::make_pair(_spans[i].part->getZIndex(), i);
+	std::sort(z.begin(), z.end());
+	_zOrder.resize(n);
+	for (int i = 0; i < n; ++i)
+	{
+		_zOrder[i] = z[i].second;
+		_spans[z[i].second].rank = i;
+	}
+
+	_maxEnd.resize(n);
+	build(0, n);
+}
+
+//---------------------------------------------------------
+//   build
+//    fill _maxEnd for the subtree over [lo, hi)
+//---------------------------------------------------------
+
+unsigned WavePartIndex::build(int lo, int hi)
+{
+	if (lo >= hi)
+		return 0;
+	int mid = (lo + hi) / 2;
+	unsigned m = _spans[mid].end;
+	m = std::max(m, build(lo, mid));
+	m = std::max(m, build(mid + 1, hi));
+	_maxEnd[mid] = m;
+	return m;
+}
+
+//---------------------------------------------------------
+//   find
+//---------------------------------------------------------
+
+void WavePartIndex::find(int lo, int hi, unsigned from, unsigned to, std::vector<const WavePartSpan*>& out) const
+{
+	if (lo >= hi)
+		return;
+	int mid = (lo + hi) / 2;
+	// nothing in this subtree reaches from
+	if (_maxEnd[mid] <= from)
+		return;
+	find(lo, mid, from, to, out);
+	const WavePartSpan& s = _spans[mid];
+	// this span and the ones right of it start too late
+	if (s.start >= to)
+		return;
+	if (s.end > from)
+		out.push_back(&s);
+	find(mid + 1, hi, from, to, out);
+}
+
+void WavePartIndex::find(unsigned from, unsigned to, std::vector<const WavePartSpan*>& out) const
+{
+	find(0, _spans.size(), from, to, out);
+}
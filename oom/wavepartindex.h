@@ -0,0 +1,80 @@
+//===========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//  (C) Copyright 2011 Andrew Williams & Christopher Cherrett
+//===========================================================
+
+#ifndef __WAVEPARTINDEX_H__
+#define __WAVEPARTINDEX_H__
+
+#include <vector>
+
+class PartList;
+class WavePart;
+
+//---------------------------------------------------------
+//   WavePartSpan
+//---------------------------------------------------------
+
+struct WavePartSpan
+{
+    unsigned start; // frames
+    unsigned end;
+    int rank; // place in z order, 0 is the bottom part
+    WavePart* part;
+};
+
+//---------------------------------------------------------
+//   WavePartIndex
+//    The parts of a wave track as an interval tree: the
+//    spans are sorted by start frame, the tree over them
+//    is implicit (the middle of every range is the root
+//    of its subtree) and _maxEnd holds the largest end
+//    frame below every node. Finding the parts which
+//    overlap a range is O(log n + parts found).
+//
+//    An index is not changed once built. The gui thread
+//    makes a new one after part edits and WaveTrack swaps
+//    it in, so the prefetch readers can use the old one
+//    meanwhile.
+//---------------------------------------------------------
+
+class WavePartIndex
+{
+    std::vector<WavePartSpan> _spans; // by start, part list order for equal starts
+    std::vector<unsigned> _maxEnd;
+    std::vector<int> _zOrder; // span indices, bottom part first
+    unsigned _serial; // of the part list it was built from
+
+    unsigned build(int lo, int hi);
+    void find(int lo, int hi, unsigned from, unsigned to, std::vector<const WavePartSpan*>& out) const;
+
+public:
+    WavePartIndex(PartList*, unsigned serial = 0);
+
+    // Appends the spans overlapping the frames [from, to) in start order.
+    void find(unsigned from, unsigned to, std::vector<const WavePartSpan*>& out) const;
+
+    int size() const
+    {
+        return _spans.size();
+    }
+
+    unsigned serial() const
+    {
+        return _serial;
+    }
+
+    // i-th span from the bottom
+    const WavePartSpan& zSpan(int i) const
+    {
+        return _spans[_zOrder[i]];
+    }
+
+    static bool lowerZ(const WavePartSpan* a, const WavePartSpan* b)
+    {
+        return a->rank < b->rank;
+    }
+};
+
+#endif
@@ -6,7 +6,10 @@
 //  (C) Copyright 2003 Werner Schweer (ws@seh.de)
 //=========================================================
 
+#include <algorithm>
+
 #include "track.h"
+#include "wavepartindex.h"
 #include "event.h"
 #include "audio.h"
 #include "FadeCurve.h"
@@ -48,35 +51,43 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 	if (!off())
 	{
 
-		PartList* pl = parts();
 		unsigned n = samples;
-		QList<Part*> sortedByZValue;
-		for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
+
+		// keep the index alive while we use it, see updatePartIndex()
+		__atomic_add_fetch(&_partIndexReaders, 1, __ATOMIC_SEQ_CST);
+		WavePartIndex* index = __atomic_load_n(&_partIndex, __ATOMIC_SEQ_CST);
+		_fetchParts.clear();
+		if (index && index->serial() == __atomic_load_n(&_partSerial, __ATOMIC_ACQUIRE))
 		{
-			sortedByZValue.append(ip->second);
+			_fetchSpans.clear();
+			index->find(pos, pos + n, _fetchSpans);
+			std::sort(_fetchSpans.begin(), _fetchSpans.end(), WavePartIndex::lowerZ);
+			for (unsigned i = 0; i < _fetchSpans.size(); ++i)
+				_fetchParts.push_back(_fetchSpans[i]->part);
+		}
+		else
+		{
+			// The parts changed and the gui thread has not built the
+			//  new index yet. Parts beyond the scratch size are left
+			//  out until it has.
+			PartList* pl = parts();
+			for (iPart ip = pl->begin(); ip != pl->end() && _fetchParts.size() < _fetchParts.capacity(); ++ip)
+			{
+				WavePart* part = (WavePart*) ip->second;
+				if (part->frame() < pos + n && part->endFrame() > pos)
+					_fetchParts.push_back(part);
+			}
+			std::sort(_fetchParts.begin(), _fetchParts.end(), Part::smallerZValue);
 		}
 
-		qSort(sortedByZValue.begin(), sortedByZValue.end(), Part::smallerZValue);
-		//printf("Sorted List Size:%d\n", sortedByZValue.size());
-
-		foreach(Part* wp, sortedByZValue)
+		for (unsigned i = 0; i < _fetchParts.size(); ++i)
 		{
-			WavePart* part = (WavePart*) wp;
+			WavePart* part = _fetchParts[i];
 
 			if (part->mute())
 				continue;
 
 			unsigned p_spos = part->frame();
-			unsigned p_epos = p_spos + part->lenFrame();
-			if (pos + n < p_spos)
-			{
-				continue;
-				//break;
-			}
-			if (pos >= p_epos)
-			{
-				continue;
-			}
 
 			//we now only support a single event per wave part so no need for iteration
 			//EventList* events = part->events();
@@ -121,6 +132,7 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 				}
 			}
 		}
+		__atomic_sub_fetch(&_partIndexReaders, 1, __ATOMIC_SEQ_CST);
 		//printf("\n");
 	}
 
@@ -128,10 +140,7 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 	{
 		// add denormal bias to outdata
 		for (int i = 0; i < channels(); ++i)
-			for (unsigned int j = 0; j < samples; ++j)
-			{
-				bp[i][j] += denormalBias;
-			}
+			AL::dsp->addConstant(bp[i], denormalBias, samples);
 	}
 
 	// p3.3.41
@@ -140,6 +149,30 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 	_prefetchFifo.add();
 }
 
+//---------------------------------------------------------
+//   ~WaveTrack
+//---------------------------------------------------------
+
+WaveTrack::~WaveTrack()
+{
+	delete _partIndex;
+	for (unsigned i = 0; i < _retiredPartIndex.size(); ++i)
+		delete _retiredPartIndex[i];
+	pthread_mutex_destroy(&_fetchLock);
+}
+
+//---------------------------------------------------------
+//   operator =
+//    the part list is replaced (undo of a track change)
+//---------------------------------------------------------
+
+WaveTrack& WaveTrack::operator=(const Track& t)
+{
+	Track::operator=(t);
+	partsChanged();
+	return *this;
+}
+
 //---------------------------------------------------------
 //   write
 //---------------------------------------------------------
@@ -301,7 +334,11 @@ bool WaveTrack::getData(unsigned framePos, int channels, unsigned nframe, float*
 		// Indicate do not seek file before each read.
 		// Changed by Tim. p3.3.17
 		//fetchData(framePos, nframe, bp);
+		// Not real time while freewheeling, so we may wait for a
+		//  prefetch reader still busy with this track.
+		lockFetch();
 		fetchData(framePos, nframe, bp, false);
+		unlockFetch();
 
 	}
 	else
@@ -336,6 +373,49 @@ bool WaveTrack::getData(unsigned framePos, int channels, unsigned nframe, float*
 	return true;
 }
 
+//---------------------------------------------------------
+//   preRenderable
+//    True if getData() and the effect rack of this track
+//    may run on an audio worker thread: the data comes
+//    from the prefetch fifo only, and all consumers pull
+//    the track with its own channel count.
+//    Called by Audio::compilePlan() in the gui thread when the routes change.
+//---------------------------------------------------------
+
+bool WaveTrack::preRenderable()
+{
+	if (!noInRoute() || totalOutChannels() > MAX_CHANNELS)
+		return false;
+
+	RouteList* orl = outRoutes();
+	for (ciRoute i = orl->begin(); i != orl->end(); ++i)
+	{
+		if (i->type != Route::TRACK_ROUTE || !i->track)
+			return false;
+		RouteList* irl = i->track->inRoutes();
+		for (ciRoute k = irl->begin(); k != irl->end(); ++k)
+		{
+			if (k->type == Route::TRACK_ROUTE && k->track == this && k->channels != -1 && k->channels != channels())
+				return false;
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------
+//   canPreRender
+//    True if a preRenderable() track should be rendered
+//    ahead this cycle.
+//---------------------------------------------------------
+
+bool WaveTrack::canPreRender()
+{
+	if (off() || isMute() || song->bounceTrack == this)
+		return false;
+	// In freewheel mode getData() reads the sound files directly.
+	return audio->isPlaying() && !audio->freewheel();
+}
+
 //---------------------------------------------------------
 //   setChannels
 //---------------------------------------------------------
@@ -355,25 +435,98 @@ void WaveTrack::setChannels(int n)
 	}
 }
 
+//---------------------------------------------------------
+//   partsChanged
+//    Parts were added, removed or changed. Called in any
+//    thread, the index is rebuilt by updatePartIndex().
+//---------------------------------------------------------
+
+void WaveTrack::partsChanged()
+{
+	__atomic_add_fetch(&_partSerial, 1, __ATOMIC_RELEASE);
+}
+
+//---------------------------------------------------------
+//   updatePartIndex
+//    Rebuild the index if the parts changed. Only called
+//    from the gui thread (Song::beat()), which is the only
+//    one to swap _partIndex. fetchData() may still be
+//    using the old index in a prefetch thread, so it is
+//    only deleted when no fetchData() call is seen after
+//    the swap, else it is kept for a later update or the
+//    destructor.
+//---------------------------------------------------------
+
+void WaveTrack::updatePartIndex()
+{
+	unsigned serial = __atomic_load_n(&_partSerial, __ATOMIC_ACQUIRE);
+	if (_partIndex == 0 || _partIndex->serial() != serial)
+	{
+		WavePartIndex* index = new WavePartIndex(parts(), serial);
+		// fetchData() must not grow its scratch, it may run in
+		//  the audio thread
+		unsigned n = std::max(index->size(), int(parts()->size()));
+		if (n > _fetchCapacity)
+		{
+			n = std::max(n, 2 * _fetchCapacity);
+			lockFetch();
+			_fetchSpans.reserve(n);
+			_fetchParts.reserve(n);
+			unlockFetch();
+			_fetchCapacity = n;
+		}
+		WavePartIndex* old = __atomic_exchange_n(&_partIndex, index, __ATOMIC_SEQ_CST);
+		if (old)
+			_retiredPartIndex.push_back(old);
+	}
+	if (!_retiredPartIndex.empty() && __atomic_load_n(&_partIndexReaders, __ATOMIC_SEQ_CST) == 0)
+	{
+		for (unsigned i = 0; i < _retiredPartIndex.size(); ++i)
+			delete _retiredPartIndex[i];
+		_retiredPartIndex.clear();
+	}
+}
+
 static const int CROSSFADE_WIDTH = 256;
 
+//---------------------------------------------------------
+//   calculateCrossFades
+//    The overlapping parts are found with an index of its
+//    own, this may be called with a part change in the
+//    midi or audio thread. The shared one is marked out of
+//    date for the gui thread.
+//---------------------------------------------------------
+
 void WaveTrack::calculateCrossFades()
 {
-	QList<WavePart*> sortedByZValue;
-	for (iPart ip = parts()->begin(); ip != parts()->end(); ++ip)
+	partsChanged();
+	WavePartIndex local(parts());
+	WavePartIndex* index = &local;
+	int n = index->size();
+	for (int i = 0; i < n; ++i)
 	{
-		WavePart* wp = (WavePart*)ip->second;
+		WavePart* wp = index->zSpan(i).part;
 		wp->crossFadeIn()->setWidth(0);
 		wp->crossFadeOut()->setWidth(0);
-		sortedByZValue.append(wp);
 	}
 
-	qSort(sortedByZValue.begin(), sortedByZValue.end(), Part::smallerZValue);
+	// parts lying on top of a lower one with both edges, by rank
+	std::vector<char> onTop(n, 0);
+	std::vector<const WavePartSpan*> spans;
 
-	foreach(WavePart* bottomPart, sortedByZValue)
+	for (int i = 0; i < n; ++i)
 	{
-		foreach(WavePart* topPart, sortedByZValue)
+		const WavePartSpan& bottom = index->zSpan(i);
+		WavePart* bottomPart = bottom.part;
+		spans.clear();
+		index->find(bottom.start, bottom.end, spans);
+		std::sort(spans.begin(), spans.end(), WavePartIndex::lowerZ);
+
+		for (unsigned k = 0; k < spans.size(); ++k)
 		{
+			WavePart* topPart = spans[k]->part;
+			if (onTop[spans[k]->rank])
+				continue;
 			if (topPart->getZIndex() > bottomPart->getZIndex() && leftAndRightEdgeOnTopOfPartBelow(topPart, bottomPart))
 			{
 				unsigned bottomPartFadeOutStart = topPart->frame() - bottomPart->frame();
@@ -394,9 +547,9 @@ void WaveTrack::calculateCrossFades()
 				topPart->setHasCrossFadeForPartialOverlapLeft(false);
 				topPart->setHasCrossFadeForPartialOverlapRight(false);
 
-				// this one no longer can have partial overlap, remove from list
-				// so partial overlap detection won't have to deal with this part anymore.
-				sortedByZValue.removeAll(topPart);
+				// this one no longer can have partial overlap, so partial
+				// overlap detection won't have to deal with this part anymore.
+				onTop[spans[k]->rank] = 1;
 			}
 		}
 	}
@@ -404,10 +557,13 @@ void WaveTrack::calculateCrossFades()
 
 	if (config.useAutoCrossFades)
 	{
-		foreach(WavePart* topPart, sortedByZValue)
+		for (int i = 0; i < n; ++i)
 		{
+			if (onTop[i])
+				continue;
+			WavePart* topPart = index->zSpan(i).part;
 			QList<WavePart*> list;
-			list = partsBelowLeftEdge(topPart);
+			list = partsBelowLeftEdge(*index, topPart);
 			if (list.size())
 			{
 				foreach(WavePart* bottomPart, list)
@@ -430,7 +586,7 @@ void WaveTrack::calculateCrossFades()
 			}
 
 
-			list = partsBelowRightEdge(topPart);
+			list = partsBelowRightEdge(*index, topPart);
 			if (list.size())
 			{
 				foreach(WavePart* bottomPart, list)
@@ -487,12 +643,20 @@ bool WaveTrack::rightEdgeOnTopOfPartBelow(WavePart *topPart, WavePart* bottomPar
 	return false;
 }
 
-QList<WavePart*> WaveTrack::partsBelowLeftEdge(WavePart *part)
+//---------------------------------------------------------
+//   partsBelowLeftEdge
+//    the parts the left edge of part lies on, index
+//    is the one calculateCrossFades() built
+//---------------------------------------------------------
+
+QList<WavePart*> WaveTrack::partsBelowLeftEdge(const WavePartIndex& index, WavePart *part)
 {
 	QList<WavePart*> list;
-	for (iPart ip = parts()->begin(); ip != parts()->end(); ++ip)
+	std::vector<const WavePartSpan*> spans;
+	index.find(part->frame(), part->frame() + 1, spans);
+	for (unsigned i = 0; i < spans.size(); ++i)
 	{
-		WavePart* wp = (WavePart*)ip->second;
+		WavePart* wp = spans[i]->part;
 		if (wp == part)
 		{
 			continue;
@@ -506,13 +670,20 @@ QList<WavePart*> WaveTrack::partsBelowLeftEdge(WavePart *part)
 	return list;
 }
 
+//---------------------------------------------------------
+//   partsBelowRightEdge
+//    the parts the right edge of part lies on, index
+//    is the one calculateCrossFades() built
+//---------------------------------------------------------
 
-QList<WavePart*> WaveTrack::partsBelowRightEdge(WavePart *part)
+QList<WavePart*> WaveTrack::partsBelowRightEdge(const WavePartIndex& index, WavePart *part)
 {
 	QList<WavePart*> list;
-	for (iPart ip = parts()->begin(); ip != parts()->end(); ++ip)
+	std::vector<const WavePartSpan*> spans;
+	index.find(part->endFrame(), part->endFrame() + 1, spans);
+	for (unsigned i = 0; i < spans.size(); ++i)
 	{
-		WavePart* wp = (WavePart*)ip->second;
+		WavePart* wp = spans[i]->part;
 		if (wp == part)
 		{
 			continue;
@@ -1325,8 +1325,7 @@ void TrackHeader::volumeChanged(double val)/*{{{*/
 				vol = pow(10.0, val / 20.0);
 			volume = vol;
 			audio->msgSetVolume((AudioTrack*) in, vol);
-			((AudioTrack*) in)->recordAutomation(AC_VOLUME, vol);
-			song->update(SC_TRACK_MODIFIED);/*}}}*/
+			((AudioTrack*) in)->recordAutomation(AC_VOLUME, vol);/*}}}*/
 		}
 	}
 	else
@@ -1345,8 +1344,7 @@ void TrackHeader::volumeChanged(double val)/*{{{*/
 			vol = pow(10.0, val / 20.0);
 		volume = vol;
 		audio->msgSetVolume((AudioTrack*) m_track, vol);
-		((AudioTrack*) m_track)->recordAutomation(AC_VOLUME, vol);
-		song->update(SC_TRACK_MODIFIED);/*}}}*/
+		((AudioTrack*) m_track)->recordAutomation(AC_VOLUME, vol);/*}}}*/
 	}
 }/*}}}*/
 
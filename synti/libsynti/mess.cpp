@@ -8,8 +8,9 @@
 #include "mess.h"
 #include "oom/midi.h"
 #include "oom/midictrl.h"
+#include "oom/spscring.h"
 
-static const int FIFO_SIZE = 32;
+static const unsigned FIFO_SIZE = 256;
 
 //---------------------------------------------------------
 //   MessP
@@ -17,10 +18,11 @@ static const int FIFO_SIZE = 32;
 
 struct MessP {
       // Event Fifo  synti -> Host:
-      MidiPlayEvent fifo[FIFO_SIZE];
-      volatile int fifoSize;
-      int fifoWindex;
-      int fifoRindex;
+      SPSCRing ring;
+      MidiPlayEvent fifo[SPSCRingSize<FIFO_SIZE>::value];
+      unsigned dropped;             // events lost to a full fifo
+
+      MessP() : ring(FIFO_SIZE) { dropped = 0; }
       };
 
 //---------------------------------------------------------
@@ -32,9 +34,6 @@ Mess::Mess(int n)
       _channels     = n;
       _sampleRate   = 44100;
       d             = new MessP;
-      d->fifoSize   = 0;
-      d->fifoWindex = 0;
-      d->fifoRindex = 0;
       }
 
 //---------------------------------------------------------
@@ -43,6 +42,8 @@ Mess::Mess(int n)
 
 Mess::~Mess()
       {
+      if (d->dropped)
+            printf("Mess: %u events synti->host dropped, fifo full\n", d->dropped);
       delete d;
       }
 
@@ -62,17 +63,19 @@ void Mess::getGeometry(int* x, int* y, int* w, int* h) const
 //---------------------------------------------------------
 //   sendEvent
 //    send Event synti -> host
+//    The fifo is not grown here, this may be the audio
+//    thread. When the host falls behind the event is
+//    dropped and counted.
 //---------------------------------------------------------
 
 void Mess::sendEvent(MidiPlayEvent ev)
       {
-      if (d->fifoSize == FIFO_SIZE) {
-            printf("event synti->host  fifo overflow\n");
+      if (d->ring.full()) {
+            __atomic_add_fetch(&d->dropped, 1, __ATOMIC_RELAXED);
             return;
             }
-      d->fifo[d->fifoWindex] = ev;
-      d->fifoWindex = (d->fifoWindex + 1) % FIFO_SIZE;
-      ++(d->fifoSize);
+      d->fifo[d->ring.writeIndex()] = ev;
+      d->ring.push();
       }
 
 //---------------------------------------------------------
@@ -82,9 +85,8 @@ void Mess::sendEvent(MidiPlayEvent ev)
 
 MidiPlayEvent Mess::receiveEvent()
       {
-      MidiPlayEvent ev = d->fifo[d->fifoRindex];
-      d->fifoRindex = (d->fifoRindex + 1) % FIFO_SIZE;
-      --(d->fifoSize);
+      MidiPlayEvent ev = d->fifo[d->ring.readIndex()];
+      d->ring.pop();
       return ev;
       }
 
@@ -98,7 +100,7 @@ MidiPlayEvent Mess::receiveEvent()
 
 int Mess::eventsPending() const
       {
-      return d->fifoSize;
+      return d->ring.size();
       }
 
 //---------------------------------------------------------